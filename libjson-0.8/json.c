@@ -335,6 +335,29 @@ static int buffer_push(json_parser *parser, unsigned char c)
 	return 0;
 }
 
+/* push n plain characters at once, *pushed - number of pushed ones */
+static int buffer_append(json_parser *parser, const char *s, uint32_t n, uint32_t *pushed)
+{
+	uint32_t done = 0, room;
+	int ret = 0;
+
+	while (done < n) {
+		if (parser->buffer_offset + 1 >= parser->buffer_size) {
+			ret = buffer_grow(parser);
+			if (ret)
+				break;
+		}
+		room = parser->buffer_size - 1 - parser->buffer_offset;
+		if (room > n - done)
+			room = n - done;
+		memcpy(parser->buffer + parser->buffer_offset, s + done, room);
+		parser->buffer_offset += room;
+		done += room;
+	}
+	*pushed = done;
+	return ret;
+}
+
 static int do_callback_withbuf(json_parser *parser, int type)
 {
 	if (!parser->callback)
@@ -649,6 +672,577 @@ int json_parser_is_done(json_parser *parser)
 	return parser->stack_offset == 0 && parser->state != STATE_GO;
 }
 
+/* value of 4 hex digits, -1 if they aren't */
+static int hex4(const char *s)
+{
+	int i, v = 0;
+
+	for (i = 0; i < 4; i++) {
+		uint8_t c = s[i];
+		if (c >= 128 || hextable[c] == (uint8_t) -1)
+			return -1;
+		v = (v << 4) | hextable[c];
+	}
+	return v;
+}
+
+/*
+ * tokenizer stage
+ *
+ * bytes of the chunk are classified in windows of 64-byte blocks into bitmaps
+ * (structural index): stop - quote, backslash and control characters, which end
+ * plain run of string contents; token - everything but whitespace. the state
+ * machine jumps to the next set bit instead of passing string contents and
+ * whitespace through the transition table byte by byte.
+ * only bytes are classified, string/escape state stays in the state machine,
+ * so chunks can be split anywhere (nothing is carried in the index).
+ */
+
+#define INDEX_BLOCKS	64	/* 4KB window */
+/* input shorter than that (chunk or its rest) isn't worth classification,
+ * its bytes are checked one by one */
+#define INDEX_MIN	256
+
+typedef void (*classify_fct)(const unsigned char *s, uint32_t nblocks, uint64_t *stop, uint64_t *token);
+/* length of valid utf-8 prefix of s, which ends on complete sequence
+ * (ascii prefix at least, the rest is checked sequence by sequence) */
+typedef uint32_t (*utf8_fct)(const unsigned char *s, uint32_t length);
+
+typedef struct json_index {
+	const unsigned char *s;	/* chunk */
+	uint32_t length;
+	uint32_t base;		/* window of the chunk: [base, end) */
+	uint32_t end;
+	classify_fct classify;	/* NULL - no index, bytes are checked one by one */
+	uint64_t stop[INDEX_BLOCKS];
+	uint64_t token[INDEX_BLOCKS];
+} json_index;
+
+#define BYTE_STOP	1
+#define BYTE_TOKEN	2
+
+/* map from byte to BYTE_* flags */
+static uint8_t byte_flags[256];
+
+#define SWAR_ONES	0x0101010101010101ULL
+#define SWAR_LOW7	0x7f7f7f7f7f7f7f7fULL
+#define SWAR_HIGH	0x8080808080808080ULL
+
+/* high bit of each byte of v, which is equal to c */
+static inline uint64_t swar_eq(uint64_t v, uint8_t c)
+{
+	uint64_t x = v ^ (SWAR_ONES * c);
+	return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x) & SWAR_HIGH;
+}
+
+/* 8 bits from high bits of bytes */
+static inline uint32_t swar_bits(uint64_t m)
+{
+	return (uint32_t) (((m >> 7) * 0x0102040810204080ULL) >> 56);
+}
+
+/* bytes are classified by words of 8 bytes */
+static void classify_scalar(const unsigned char *s, uint32_t nblocks, uint64_t *stop, uint64_t *token)
+{
+	uint32_t b;
+	int i;
+
+	for (b = 0; b < nblocks; b++, s += 64) {
+		uint64_t st = 0, ws = 0;
+
+		for (i = 0; i < 64; i += 8) {
+			uint64_t v, ctrl;
+
+			memcpy(&v, s + i, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			v = __builtin_bswap64(v);
+#endif
+			ctrl = ~(((v & SWAR_LOW7) + SWAR_ONES * 0x60) | v) & SWAR_HIGH;
+			st |= (uint64_t) swar_bits(swar_eq(v, '"') | swar_eq(v, '\\') | ctrl) << i;
+			ws |= (uint64_t) swar_bits(swar_eq(v, ' ') | swar_eq(v, '\n') | swar_eq(v, '\t') | swar_eq(v, '\r')) << i;
+		}
+		stop[b] = st;
+		token[b] = ~ws;
+	}
+}
+
+/* length of ascii prefix of s */
+static uint32_t ascii_scalar(const unsigned char *s, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= length; i += 8) {
+		uint64_t v;
+
+		memcpy(&v, s + i, 8);
+		if (v & 0x8080808080808080ULL)
+			break;
+	}
+	while (i < length && s[i] < 0x80)
+		i++;
+	return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_SIMD_X86 1
+#include <immintrin.h>
+
+__attribute__((target("sse2")))
+static void classify_sse2(const unsigned char *s, uint32_t nblocks, uint64_t *stop, uint64_t *token)
+{
+	const __m128i quote = _mm_set1_epi8('"'), backs = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1f);
+	const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n'), tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+	uint32_t b;
+	int i;
+
+	for (b = 0; b < nblocks; b++, s += 64) {
+		uint64_t st = 0, ws = 0;
+
+		for (i = 0; i < 64; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+			__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backs)),
+			                         _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+			__m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+			                         _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+
+			st |= (uint64_t) (uint16_t) _mm_movemask_epi8(m) << i;
+			ws |= (uint64_t) (uint16_t) _mm_movemask_epi8(w) << i;
+		}
+		stop[b] = st;
+		token[b] = ~ws;
+	}
+}
+
+__attribute__((target("sse2")))
+static uint32_t ascii_sse2(const unsigned char *s, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + i)));
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+	return i + ascii_scalar(s + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *s, uint32_t nblocks, uint64_t *stop, uint64_t *token)
+{
+	const __m256i quote = _mm256_set1_epi8('"'), backs = _mm256_set1_epi8('\\'), ctrl = _mm256_set1_epi8(0x1f);
+	const __m256i sp = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n'), tab = _mm256_set1_epi8('\t'), cr = _mm256_set1_epi8('\r');
+	uint32_t b;
+	int i;
+
+	for (b = 0; b < nblocks; b++, s += 64) {
+		uint64_t st = 0, ws = 0;
+
+		for (i = 0; i < 64; i += 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i *) (s + i));
+			__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backs)),
+			                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v));
+			__m256i w = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, nl)),
+			                            _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, cr)));
+
+			st |= (uint64_t) (uint32_t) _mm256_movemask_epi8(m) << i;
+			ws |= (uint64_t) (uint32_t) _mm256_movemask_epi8(w) << i;
+		}
+		stop[b] = st;
+		token[b] = ~ws;
+	}
+}
+
+__attribute__((target("avx2")))
+static uint32_t ascii_avx2(const unsigned char *s, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *) (s + i)));
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+	return i + ascii_sse2(s + i, length - i);
+}
+
+/* utf-8 validation by lookups of 4-bit halves of adjacent bytes
+ * (J. Keiser, D. Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte") */
+#define U8_TOO_SHORT	(1 << 0)
+#define U8_TOO_LONG	(1 << 1)
+#define U8_OVERLONG_3	(1 << 2)
+#define U8_TOO_LARGE	(1 << 3)
+#define U8_SURROGATE	(1 << 4)
+#define U8_OVERLONG_2	(1 << 5)
+#define U8_TOO_LARGE_1000	(1 << 6)
+#define U8_OVERLONG_4	(1 << 6)
+#define U8_TWO_CONTS	(1 << 7)
+#define U8_CARRY	(U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+#define U8_TABLE(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p) \
+	_mm256_setr_epi8(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p)
+
+/* v shifted by n bytes, with last bytes of prev in front */
+#define U8_PREV(v, prev, n) _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_errors_avx2(__m256i v, __m256i prev)
+{
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	const __m256i byte_1_high_table = U8_TABLE(
+		U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+		U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+		U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,
+		U8_TOO_SHORT | U8_OVERLONG_2,
+		U8_TOO_SHORT,
+		U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,
+		U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4);
+	const __m256i byte_1_low_table = U8_TABLE(
+		U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,
+		U8_CARRY | U8_OVERLONG_2,
+		U8_CARRY,
+		U8_CARRY,
+		U8_CARRY | U8_TOO_LARGE,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000);
+	const __m256i byte_2_high_table = U8_TABLE(
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT);
+	__m256i prev1 = U8_PREV(v, prev, 1);
+	__m256i sc = _mm256_and_si256(_mm256_and_si256(
+		_mm256_shuffle_epi8(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low)),
+		_mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, low))),
+		_mm256_shuffle_epi8(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+	/* third and fourth bytes of sequences have to be continuations (TWO_CONTS above) */
+	__m256i must23 = _mm256_or_si256(
+		_mm256_subs_epu8(U8_PREV(v, prev, 2), _mm256_set1_epi8((char) (0xe0 - 0x80))),
+		_mm256_subs_epu8(U8_PREV(v, prev, 3), _mm256_set1_epi8((char) (0xf0 - 0x80))));
+
+	return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char) 0x80)), sc);
+}
+
+__attribute__((target("avx2")))
+static uint32_t utf8_avx2(const unsigned char *s, uint32_t length)
+{
+	__m256i prev = _mm256_setzero_si256();
+	uint32_t i = 0, j;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (s + i)), errors;
+
+		/* ascii block after ascii one */
+		if (!_mm256_movemask_epi8(v) && !_mm256_movemask_epi8(prev))
+			continue;
+		errors = utf8_errors_avx2(v, prev);
+		if (!_mm256_testz_si256(errors, errors))
+			break;
+		prev = v;
+	}
+	/* sequence, which isn't completed in checked blocks, is checked again */
+	for (j = 1; j <= 3 && j <= i; j++) {
+		uint8_t c = s[i - j];
+
+		if (c < 0x80)
+			break;
+		if (c >= 0xc0) {
+			if (j < ((c >= 0xf0) ? 4 : (c >= 0xe0) ? 3 : 2))
+				i -= j;
+			break;
+		}
+	}
+	return i + ascii_avx2(s + i, length - i);
+}
+#endif
+
+static const struct {
+	classify_fct classify;
+	utf8_fct utf8;
+} simd_fcts[] = {
+	[JSON_SIMD_NONE]   = { NULL,            ascii_scalar },
+	[JSON_SIMD_SCALAR] = { classify_scalar, ascii_scalar },
+#ifdef JSON_SIMD_X86
+	[JSON_SIMD_SSE2]   = { classify_sse2,   ascii_sse2 },
+	[JSON_SIMD_AVX2]   = { classify_avx2,   utf8_avx2 },
+#endif
+};
+
+static int simd_level = -1;
+
+/* best instruction set supported by cpu (scalar one is used by request only) */
+static int simd_supported(void)
+{
+#ifdef JSON_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return JSON_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return JSON_SIMD_SSE2;
+#endif
+	return JSON_SIMD_SCALAR;
+}
+
+int json_simd_limit(int level)
+{
+	int c, supported = simd_supported();
+
+	for (c = 0; c < 256; c++)
+		byte_flags[c] = ((c == '"' || c == '\\' || c < 0x20) ? BYTE_STOP : 0)
+		              | ((c == ' ' || c == '\n' || c == '\t' || c == '\r') ? 0 : BYTE_TOKEN);
+	simd_level = (level < JSON_SIMD_NONE) ? JSON_SIMD_NONE
+	           : (level > supported) ? supported : level;
+	return simd_level;
+}
+
+int json_simd_level(void)
+{
+	/* scalar classification is slower than the state machine on usual input */
+	if (simd_level < 0 && json_simd_limit(JSON_SIMD_AVX2) == JSON_SIMD_SCALAR)
+		json_simd_limit(JSON_SIMD_NONE);
+	return simd_level;
+}
+
+static inline void index_init(json_index *index, const char *s, uint32_t length)
+{
+	index->s = (const unsigned char *) s;
+	index->length = length;
+	index->base = index->end = 0;
+	index->classify = simd_fcts[json_simd_level()].classify;
+}
+
+/* classify window of the chunk, which starts at pos */
+static void index_window(json_index *index, uint32_t pos)
+{
+	uint32_t n = index->length - pos, full;
+
+	if (n > INDEX_BLOCKS * 64)
+		n = INDEX_BLOCKS * 64;
+	index->base = pos;
+	index->end = pos + n;
+
+	full = n / 64;
+	if (full)
+		index->classify(index->s + pos, full, index->stop, index->token);
+	if (n % 64) {
+		/* zero padding is stop and token: found bits of it are ignored */
+		unsigned char tail[64];
+
+		memset(tail, 0, sizeof(tail));
+		memcpy(tail, index->s + pos + full * 64, n % 64);
+		index->classify(tail, 1, index->stop + full, index->token + full);
+	}
+}
+
+/* position of the first byte at pos or after it with flag (BYTE_STOP/BYTE_TOKEN),
+ * length of the chunk if there isn't such byte */
+static inline uint32_t index_find(json_index *index, uint32_t pos, int flag)
+{
+	if (!index->classify) {
+		while (pos < index->length && !(byte_flags[index->s[pos]] & flag))
+			pos++;
+		return pos;
+	}
+
+	while (pos < index->length) {
+		const uint64_t *masks;
+		uint32_t block, nblocks;
+		uint64_t m;
+
+		if (pos < index->base || pos >= index->end) {
+			/* short rest of the chunk: no index from here */
+			if (index->length - pos < INDEX_MIN) {
+				index->classify = NULL;
+				return index_find(index, pos, flag);
+			}
+			index_window(index, pos);
+		}
+		masks = (flag == BYTE_STOP) ? index->stop : index->token;
+		block = (pos - index->base) / 64;
+		nblocks = (index->end - index->base + 63) / 64;
+		m = masks[block] & (~(uint64_t) 0 << ((pos - index->base) % 64));
+		while (!m && ++block < nblocks)
+			m = masks[block];
+		if (m) {
+			uint32_t found = index->base + block * 64 + __builtin_ctzll(m);
+			if (found < index->end)
+				return found;
+		}
+		pos = index->end;
+	}
+	return index->length;
+}
+
+/* check utf-8 of the chunk (sequence can be continued from the previous one),
+ * *valid - length of the valid part
+ * return JSON_ERROR_UTF8 if there is invalid byte */
+static int utf8_validate(json_parser *parser, const unsigned char *s, uint32_t length, uint32_t *valid)
+{
+	utf8_fct utf8 = simd_fcts[json_simd_level()].utf8;
+	uint32_t i = 0;
+
+	while (i < length) {
+		uint8_t c;
+
+		if (parser->utf8_need == 0) {
+			i += (length - i < INDEX_MIN) ? ascii_scalar(s + i, length - i) : utf8(s + i, length - i);
+			if (i == length)
+				break;
+			c = s[i];
+			parser->utf8_lo = 0x80;
+			parser->utf8_hi = 0xbf;
+			if (c >= 0xc2 && c <= 0xdf)
+				parser->utf8_need = 1;
+			else if (c >= 0xe0 && c <= 0xef) {
+				parser->utf8_need = 2;
+				if (c == 0xe0)
+					parser->utf8_lo = 0xa0; /* overlong */
+				else if (c == 0xed)
+					parser->utf8_hi = 0x9f; /* surrogates */
+			} else if (c >= 0xf0 && c <= 0xf4) {
+				parser->utf8_need = 3;
+				if (c == 0xf0)
+					parser->utf8_lo = 0x90; /* overlong */
+				else if (c == 0xf4)
+					parser->utf8_hi = 0x8f; /* above U+10FFFF */
+			} else
+				break;
+			i++;
+			continue;
+		}
+
+		c = s[i];
+		if (c < parser->utf8_lo || c > parser->utf8_hi)
+			break;
+		parser->utf8_need--;
+		parser->utf8_lo = 0x80;
+		parser->utf8_hi = 0xbf;
+		i++;
+	}
+	*valid = i;
+	return (i < length) ? JSON_ERROR_UTF8 : 0;
+}
+
+/* find the end of string, which starts at start of the chunk (after opening quote),
+ * return 0 if string isn't completed in the chunk or it can't be passed in place,
+ * so it has to go through the buffer (the usual way reports errors too) */
+static int scan_inplace_string(json_parser *parser, json_index *index, uint32_t start,
+                               uint32_t *string_length, int *escaped)
+{
+	const char *s = (const char *) index->s + start;
+	uint32_t length = index->length - start;
+	uint32_t i;
+	int uval;
+
+	*escaped = 0;
+	for (i = 0; i < length; i++) {
+		uint8_t c;
+
+		/* plain characters are skipped by index */
+		i = index_find(index, start + i, BYTE_STOP) - start;
+		if (i >= length)
+			return 0;
+		c = s[i];
+		if (c == '"') {
+			*string_length = i;
+			return parser->config.max_data == 0 || i + 1 < parser->config.max_data;
+		}
+		if (c < 0x20)
+			return 0;
+		if (c != '\\')
+			continue;
+
+		if (parser->expecting_key || ++i >= length)
+			return 0;
+		*escaped = 1;
+		switch (s[i]) {
+		case '"': case '\\': case '/':
+		case 'b': case 'f': case 'n': case 'r': case 't':
+			break;
+		case 'u':
+			if (i + 4 >= length || (uval = hex4(s + i + 1)) < 0 || IS_LOW_SURROGATE(uval))
+				return 0;
+			i += 4;
+			if (!IS_HIGH_SURROGATE(uval))
+				break;
+			if (i + 6 >= length || s[i + 1] != '\\' || s[i + 2] != 'u'
+			    || (uval = hex4(s + i + 3)) < 0 || !IS_LOW_SURROGATE(uval))
+				return 0;
+			i += 6;
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/** json_unescape convert escapes of JSON_STRING_ESCAPED value (validated by the parser)
+ * into out, which has to have length bytes at least (result is never longer).
+ * return length of the result, it isn't null terminated */
+uint32_t json_unescape(const char *s, uint32_t length, char *out)
+{
+	const char *end = s + length;
+	char *o = out;
+	uint32_t uval;
+
+	while (s < end) {
+		const char *p = memchr(s, '\\', end - s);
+
+		if (!p)
+			p = end;
+		memcpy(o, s, p - s);
+		o += p - s;
+		if (p == end)
+			break;
+
+		switch (p[1]) {
+		case 'b': *o++ = '\b'; break;
+		case 'f': *o++ = '\f'; break;
+		case 'n': *o++ = '\n'; break;
+		case 'r': *o++ = '\r'; break;
+		case 't': *o++ = '\t'; break;
+		case 'u':
+			uval = hex4(p + 2);
+			if (IS_HIGH_SURROGATE(uval)) {
+				uval = 0x10000 + ((uval & 0x3ff) << 10) + (hex4(p + 8) & 0x3ff);
+				p += 6;
+			}
+			if (uval < 0x80)
+				*o++ = (char) uval;
+			else if (uval < 0x800) {
+				*o++ = (char) ((uval >> 6) | 0xc0);
+				*o++ = (char) ((uval & 0x3f) | 0x80);
+			} else if (uval < 0x10000) {
+				*o++ = (char) ((uval >> 12) | 0xe0);
+				*o++ = (char) (((uval >> 6) & 0x3f) | 0x80);
+				*o++ = (char) ((uval & 0x3f) | 0x80);
+			} else {
+				*o++ = (char) ((uval >> 18) | 0xf0);
+				*o++ = (char) (((uval >> 12) & 0x3f) | 0x80);
+				*o++ = (char) (((uval >> 6) & 0x3f) | 0x80);
+				*o++ = (char) ((uval & 0x3f) | 0x80);
+			}
+			p += 4;
+			break;
+		default: *o++ = p[1]; break;
+		}
+		s = p + 2;
+	}
+	return o - out;
+}
+
 /** json_parser_string append a string s with a specific length to the parser
  * return 0 if everything went ok, a JSON_ERROR_* otherwise.
  * the user can supplied a valid processed pointer that will
@@ -656,16 +1250,76 @@ int json_parser_is_done(json_parser *parser)
 int json_parser_string(json_parser *parser, const char *s,
                        uint32_t length, uint32_t *processed)
 {
-	int ret;
+	int ret, utf8_ret = 0;
 	int next_class, next_state;
 	int buffer_policy;
-	uint32_t i;
+	uint32_t i, n, valid = length;
+	int escaped;
+	json_index index;
+
+	/* bytes after invalid sequence aren't parsed */
+	if (parser->config.validate_utf8)
+		utf8_ret = utf8_validate(parser, (const unsigned char *) s, length, &valid);
+	index_init(&index, s, valid);
+	/* setup of the index costs more than it saves on short chunk */
+	if (valid < INDEX_MIN)
+		index.classify = NULL;
 
 	ret = 0;
-	for (i = 0; i < length; i++) {
+	for (i = 0; i < valid; i++) {
 		unsigned char ch = s[i];
 
 		ret = 0;
+
+		/* string has just started: pass it right from the chunk if it ends here */
+		if (parser->state == STATE__S && parser->buffer_offset == 0 && parser->config.inplace_strings
+		    && scan_inplace_string(parser, &index, i, &n, &escaped)) {
+			if (parser->callback)
+				ret = (*parser->callback)(parser->userdata,
+				                          parser->expecting_key ? JSON_KEY : escaped ? JSON_STRING_ESCAPED : JSON_STRING,
+				                          s + i, n);
+			if (ret)
+				break;
+			i += n; /* closing quote */
+			parser->state = (parser->expecting_key) ? STATE_CO : STATE_OK;
+			parser->expecting_key = 0;
+			parser->type = JSON_NONE;
+			continue;
+		}
+		if (index.classify) {
+			if (parser->state == STATE__S) {
+				/* plain characters of the string go to the buffer at once */
+				n = index_find(&index, i, BYTE_STOP) - i;
+				if (n) {
+					uint32_t pushed;
+
+					ret = buffer_append(parser, s + i, n, &pushed);
+					i += pushed;
+					if (ret || i == valid)
+						break;
+					ch = s[i];
+				}
+			} else if (parser->state == STATE_I0 || parser->state == STATE_R2 || parser->state == STATE_X3) {
+				/* digits of the number go to the buffer at once */
+				for (n = i; n < valid && s[n] >= '0' && s[n] <= '9'; n++)
+					;
+				if (n > i) {
+					uint32_t pushed;
+
+					ret = buffer_append(parser, s + i, n - i, &pushed);
+					i += pushed;
+					if (ret || i == valid)
+						break;
+					ch = s[i];
+				}
+			} else if (parser->state <= STATE__A && !(byte_flags[ch] & BYTE_TOKEN)) {
+				/* whitespace between tokens */
+				i = index_find(&index, i, BYTE_TOKEN);
+				if (i == valid)
+					break;
+				ch = s[i];
+			}
+		}
 		next_class = (ch >= 128) ? C_OTHER : character_class[ch];
 		if (next_class == C_ERROR) {
 			ret = JSON_ERROR_BAD_CHAR;
@@ -698,6 +1352,8 @@ int json_parser_string(json_parser *parser, const char *s,
 		if (ret)
 			break;
 	}
+	if (!ret)
+		ret = utf8_ret;
 	if (processed)
 		*processed = i;
 	return ret;
@@ -35,6 +35,8 @@ typedef enum
 	JSON_TRUE,
 	JSON_FALSE,
 	JSON_NULL,
+	/* string value passed as is, with escapes (only with inplace_strings) */
+	JSON_STRING_ESCAPED,
 } json_type;
 
 typedef enum
@@ -64,8 +66,21 @@ typedef enum
 	JSON_ERROR_COMMA_OUT_OF_STRUCTURE,
 	/* callback returns error */
 	JSON_ERROR_CALLBACK,
+	/* invalid utf-8 byte sequence (only with validate_utf8) */
+	JSON_ERROR_UTF8,
 } json_error;
 
+/* instruction set of the tokenizer stage, which classifies bytes of chunks
+ * into bitmaps (structural index) so string contents and whitespace are
+ * skipped in bulk; NONE passes every byte through the state machine */
+typedef enum
+{
+	JSON_SIMD_NONE,
+	JSON_SIMD_SCALAR,
+	JSON_SIMD_SSE2,
+	JSON_SIMD_AVX2,
+} json_simd;
+
 #define LIBJSON_DEFAULT_STACK_SIZE 256
 #define LIBJSON_DEFAULT_BUFFER_SIZE 4096
 
@@ -78,6 +93,14 @@ typedef struct {
 	uint32_t max_data;
 	int allow_c_comments;
 	int allow_yaml_comments;
+	/* strings completely inside of the chunk passed to json_parser_string
+	 * are passed to callback right from the chunk, not null terminated;
+	 * string values with escapes are passed as JSON_STRING_ESCAPED then
+	 * (json_unescape converts them), keys with escapes are buffered as usual */
+	int inplace_strings;
+	/* reject bytes, which aren't valid utf-8 (checked in bulk for the chunk,
+	 * sequences can be split between chunks) */
+	int validate_utf8;
 	void * (*user_calloc)(size_t nmemb, size_t size);
 	void * (*user_realloc)(void *ptr, size_t size);
 } json_config;
@@ -96,6 +119,12 @@ typedef struct json_parser {
 	uint16_t unicode_multi;
 	json_type type;
 
+	/* utf-8 sequence left incomplete by previous chunk:
+	 * continuation bytes needed and range of the next one */
+	uint8_t utf8_need;
+	uint8_t utf8_lo;
+	uint8_t utf8_hi;
+
 	/* state stack */
 	uint8_t *stack;
 	uint32_t stack_offset;
@@ -141,6 +170,20 @@ int json_parser_char(json_parser *parser, unsigned char next_char);
 /** json_parser_is_done return 0 is the parser isn't in a finish state. !0 if it is */
 int json_parser_is_done(json_parser *parser);
 
+/** json_simd_level return instruction set used by the tokenizer stage,
+ * the best one supported by cpu is chosen at first call (sse2 or avx2,
+ * none without them: scalar stage is used only if json_simd_limit asks for it) */
+int json_simd_level(void);
+
+/** json_simd_limit use instruction set not better than level (benchmarks, tests),
+ * return level actually used */
+int json_simd_limit(int level);
+
+/** json_unescape convert escapes of JSON_STRING_ESCAPED value (validated by the parser)
+ * into out, which has to have length bytes at least (result is never longer).
+ * return length of the result, it isn't null terminated */
+uint32_t json_unescape(const char *s, uint32_t length, char *out);
+
 /** json_print_init initialize a printer context. always succeed */
 int json_print_init(json_printer *printer, json_printer_callback callback, void *userdata);
 
@@ -0,0 +1,333 @@
+#include "connection.h"
+#include "access/xact.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils.h"
+
+/*
+ * connection pool entry
+ * holds idle handles for one server/user pair (list is LIFO,
+ * so most recently used handle - most likely alive connection - goes first)
+ */
+typedef struct ConnectionEntry
+{
+	ConnectionKey	key;		/* hash key (must be first) */
+	ConnectionHandle	*idle;
+	int			nidle;
+	int			idle_timeout;
+	CURLSH		*share;		/* connection, dns and tls session caches of handles */
+	int			nhandles;	/* open handles (idle and busy), share is closed with the last one */
+} ConnectionEntry;
+
+ConnectionStats	www_connection_stats = {0, 0, 0};
+
+static HTAB	*ConnectionHash = NULL;
+/* handles currently used by scans, closed on (sub)transaction abort */
+static ConnectionHandle	*busy_handles = NULL;
+
+static void connection_xact_callback(XactEvent event, void *arg);
+static void connection_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+										SubTransactionId parentSubid, void *arg);
+
+/*
+ * connection_close
+ * cleanup curl handle, connections of the server/user pair
+ * are closed with its last handle
+ */
+static
+void
+connection_close(ConnectionHandle *handle)
+{
+	ConnectionEntry		*entry;
+
+	d("closing curl handle for server %u, user %u", handle->key.serverid, handle->key.userid);
+
+	if (handle->multi)
+	{
+		curl_multi_remove_handle(handle->multi, handle->curl);
+		curl_multi_cleanup(handle->multi);
+	}
+	curl_easy_cleanup(handle->curl);
+
+	entry = (ConnectionEntry *) hash_search(ConnectionHash, &handle->key, HASH_FIND, NULL);
+	if (entry && 0 == --entry->nhandles && entry->share)
+	{
+		curl_share_cleanup(entry->share);
+		entry->share = NULL;
+	}
+	pfree(handle);
+	www_connection_stats.closed++;
+}
+
+/*
+ * connection_share
+ * share handle of the entry, created with its first handle:
+ * transfers of all handles of the server/user pair (easy or multi ones,
+ * multi handle of a scan included) take connections from the same cache,
+ * so they outlive multi handles, which are cleaned up after the scan
+ */
+static
+CURLSH*
+connection_share(ConnectionEntry *entry)
+{
+	if (NULL == entry->share)
+	{
+		entry->share = curl_share_init();
+		if (NULL == entry->share)
+			ereport(ERROR,
+				(errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+				errmsg("Can't initialize curl share handle")
+				));
+		/* backend is single threaded: no lock functions */
+		curl_share_setopt(entry->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(entry->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(entry->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+	}
+
+	return entry->share;
+}
+
+/*
+ * connection_init
+ * create pool hash table and register transaction callbacks
+ * pool lives till the end of backend
+ */
+static
+void
+connection_init(void)
+{
+	HASHCTL		ctl;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(ConnectionKey);
+	ctl.entrysize = sizeof(ConnectionEntry);
+	ctl.hash = tag_hash;
+	ctl.hcxt = CacheMemoryContext;
+	ConnectionHash = hash_create("www_fdw connections", 8, &ctl,
+								 HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	RegisterXactCallback(connection_xact_callback, NULL);
+	RegisterSubXactCallback(connection_subxact_callback, NULL);
+}
+
+/*
+ * connection_sweep
+ * close handles which were idle longer than idle_timeout of their entry
+ */
+static
+void
+connection_sweep(TimestampTz now)
+{
+	HASH_SEQ_STATUS	scan;
+	ConnectionEntry	*entry;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnectionEntry *) hash_seq_search(&scan)))
+	{
+		ConnectionHandle	**prev = &entry->idle,
+							*handle;
+
+		if (0 >= entry->idle_timeout)
+			continue;
+
+		while ((handle = *prev))
+		{
+			if (TimestampDifferenceExceeds(handle->last_used, now, entry->idle_timeout * 1000))
+			{
+				*prev = handle->next;
+				entry->nidle--;
+				connection_close(handle);
+			}
+			else
+				prev = &handle->next;
+		}
+	}
+}
+
+/*
+ * connection_forget_busy
+ * remove handle from busy list
+ */
+static
+void
+connection_forget_busy(ConnectionHandle *handle)
+{
+	ConnectionHandle	**prev;
+
+	for (prev = &busy_handles; *prev; prev = &(*prev)->next)
+	{
+		if (*prev == handle)
+		{
+			*prev = handle->next;
+			handle->next = NULL;
+			return;
+		}
+	}
+}
+
+/* read description in header file (to keep in single place) */
+ConnectionHandle*
+www_connection_acquire(Oid serverid, Oid userid, int idle_timeout)
+{
+	ConnectionKey		key;
+	ConnectionEntry		*entry;
+	ConnectionHandle	*handle;
+	bool				found;
+
+	if (NULL == ConnectionHash)
+		connection_init();
+
+	MemSet(&key, 0, sizeof(key));
+	key.serverid = serverid;
+	key.userid = userid;
+
+	entry = (ConnectionEntry *) hash_search(ConnectionHash, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->idle = NULL;
+		entry->nidle = 0;
+		entry->share = NULL;
+		entry->nhandles = 0;
+	}
+	entry->idle_timeout = idle_timeout;
+
+	/* don't hand out connections server has likely dropped already */
+	connection_sweep(GetCurrentTimestamp());
+
+	if (entry->idle)
+	{
+		handle = entry->idle;
+		entry->idle = handle->next;
+		entry->nidle--;
+		handle->reused = true;
+		www_connection_stats.reused++;
+
+		d("reusing curl handle for server %u, user %u", serverid, userid);
+	}
+	else
+	{
+		handle = (ConnectionHandle *) MemoryContextAlloc(TopMemoryContext, sizeof(ConnectionHandle));
+		handle->curl = curl_easy_init();
+		if (NULL == handle->curl)
+		{
+			pfree(handle);
+			ereport(ERROR,
+				(errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+				errmsg("Can't initialize curl handle")
+				));
+		}
+		/* curl_easy_reset of released handle keeps the share */
+		curl_easy_setopt(handle->curl, CURLOPT_SHARE, connection_share(entry));
+		entry->nhandles++;
+		handle->multi = NULL;
+		handle->key = key;
+		handle->reused = false;
+		www_connection_stats.created++;
+
+		d("new curl handle for server %u, user %u", serverid, userid);
+	}
+
+	handle->xact_depth = GetCurrentTransactionNestLevel();
+	handle->next = busy_handles;
+	busy_handles = handle;
+
+	return handle;
+}
+
+/* read description in header file (to keep in single place) */
+void
+www_connection_release(ConnectionHandle *handle, int max_per_host)
+{
+	ConnectionEntry		*entry;
+
+	connection_forget_busy(handle);
+
+	entry = (ConnectionEntry *) hash_search(ConnectionHash, &handle->key, HASH_FIND, NULL);
+	if (NULL == entry || entry->nidle >= max_per_host)
+	{
+		connection_close(handle);
+		return;
+	}
+
+	/* drop all options set by the scan, live connections are kept */
+	if (handle->multi)
+		curl_multi_remove_handle(handle->multi, handle->curl);
+	curl_easy_reset(handle->curl);
+	handle->last_used = GetCurrentTimestamp();
+	handle->next = entry->idle;
+	entry->idle = handle;
+	entry->nidle++;
+}
+
+/* read description in header file (to keep in single place) */
+CURLM*
+www_connection_multi(ConnectionHandle *handle)
+{
+	if (NULL == handle->multi)
+	{
+		handle->multi = curl_multi_init();
+		if (NULL == handle->multi)
+			ereport(ERROR,
+				(errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+				errmsg("Can't initialize curl multi handle")
+				));
+	}
+
+	return handle->multi;
+}
+
+/*
+ * connection_xact_callback
+ * close handles left by failed scans: error could be raised in the middle
+ * of a transfer, so handle state is unknown and it can't be reused
+ */
+static
+void
+connection_xact_callback(XactEvent event, void *arg)
+{
+	ConnectionHandle	*handle;
+
+	if (XACT_EVENT_ABORT != event
+#if PG_VERSION_NUM >= 90500
+		&& XACT_EVENT_PARALLEL_ABORT != event
+#endif
+	)
+		return;
+
+	while ((handle = busy_handles))
+	{
+		busy_handles = handle->next;
+		connection_close(handle);
+	}
+}
+
+/*
+ * connection_subxact_callback
+ * same as connection_xact_callback, but for handles acquired
+ * inside of aborted subtransaction only
+ */
+static
+void
+connection_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+							SubTransactionId parentSubid, void *arg)
+{
+	ConnectionHandle	**prev = &busy_handles,
+						*handle;
+	int					depth = GetCurrentTransactionNestLevel();
+
+	if (SUBXACT_EVENT_ABORT_SUB != event)
+		return;
+
+	while ((handle = *prev))
+	{
+		if (handle->xact_depth >= depth)
+		{
+			*prev = handle->next;
+			connection_close(handle);
+		}
+		else
+			prev = &handle->next;
+	}
+}
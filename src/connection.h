@@ -0,0 +1,75 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "postgres.h"
+#include "utils/timestamp.h"
+
+#include "curl/curl.h"
+
+/*
+ * connection pool key
+ * handles are reused only for the same foreign server and user mapping,
+ * so credentials/certificates never leak between mappings
+ */
+typedef struct ConnectionKey
+{
+	Oid			serverid;
+	Oid			userid;
+} ConnectionKey;
+
+/*
+ * pooled curl easy handle
+ * handles of the same server/user pair share connection cache, dns cache
+ * and tls session ids (curl share handle of the pool), so keeping handles
+ * alive keeps connections alive, whatever multi handle drives the transfer
+ */
+typedef struct ConnectionHandle
+{
+	CURL		*curl;
+	CURLM		*multi;		/* created on demand, connections are in the share */
+	ConnectionKey	key;
+	TimestampTz	last_used;
+	int			xact_depth;	/* subtransaction level handle was acquired at */
+	bool		reused;		/* handle was taken from the pool */
+	struct ConnectionHandle	*next;
+} ConnectionHandle;
+
+/*
+ * backend-wide pool counters
+ * created - new easy handles (new connections)
+ * reused - handles taken from the pool (connection setup avoided)
+ * closed - handles closed by idle timeout, pool limit or error
+ */
+typedef struct ConnectionStats
+{
+	uint64		created;
+	uint64		reused;
+	uint64		closed;
+} ConnectionStats;
+
+extern ConnectionStats	www_connection_stats;
+
+/* www_connection_acquire
+ * returns reset curl handle for the server/user pair
+ * idle handle is reused if pool has one, new handle is created otherwise
+ * idle_timeout - seconds after which idle handles are closed, 0 - never
+ */
+ConnectionHandle*
+www_connection_acquire(Oid serverid, Oid userid, int idle_timeout);
+
+/* www_connection_release
+ * resets handle and puts it back into the pool
+ * handle is closed if pool for the key has max_per_host idle handles already
+ * max_per_host 0 disables pooling
+ */
+void
+www_connection_release(ConnectionHandle *handle, int max_per_host);
+
+/* www_connection_multi
+ * returns multi handle of the pooled handle, creates it on first call
+ * multi handle is used for transfers driven by the scan (streaming)
+ */
+CURLM*
+www_connection_multi(ConnectionHandle *handle);
+
+#endif
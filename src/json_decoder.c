@@ -0,0 +1,1217 @@
+#include "json_decoder.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#if PG_VERSION_NUM >= 90500
+ #include "utils/uuid.h"
+#endif
+#if PG_VERSION_NUM >= 90300
+ #include "utils/json.h"
+#endif
+#include "utils.h"
+
+#include <limits.h>
+
+/* roles of json containers outside of rows */
+#define JSON_DECODER_PLAIN		0	/* can't be result, but can contain it */
+#define JSON_DECODER_CANDIDATE	1	/* array, which can be result */
+#define JSON_DECODER_RESULT		2	/* result array, its objects are rows */
+
+#define JSON_INT64_MAX		INT64CONST(0x7FFFFFFFFFFFFFFF)
+#define JSON_UINT64_MAX		UINT64CONST(0xFFFFFFFFFFFFFFFF)
+
+static void json_decoder_event(JSONDecoder *decoder, int type, const char *data, uint32 length);
+
+/*
+ * json_decoder_push
+ * open container (outside of rows) with specified role
+ */
+static
+void
+json_decoder_push(JSONDecoder *decoder, char role)
+{
+	if (decoder->depth >= decoder->roles_size)
+	{
+		decoder->roles_size *= 2;
+		decoder->roles = (char *) repalloc(decoder->roles, decoder->roles_size * sizeof(char));
+	}
+	decoder->roles[decoder->depth++] = role;
+}
+
+/*
+ * json_decoder_log
+ * save event of not recognized object
+ */
+static
+void
+json_decoder_log(JSONDecoder *decoder, int type, const char *data, uint32 length)
+{
+	JSONDecoderEvent	*event;
+
+	if (decoder->nlog >= decoder->log_size)
+	{
+		if (NULL == decoder->log)
+		{
+			decoder->log_size = 64;
+			decoder->log = (JSONDecoderEvent *) MemoryContextAlloc(decoder->log_cxt,
+												decoder->log_size * sizeof(JSONDecoderEvent));
+		}
+		else
+		{
+			decoder->log_size *= 2;
+			decoder->log = (JSONDecoderEvent *) repalloc(decoder->log,
+												decoder->log_size * sizeof(JSONDecoderEvent));
+		}
+	}
+
+	event = &decoder->log[decoder->nlog++];
+	event->type = type;
+	event->length = length;
+	event->data = NULL;
+	if (data)
+	{
+		event->data = (char *) MemoryContextAlloc(decoder->log_cxt, length + 1);
+		memcpy(event->data, data, length);
+		event->data[length] = '\0';
+	}
+}
+
+/*
+ * json_decoder_forget
+ * drop events of recognized object
+ * events are freed only outside of replays (replayed events are in the same context)
+ */
+static
+void
+json_decoder_forget(JSONDecoder *decoder)
+{
+	if (0 == decoder->replaying)
+	{
+		MemoryContextReset(decoder->log_cxt);
+		decoder->log = NULL;
+		decoder->log_size = 0;
+	}
+	decoder->nlog = 0;
+}
+
+/*
+ * json_decoder_column
+ * column for the key of row object
+ * returns -1 if there isn't such column or it was set already
+ */
+static
+int
+json_decoder_column(JSONDecoder *decoder, const char *key, uint32 length)
+{
+	int			i;
+
+	for (i = 0; i < decoder->tuple_desc->natts; i++)
+	{
+		Form_pg_attribute	attr = decoder->tuple_desc->attrs[i];
+
+		if (attr->attisdropped)
+			continue;
+
+		if (0 == strncmp(NameStr(attr->attname), key, length) && '\0' == NameStr(attr->attname)[length])
+			return decoder->assigned[i] ? -1 : i;
+	}
+
+	return -1;
+}
+
+/*
+ * json_parse_int64
+ * parse json integer token, false on overflow
+ */
+static
+bool
+json_parse_int64(const char *data, uint32 length, int64 *result)
+{
+	const char	*end = data + length;
+	bool		neg = false;
+	uint64		value = 0;
+
+	if (data < end && '-' == *data)
+	{
+		neg = true;
+		data++;
+	}
+	if (data == end)
+		return false;
+
+	for (; data < end; data++)
+	{
+		if (*data < '0' || *data > '9')
+			return false;
+		/* stop before value can overflow, input function reports the error */
+		if (value > (JSON_UINT64_MAX - 9) / 10)
+			return false;
+		value = value * 10 + (*data - '0');
+	}
+
+	if (neg)
+	{
+		if (value > (uint64) JSON_INT64_MAX + 1)
+			return false;
+		*result = (int64) (0 - value);
+	}
+	else
+	{
+		if (value > (uint64) JSON_INT64_MAX)
+			return false;
+		*result = (int64) value;
+	}
+	return true;
+}
+
+static
+bool
+json_decode_int2(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	int64		v;
+
+	if (JSON_INT != type || !json_parse_int64(data, length, &v) || v < SHRT_MIN || v > SHRT_MAX)
+		return false;
+	*value = Int16GetDatum((int16) v);
+	return true;
+}
+
+static
+bool
+json_decode_int4(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	int64		v;
+
+	if (JSON_INT != type || !json_parse_int64(data, length, &v) || v < INT_MIN || v > INT_MAX)
+		return false;
+	*value = Int32GetDatum((int32) v);
+	return true;
+}
+
+static
+bool
+json_decode_int8(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	int64		v;
+
+	if (JSON_INT != type || !json_parse_int64(data, length, &v))
+		return false;
+	*value = Int64GetDatum(v);
+	return true;
+}
+
+/*
+ * json_parse_double
+ * json number syntax is accepted by strtod as is
+ */
+static
+bool
+json_parse_double(int type, const char *data, uint32 length, double *result)
+{
+	char		buf[64];
+	char		*end;
+
+	if ((JSON_INT != type && JSON_FLOAT != type) || length >= sizeof(buf))
+		return false;
+
+	memcpy(buf, data, length);
+	buf[length] = '\0';
+	errno = 0;
+	*result = strtod(buf, &end);
+
+	return end == buf + length && 0 == errno;
+}
+
+/*
+ * json_parse_float
+ * parsed by strtof like float4in does (rounding of double to float can differ)
+ */
+static
+bool
+json_parse_float(int type, const char *data, uint32 length, float4 *result)
+{
+	char		buf[64];
+	char		*end;
+
+	if ((JSON_INT != type && JSON_FLOAT != type) || length >= sizeof(buf))
+		return false;
+
+	memcpy(buf, data, length);
+	buf[length] = '\0';
+	errno = 0;
+	*result = strtof(buf, &end);
+
+	return end == buf + length && 0 == errno;
+}
+
+static
+bool
+json_decode_float4(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	float4		v;
+
+	/* out of float4 range: let float4in report it */
+	if (!json_parse_float(type, data, length, &v))
+		return false;
+	*value = Float4GetDatum(v);
+	return true;
+}
+
+static
+bool
+json_decode_float8(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	double		v;
+
+	if (!json_parse_double(type, data, length, &v))
+		return false;
+	*value = Float8GetDatum(v);
+	return true;
+}
+
+static
+bool
+json_decode_numeric(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	if (JSON_INT != type && JSON_FLOAT != type)
+		return false;
+	*value = DirectFunctionCall3(numeric_in,
+								 CStringGetDatum(pnstrdup(data, length)),
+								 ObjectIdGetDatum(InvalidOid),
+								 Int32GetDatum(decoder->attinmeta->atttypmods[column]));
+	return true;
+}
+
+static
+bool
+json_decode_bool(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	if (JSON_TRUE != type && JSON_FALSE != type)
+		return false;
+	*value = BoolGetDatum(JSON_TRUE == type);
+	return true;
+}
+
+/*
+ * json_decode_text
+ * escaped string is unescaped right into the text (it never gets longer)
+ */
+static
+bool
+json_decode_text(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	text	   *result;
+
+	if (JSON_STRING_ESCAPED != type)
+	{
+		*value = PointerGetDatum(cstring_to_text_with_len(data, length));
+		return true;
+	}
+
+	result = (text *) palloc(length + VARHDRSZ);
+	SET_VARSIZE(result, json_unescape(data, length, VARDATA(result)) + VARHDRSZ);
+	*value = PointerGetDatum(result);
+	return true;
+}
+
+/*
+ * json_parse_digits
+ * fixed number of digits
+ */
+static
+bool
+json_parse_digits(const char **data, const char *end, int n, int *result)
+{
+	const char	*p = *data;
+
+	if (end - p < n)
+		return false;
+
+	*result = 0;
+	for (; n > 0; n--, p++)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		*result = *result * 10 + (*p - '0');
+	}
+	*data = p;
+	return true;
+}
+
+/*
+ * json_parse_date
+ * ISO 8601 date YYYY-MM-DD, returns days since postgres epoch
+ */
+static
+bool
+json_parse_date(const char **data, const char *end, int *result)
+{
+	int			year, mon, mday;
+
+	if (!json_parse_digits(data, end, 4, &year) || *data >= end || '-' != *(*data)++ ||
+		!json_parse_digits(data, end, 2, &mon) || *data >= end || '-' != *(*data)++ ||
+		!json_parse_digits(data, end, 2, &mday))
+		return false;
+
+	if (year < 1 || mon < 1 || mon > 12 || mday < 1 || mday > day_tab[isleap(year)][mon - 1])
+		return false;
+
+	*result = date2j(year, mon, mday) - POSTGRES_EPOCH_JDATE;
+	return true;
+}
+
+static
+bool
+json_decode_date(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	const char	*end = data + length;
+	int			days;
+
+	if (JSON_STRING != type || !json_parse_date(&data, end, &days) || data != end)
+		return false;
+	*value = DateADTGetDatum((DateADT) days);
+	return true;
+}
+
+#if PG_VERSION_NUM >= 100000 || defined(HAVE_INT64_TIMESTAMP)
+/*
+ * json_parse_timestamp
+ * ISO 8601 timestamp YYYY-MM-DD(T| )HH:MM:SS[.ffffff][Z|(+|-)HH[[:]MM]]
+ * has_zone - zone was specified, result is converted to UTC then
+ * anything else (special values, more precision, leap second) goes to input function
+ */
+static
+bool
+json_parse_timestamp(const char *data, uint32 length, Timestamp *result, bool *has_zone)
+{
+	const char	*end = data + length;
+	int			days, hour, min, sec, usec = 0, digits = 0, tzhour, tzmin = 0;
+	char		sign;
+
+	if (!json_parse_date(&data, end, &days) || data >= end || ('T' != *data && ' ' != *data))
+		return false;
+	data++;
+	if (!json_parse_digits(&data, end, 2, &hour) || data >= end || ':' != *data++ ||
+		!json_parse_digits(&data, end, 2, &min) || data >= end || ':' != *data++ ||
+		!json_parse_digits(&data, end, 2, &sec))
+		return false;
+
+	if (hour > 23 || min > 59 || sec > 59)
+		return false;
+
+	if (data < end && '.' == *data)
+	{
+		for (data++; data < end && *data >= '0' && *data <= '9'; data++, digits++)
+		{
+			if (digits >= 6)
+				return false;
+			usec = usec * 10 + (*data - '0');
+		}
+		if (0 == digits)
+			return false;
+		for (; digits < 6; digits++)
+			usec *= 10;
+	}
+
+	*result = (Timestamp) days * USECS_PER_DAY +
+		((Timestamp) ((hour * 60 + min) * 60 + sec)) * USECS_PER_SEC + usec;
+
+	*has_zone = data < end;
+	if (data == end)
+		return true;
+
+	if ('Z' == *data)
+		return data + 1 == end;
+
+	sign = *data++;
+	if (('+' != sign && '-' != sign) || !json_parse_digits(&data, end, 2, &tzhour))
+		return false;
+	/* minutes are optional, but not after colon */
+	if (data < end && ':' == *data)
+	{
+		data++;
+		if (!json_parse_digits(&data, end, 2, &tzmin))
+			return false;
+	}
+	else if (data < end && !json_parse_digits(&data, end, 2, &tzmin))
+		return false;
+	if (data != end || tzhour > 15 || tzmin > 59)
+		return false;
+
+	/* local time = UTC + offset */
+	if ('+' == sign)
+		*result -= ((Timestamp) (tzhour * 60 + tzmin)) * USECS_PER_MINUTE;
+	else
+		*result += ((Timestamp) (tzhour * 60 + tzmin)) * USECS_PER_MINUTE;
+	return true;
+}
+
+static
+bool
+json_decode_timestamp(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	Timestamp	ts;
+	bool		has_zone;
+
+	/* timestamp input ignores zone: leave it to input function */
+	if (JSON_STRING != type || !json_parse_timestamp(data, length, &ts, &has_zone) || has_zone)
+		return false;
+	*value = TimestampGetDatum(ts);
+	return true;
+}
+
+static
+bool
+json_decode_timestamptz(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	Timestamp	ts;
+	bool		has_zone;
+
+	/* without zone session time zone is used: leave it to input function */
+	if (JSON_STRING != type || !json_parse_timestamp(data, length, &ts, &has_zone) || !has_zone)
+		return false;
+	*value = TimestampTzGetDatum((TimestampTz) ts);
+	return true;
+}
+#endif
+
+#if PG_VERSION_NUM >= 90500
+static
+int
+json_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * json_decode_uuid
+ * canonical form only: xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+ */
+static
+bool
+json_decode_uuid(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	pg_uuid_t	uuid;
+	int			i, j, hi, lo;
+
+	if (JSON_STRING != type || 36 != length)
+		return false;
+
+	for (i = 0, j = 0; i < UUID_LEN; i++)
+	{
+		if (8 == j || 13 == j || 18 == j || 23 == j)
+		{
+			if ('-' != data[j++])
+				return false;
+		}
+		hi = json_hex_digit(data[j++]);
+		lo = json_hex_digit(data[j++]);
+		if (0 > hi || 0 > lo)
+			return false;
+		uuid.data[i] = (unsigned char) (hi << 4 | lo);
+	}
+
+	*value = UUIDPGetDatum((pg_uuid_t *) memcpy(palloc(sizeof(pg_uuid_t)), &uuid, sizeof(pg_uuid_t)));
+	return true;
+}
+#endif
+
+#if PG_VERSION_NUM >= 90300
+/*
+ * json_decode_json
+ * scalar of json/jsonb column: token is converted back to json text
+ * (nested containers of such columns are captured in json_decoder_capture)
+ */
+static
+bool
+json_decode_json(JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value)
+{
+	StringInfoData	buf;
+
+	initStringInfo(&buf);
+	if (JSON_STRING == type)
+		escape_json(&buf, pnstrdup(data, length));
+	else if (JSON_STRING_ESCAPED == type)
+	{
+		/* it's valid json string already */
+		appendStringInfoChar(&buf, '"');
+		appendBinaryStringInfo(&buf, data, length);
+		appendStringInfoChar(&buf, '"');
+	}
+	else
+		appendBinaryStringInfo(&buf, data, length);
+
+	*value = InputFunctionCall(&decoder->attinmeta->attinfuncs[column],
+							   buf.data,
+							   decoder->attinmeta->attioparams[column],
+							   decoder->attinmeta->atttypmods[column]);
+	return true;
+}
+#endif
+
+/*
+ * json_decoder_for_column
+ * choose decoder by column type, domains and types with modifiers,
+ * which can't be applied here, use input function
+ */
+static
+JSONColumnDecoder
+json_decoder_for_column(Form_pg_attribute attr, bool *capture)
+{
+	*capture = false;
+
+	if (attr->attisdropped)
+		return NULL;
+
+	switch (attr->atttypid)
+	{
+		case INT2OID:
+			return json_decode_int2;
+		case INT4OID:
+			return json_decode_int4;
+		case INT8OID:
+			return json_decode_int8;
+		case FLOAT4OID:
+			return json_decode_float4;
+		case FLOAT8OID:
+			return json_decode_float8;
+		case NUMERICOID:
+			return json_decode_numeric;
+		case BOOLOID:
+			return json_decode_bool;
+		case TEXTOID:
+			return json_decode_text;
+		case DATEOID:
+			return json_decode_date;
+#if PG_VERSION_NUM >= 100000 || defined(HAVE_INT64_TIMESTAMP)
+		case TIMESTAMPOID:
+			return 0 > attr->atttypmod ? json_decode_timestamp : NULL;
+		case TIMESTAMPTZOID:
+			return 0 > attr->atttypmod ? json_decode_timestamptz : NULL;
+#endif
+#if PG_VERSION_NUM >= 90500
+		case UUIDOID:
+			return json_decode_uuid;
+#endif
+#if PG_VERSION_NUM >= 90300
+		case JSONOID:
+#if PG_VERSION_NUM >= 90400
+		case JSONBOID:
+#endif
+			*capture = true;
+			return json_decode_json;
+#endif
+	}
+
+	return NULL;
+}
+
+/*
+ * json_decoder_row_begin
+ * start new row, tentative - row isn't recognized yet (first object of array)
+ */
+static
+void
+json_decoder_row_begin(JSONDecoder *decoder, bool tentative)
+{
+	int			i;
+
+	for (i = 0; i < decoder->tuple_desc->natts; i++)
+	{
+		decoder->values[i] = (Datum) 0;
+		decoder->isnull[i] = true;
+		decoder->assigned[i] = false;
+	}
+	decoder->row_depth = 1;
+	decoder->column = -1;
+	decoder->capturing = -1;
+	decoder->tentative = tentative;
+	if (decoder->deferred)
+		resetStringInfo(&decoder->raw);
+}
+
+/*
+ * json_unescaped
+ * null terminated copy of string token, escapes of JSON_STRING_ESCAPED are converted
+ */
+static
+char *
+json_unescaped(int type, const char *data, uint32 length)
+{
+	char	   *result;
+
+	if (JSON_STRING_ESCAPED != type)
+		return pnstrdup(data, length);
+
+	result = (char *) palloc(length + 1);
+	result[json_unescape(data, length, result)] = '\0';
+	return result;
+}
+
+/*
+ * json_decoder_datum
+ * convert scalar token of the column with its decoder or input function
+ * (json null/true/false are passed to input function as text, the same as strings and numbers)
+ * only text and json decoders take escaped strings as is, others see them as not matching
+ */
+static
+Datum
+json_decoder_datum(JSONDecoder *decoder, int column, int type, const char *data, uint32 length)
+{
+	JSONColumnDecoder	column_decoder = decoder->decoders[column];
+	Datum		value;
+
+	switch (type)
+	{
+		case JSON_NULL:
+			data = "null";
+			length = 4;
+			break;
+		case JSON_TRUE:
+			data = "true";
+			length = 4;
+			break;
+		case JSON_FALSE:
+			data = "false";
+			length = 5;
+			break;
+	}
+
+	if (NULL == column_decoder || !column_decoder(decoder, column, type, data, length, &value))
+		value = InputFunctionCall(&decoder->attinmeta->attinfuncs[column],
+								  json_unescaped(type, data, length),
+								  decoder->attinmeta->attioparams[column],
+								  decoder->attinmeta->atttypmods[column]);
+	return value;
+}
+
+/*
+ * json_decoder_keep
+ * keep raw token of deferred column: column, type, length and data
+ * (null terminated) are appended to raw tokens of the row
+ * type JSON_OBJECT_BEGIN - captured json text of nested container,
+ * JSON_ARRAY_BEGIN - nested container of column, which isn't captured (null)
+ */
+static
+void
+json_decoder_keep(JSONDecoder *decoder, int column, int type, const char *data, uint32 length)
+{
+	int16		header[2];
+
+	header[0] = (int16) column;
+	header[1] = (int16) type;
+	appendBinaryStringInfo(&decoder->raw, (char *) header, sizeof(header));
+	appendBinaryStringInfo(&decoder->raw, (char *) &length, sizeof(length));
+	appendBinaryStringInfo(&decoder->raw, data, length);
+	appendStringInfoChar(&decoder->raw, '\0');
+
+	decoder->assigned[column] = true;
+}
+
+/*
+ * json_decoder_value
+ * convert scalar value of the column with its decoder or input function
+ * (json null/true/false are passed to input function as text, the same as strings and numbers)
+ * value of deferred column is kept as is
+ */
+static
+void
+json_decoder_value(JSONDecoder *decoder, int type, const char *data, uint32 length)
+{
+	int			column = decoder->column;
+	MemoryContext	oldcontext;
+
+	decoder->column = -1;
+	if (decoder->deferred && decoder->deferred[column])
+	{
+		json_decoder_keep(decoder, column, type, data, length);
+		return;
+	}
+
+	oldcontext = MemoryContextSwitchTo(decoder->row_cxt);
+	decoder->values[column] = json_decoder_datum(decoder, column, type, data, length);
+	MemoryContextSwitchTo(oldcontext);
+
+	decoder->isnull[column] = false;
+	decoder->assigned[column] = true;
+}
+
+#if PG_VERSION_NUM >= 90300
+/*
+ * json_decoder_capture
+ * append event of nested container of json/jsonb column to its text
+ */
+static
+void
+json_decoder_capture(JSONDecoder *decoder, int type, const char *data, uint32 length)
+{
+	StringInfo	buf = &decoder->captured;
+	char		last = buf->len ? buf->data[buf->len - 1] : '\0';
+	MemoryContext	oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(decoder->row_cxt);
+
+	if (JSON_OBJECT_END != type && JSON_ARRAY_END != type &&
+		'\0' != last && '{' != last && '[' != last && ':' != last)
+		appendStringInfoChar(buf, ',');
+
+	switch (type)
+	{
+		case JSON_OBJECT_BEGIN:
+			appendStringInfoChar(buf, '{');
+			break;
+		case JSON_ARRAY_BEGIN:
+			appendStringInfoChar(buf, '[');
+			break;
+		case JSON_OBJECT_END:
+			appendStringInfoChar(buf, '}');
+			break;
+		case JSON_ARRAY_END:
+			appendStringInfoChar(buf, ']');
+			break;
+		case JSON_KEY:
+			escape_json(buf, pnstrdup(data, length));
+			appendStringInfoChar(buf, ':');
+			break;
+		case JSON_STRING:
+			escape_json(buf, pnstrdup(data, length));
+			break;
+		case JSON_STRING_ESCAPED:
+			appendStringInfoChar(buf, '"');
+			appendBinaryStringInfo(buf, data, length);
+			appendStringInfoChar(buf, '"');
+			break;
+		case JSON_INT:
+		case JSON_FLOAT:
+			appendBinaryStringInfo(buf, data, length);
+			break;
+		case JSON_NULL:
+			appendStringInfoString(buf, "null");
+			break;
+		case JSON_TRUE:
+			appendStringInfoString(buf, "true");
+			break;
+		case JSON_FALSE:
+			appendStringInfoString(buf, "false");
+			break;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * json_decoder_captured
+ * nested container of json/jsonb column is closed: convert its text
+ */
+static
+void
+json_decoder_captured(JSONDecoder *decoder)
+{
+	int			column = decoder->capturing;
+	MemoryContext	oldcontext;
+
+	decoder->capturing = -1;
+	if (decoder->deferred && decoder->deferred[column])
+	{
+		json_decoder_keep(decoder, column, JSON_OBJECT_BEGIN, decoder->captured.data, decoder->captured.len);
+		return;
+	}
+
+	oldcontext = MemoryContextSwitchTo(decoder->row_cxt);
+	decoder->values[column] = InputFunctionCall(&decoder->attinmeta->attinfuncs[column],
+												decoder->captured.data,
+												decoder->attinmeta->attioparams[column],
+												decoder->attinmeta->atttypmods[column]);
+	MemoryContextSwitchTo(oldcontext);
+
+	decoder->isnull[column] = false;
+}
+#endif
+
+/*
+ * json_decoder_replay
+ * object ends without keys matching columns: its array isn't result
+ * replay object's events as plain structure to search result inside of it
+ */
+static
+void
+json_decoder_replay(JSONDecoder *decoder)
+{
+	JSONDecoderEvent	*log = decoder->log;
+	int			nlog = decoder->nlog;
+	int			i;
+
+	decoder->roles[decoder->depth - 1] = JSON_DECODER_PLAIN;
+	decoder->tentative = false;
+	decoder->row_depth = 0;
+	decoder->log = NULL;
+	decoder->nlog = 0;
+	decoder->log_size = 0;
+
+	decoder->replaying++;
+	for (i = 0; i < nlog; i++)
+		json_decoder_event(decoder, log[i].type, log[i].data, log[i].length);
+	decoder->replaying--;
+
+	/* replayed object is balanced: nothing is left unrecognized after it */
+	json_decoder_forget(decoder);
+}
+
+/*
+ * json_decoder_row_end
+ * pass decoded row to the callback
+ */
+static
+void
+json_decoder_row_end(JSONDecoder *decoder)
+{
+	MemoryContext	oldcontext;
+	int			i;
+
+	if (decoder->tentative)
+	{
+		json_decoder_replay(decoder);
+		return;
+	}
+
+	/* missing columns are passed to input functions as well, same as BuildTupleFromCStrings does */
+	oldcontext = MemoryContextSwitchTo(decoder->row_cxt);
+	for (i = 0; i < decoder->tuple_desc->natts; i++)
+	{
+		if (!decoder->assigned[i] && !decoder->tuple_desc->attrs[i]->attisdropped
+			&& (NULL == decoder->used || decoder->used[i])
+			&& (NULL == decoder->deferred || !decoder->deferred[i]))
+			decoder->values[i] = InputFunctionCall(&decoder->attinmeta->attinfuncs[i],
+												   NULL,
+												   decoder->attinmeta->attioparams[i],
+												   decoder->attinmeta->atttypmods[i]);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	decoder->row_callback(decoder->row_arg, decoder->values, decoder->isnull,
+						  decoder->deferred ? &decoder->raw : NULL);
+	MemoryContextReset(decoder->row_cxt);
+}
+
+/*
+ * json_decoder_row_event
+ * event inside of the row: only top level keys/values of row object are decoded,
+ * nested containers are captured for json/jsonb columns
+ * and skipped for other ones (column value is null for them)
+ */
+static
+void
+json_decoder_row_event(JSONDecoder *decoder, int type, const char *data, uint32 length)
+{
+	switch (type)
+	{
+		case JSON_OBJECT_BEGIN:
+		case JSON_ARRAY_BEGIN:
+			if (1 == decoder->row_depth && 0 <= decoder->column)
+			{
+#if PG_VERSION_NUM >= 90300
+				if (decoder->capture[decoder->column])
+				{
+					MemoryContext	oldcontext = MemoryContextSwitchTo(decoder->row_cxt);
+
+					initStringInfo(&decoder->captured);
+					MemoryContextSwitchTo(oldcontext);
+					decoder->capturing = decoder->column;
+				}
+				else
+#endif
+				if (decoder->deferred && decoder->deferred[decoder->column])
+					json_decoder_keep(decoder, decoder->column, JSON_ARRAY_BEGIN, "", 0);
+				decoder->assigned[decoder->column] = true;
+				decoder->column = -1;
+			}
+#if PG_VERSION_NUM >= 90300
+			if (0 <= decoder->capturing)
+				json_decoder_capture(decoder, type, data, length);
+#endif
+			decoder->row_depth++;
+			break;
+		case JSON_OBJECT_END:
+		case JSON_ARRAY_END:
+#if PG_VERSION_NUM >= 90300
+			if (0 <= decoder->capturing)
+				json_decoder_capture(decoder, type, data, length);
+#endif
+			if (0 == --decoder->row_depth)
+				json_decoder_row_end(decoder);
+#if PG_VERSION_NUM >= 90300
+			else if (1 == decoder->row_depth && 0 <= decoder->capturing)
+				json_decoder_captured(decoder);
+#endif
+			break;
+		case JSON_KEY:
+#if PG_VERSION_NUM >= 90300
+			if (0 <= decoder->capturing)
+			{
+				json_decoder_capture(decoder, type, data, length);
+				break;
+			}
+#endif
+			if (1 != decoder->row_depth)
+				break;
+
+			decoder->column = json_decoder_column(decoder, data, length);
+			if (0 <= decoder->column && decoder->tentative)
+			{
+				d("Result array was found in json response");
+
+				decoder->tentative = false;
+				decoder->roles[decoder->depth - 1] = JSON_DECODER_RESULT;
+				decoder->found = true;
+				json_decoder_forget(decoder);
+			}
+			/* value of column, which isn't needed, is skipped as unknown key */
+			if (0 <= decoder->column && decoder->used && !decoder->used[decoder->column])
+				decoder->column = -1;
+			break;
+		case JSON_STRING:
+		case JSON_STRING_ESCAPED:
+		case JSON_INT:
+		case JSON_FLOAT:
+		case JSON_NULL:
+		case JSON_TRUE:
+		case JSON_FALSE:
+#if PG_VERSION_NUM >= 90300
+			if (0 <= decoder->capturing)
+				json_decoder_capture(decoder, type, data, length);
+			else
+#endif
+			if (1 == decoder->row_depth && 0 <= decoder->column)
+				json_decoder_value(decoder, type, data, length);
+			break;
+	}
+}
+
+/*
+ * json_decoder_event
+ * keeps track of open containers and their roles,
+ * objects of candidate/result arrays are decoded as rows
+ */
+static
+void
+json_decoder_event(JSONDecoder *decoder, int type, const char *data, uint32 length)
+{
+	char		parent;
+
+	if (decoder->tentative)
+		json_decoder_log(decoder, type, data, length);
+
+	if (0 < decoder->row_depth)
+	{
+		json_decoder_row_event(decoder, type, data, length);
+		return;
+	}
+
+	parent = 0 < decoder->depth ? decoder->roles[decoder->depth - 1] : JSON_DECODER_PLAIN;
+	switch (type)
+	{
+		case JSON_OBJECT_BEGIN:
+			if (!decoder->finished && (JSON_DECODER_CANDIDATE == parent || JSON_DECODER_RESULT == parent))
+			{
+				json_decoder_row_begin(decoder, JSON_DECODER_CANDIDATE == parent);
+				if (decoder->tentative)
+					json_decoder_log(decoder, type, data, length);
+			}
+			else
+				json_decoder_push(decoder, JSON_DECODER_PLAIN);
+			break;
+		case JSON_ARRAY_BEGIN:
+			/* array of arrays isn't result */
+			if (JSON_DECODER_CANDIDATE == parent)
+				decoder->roles[decoder->depth - 1] = JSON_DECODER_PLAIN;
+			json_decoder_push(decoder, decoder->found ? JSON_DECODER_PLAIN : JSON_DECODER_CANDIDATE);
+			break;
+		case JSON_OBJECT_END:
+		case JSON_ARRAY_END:
+			switch (decoder->roles[--decoder->depth])
+			{
+				case JSON_DECODER_RESULT:
+					decoder->finished = true;
+					break;
+				case JSON_DECODER_CANDIDATE:
+					/* nothing rejected it: empty array */
+					if (!decoder->found)
+					{
+						d("Empty result array was found in json response");
+
+						decoder->found = true;
+						decoder->finished = true;
+					}
+					break;
+			}
+			break;
+		case JSON_STRING:
+		case JSON_STRING_ESCAPED:
+		case JSON_INT:
+		case JSON_FLOAT:
+		case JSON_NULL:
+		case JSON_TRUE:
+		case JSON_FALSE:
+			/* array of scalars isn't result */
+			if (JSON_DECODER_CANDIDATE == parent)
+				decoder->roles[decoder->depth - 1] = JSON_DECODER_PLAIN;
+			break;
+	}
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_init(JSONDecoder *decoder, TupleDesc tuple_desc, JSONDecoderRowCallback row_callback, void *row_arg)
+{
+	int			natts = tuple_desc->natts;
+	int			i;
+
+	decoder->tuple_desc = tuple_desc;
+	decoder->attinmeta = TupleDescGetAttInMetadata(tuple_desc);
+	decoder->row_callback = row_callback;
+	decoder->row_arg = row_arg;
+	decoder->row_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											 "www_fdw json row",
+											 ALLOCSET_DEFAULT_MINSIZE,
+											 ALLOCSET_DEFAULT_INITSIZE,
+											 ALLOCSET_DEFAULT_MAXSIZE);
+	decoder->log_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											 "www_fdw json log",
+											 ALLOCSET_SMALL_MINSIZE,
+											 ALLOCSET_SMALL_INITSIZE,
+											 ALLOCSET_SMALL_MAXSIZE);
+
+	decoder->roles_size = 16;
+	decoder->roles = (char *) palloc(decoder->roles_size * sizeof(char));
+	decoder->values = (Datum *) palloc(natts * sizeof(Datum));
+	decoder->isnull = (bool *) palloc(natts * sizeof(bool));
+	decoder->assigned = (bool *) palloc(natts * sizeof(bool));
+	decoder->decoders = (JSONColumnDecoder *) palloc(natts * sizeof(JSONColumnDecoder));
+	decoder->capture = (bool *) palloc(natts * sizeof(bool));
+	for (i = 0; i < natts; i++)
+		decoder->decoders[i] = json_decoder_for_column(tuple_desc->attrs[i], &decoder->capture[i]);
+	decoder->used = NULL;
+	decoder->deferred = NULL;
+
+	json_decoder_reset(decoder);
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_reset(JSONDecoder *decoder)
+{
+	decoder->depth = 0;
+	decoder->found = false;
+	decoder->finished = false;
+	decoder->row_depth = 0;
+	decoder->column = -1;
+	decoder->capturing = -1;
+	decoder->tentative = false;
+	decoder->replaying = 0;
+	decoder->nlog = 0;
+	json_decoder_forget(decoder);
+	MemoryContextReset(decoder->row_cxt);
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_free(JSONDecoder *decoder)
+{
+	MemoryContextDelete(decoder->row_cxt);
+	MemoryContextDelete(decoder->log_cxt);
+	pfree(decoder->roles);
+	pfree(decoder->values);
+	pfree(decoder->isnull);
+	pfree(decoder->assigned);
+	pfree(decoder->decoders);
+	pfree(decoder->capture);
+	if (decoder->deferred)
+		pfree(decoder->raw.data);
+	decoder->row_cxt = NULL;
+	decoder->log_cxt = NULL;
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_project(JSONDecoder *decoder, const bool *used)
+{
+	decoder->used = used;
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_defer(JSONDecoder *decoder, const bool *deferred)
+{
+	decoder->deferred = deferred;
+	if (deferred)
+		initStringInfo(&decoder->raw);
+}
+
+/* read description in header file (to keep in single place) */
+void
+json_decoder_resolve(JSONDecoder *decoder, const char *raw, uint32 length, Datum *values, bool *isnull)
+{
+	const char	*end = raw + length;
+	int			natts = decoder->tuple_desc->natts;
+	bool		*assigned = decoder->assigned;
+	int			i;
+
+	/* assigned flags aren't used by decoder between rows */
+	for (i = 0; i < natts; i++)
+		assigned[i] = false;
+
+	while (raw < end)
+	{
+		int16		header[2];
+		uint32		len;
+		int			column;
+
+		memcpy(header, raw, sizeof(header));
+		memcpy(&len, raw + sizeof(header), sizeof(len));
+		raw += sizeof(header) + sizeof(len);
+		column = header[0];
+
+		assigned[column] = true;
+		if (JSON_OBJECT_BEGIN == header[1])
+		{
+			values[column] = InputFunctionCall(&decoder->attinmeta->attinfuncs[column],
+											   (char *) raw,
+											   decoder->attinmeta->attioparams[column],
+											   decoder->attinmeta->atttypmods[column]);
+			isnull[column] = false;
+		}
+		else if (JSON_ARRAY_BEGIN != header[1])
+		{
+			values[column] = json_decoder_datum(decoder, column, header[1], raw, len);
+			isnull[column] = false;
+		}
+		raw += len + 1;
+	}
+
+	/* missing columns are passed to input functions, same as in json_decoder_row_end */
+	for (i = 0; i < natts; i++)
+	{
+		if (decoder->deferred[i] && !assigned[i] && !decoder->tuple_desc->attrs[i]->attisdropped)
+			values[i] = InputFunctionCall(&decoder->attinmeta->attinfuncs[i],
+										  NULL,
+										  decoder->attinmeta->attioparams[i],
+										  decoder->attinmeta->atttypmods[i]);
+	}
+}
+
+/* read description in header file (to keep in single place) */
+int
+json_decoder_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+	json_decoder_event((JSONDecoder *) userdata, type, data, length);
+	return 0;
+}
@@ -0,0 +1,147 @@
+#ifndef JSON_DECODER_H
+#define JSON_DECODER_H
+
+#include "postgres.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+
+#include "libjson-0.8/json.h"
+
+/*
+ * row callback
+ * values/isnull - decoded columns of the row (natts of tuple descriptor),
+ * raw - raw tokens of deferred columns (see json_decoder_defer), NULL - none,
+ * they are valid during the call only
+ */
+typedef void (*JSONDecoderRowCallback)(void *arg, Datum *values, bool *isnull, StringInfo raw);
+
+struct JSONDecoder;
+
+/*
+ * column decoder
+ * converts json token of specified type to column value directly
+ * data - token text (content of string), not null terminated
+ * returns false if it can't do it, then column input function is used
+ */
+typedef bool (*JSONColumnDecoder)(struct JSONDecoder *decoder, int column, int type, const char *data, uint32 length, Datum *value);
+
+/*
+ * event of the object, which wasn't recognized as row yet
+ * (first object of an array, without keys matching columns so far)
+ */
+typedef struct JSONDecoderEvent
+{
+	int			type;
+	char		*data;
+	uint32		length;
+} JSONDecoderEvent;
+
+/*
+ * JSONDecoder
+ * converts json parser events to rows of result array directly,
+ * without json tree
+ *
+ * result array is the first array (in document order), whose first object
+ * has key matching one of the columns, so decision is made on first matching key
+ * if object ends without such key, its events are replayed
+ * in order to search result inside of it
+ */
+typedef struct JSONDecoder
+{
+	TupleDesc	tuple_desc;
+	AttInMetadata	*attinmeta;
+	JSONDecoderRowCallback	row_callback;
+	void		*row_arg;
+	MemoryContext	row_cxt;	/* values of the current row, reset after each row */
+	MemoryContext	log_cxt;	/* events of not recognized objects */
+	JSONColumnDecoder	*decoders;	/* per column, NULL - input function only */
+	bool		*capture;	/* per column: nested containers are captured as json text */
+	const bool	*used;		/* per column: value is needed, NULL - all columns */
+	const bool	*deferred;	/* per column: raw token is kept instead of value, NULL - none */
+	StringInfoData	raw;		/* raw tokens of deferred columns of the current row */
+
+	/* result detection: JSON_DECODER_* role per open container outside of rows */
+	char		*roles;
+	int			depth;
+	int			roles_size;
+	bool		found;		/* result array was found */
+	bool		finished;	/* result array was read completely */
+
+	/* current row */
+	int			row_depth;	/* nesting inside of the row, 0 - outside */
+	int			column;		/* column of the next value, -1 - value isn't used */
+	Datum		*values;
+	bool		*isnull;
+	bool		*assigned;	/* column was set already (first key wins) */
+	int			capturing;	/* column, which nested container is captured, -1 - none */
+	StringInfoData	captured;
+
+	/* not recognized object */
+	bool		tentative;
+	JSONDecoderEvent	*log;
+	int			nlog;
+	int			log_size;
+	int			replaying;	/* nesting of replays */
+} JSONDecoder;
+
+/* json_decoder_init
+ * prepare decoder for rows of tuple_desc
+ * column decoders are chosen by column types here:
+ * int2/4/8, float4/8, numeric, bool, text, date, timestamp(tz), uuid, json(b)
+ * row_callback is called for each row of result array
+ * memory contexts are created in CurrentMemoryContext
+ */
+void
+json_decoder_init(JSONDecoder *decoder, TupleDesc tuple_desc, JSONDecoderRowCallback row_callback, void *row_arg);
+
+/* json_decoder_reset
+ * prepare decoder for new document
+ */
+void
+json_decoder_reset(JSONDecoder *decoder);
+
+/* json_decoder_free
+ * release memory of decoder as soon as document is decoded
+ * (rows passed to row callback aren't affected)
+ */
+void
+json_decoder_free(JSONDecoder *decoder);
+
+/* json_decoder_project
+ * decode values of columns marked in used only (natts items, NULL - all columns)
+ * keys of other columns still identify result array, but their values
+ * are skipped without conversion and they're null in rows
+ * used isn't copied, it has to live as long as decoder
+ */
+void
+json_decoder_project(JSONDecoder *decoder, const bool *used);
+
+/* json_decoder_defer
+ * keep raw tokens of columns marked in deferred (natts items, NULL - none)
+ * instead of converting them: such columns are null in values passed to
+ * row callback, their tokens are passed in raw argument, so row can be
+ * checked by other columns first and tokens converted for rows, which are
+ * needed only (json_decoder_resolve)
+ * deferred isn't copied, it has to live as long as decoder
+ */
+void
+json_decoder_defer(JSONDecoder *decoder, const bool *deferred);
+
+/* json_decoder_resolve
+ * convert raw tokens (length bytes kept from raw argument of row callback)
+ * into values/isnull of deferred columns, in CurrentMemoryContext
+ * decoder has to be initialized for the same tuple descriptor
+ * and deferred columns, it doesn't have to parse anything
+ */
+void
+json_decoder_resolve(JSONDecoder *decoder, const char *raw, uint32 length, Datum *values, bool *isnull);
+
+/* json_decoder_callback
+ * json parser callback, userdata - JSONDecoder
+ * token data doesn't have to be null terminated and JSON_STRING_ESCAPED
+ * is accepted, so parser can pass strings in place (inplace_strings)
+ */
+int
+json_decoder_callback(void *userdata, int type, const char *data, uint32_t length);
+
+#endif
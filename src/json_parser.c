@@ -1,194 +1,214 @@
 #include	"json_parser.h"
+#include	<string.h>
 
-JSONNode*
-json_new_object()
+#define	JSON_BUILDER_STACK		16
+#define	JSON_BUILDER_CHILDREN	4
+
+static char*
+json_strndup(const char* data, uint32_t length)
 {
-	JSONNode*	obj	= (JSONNode*)malloc(sizeof(JSONNode));
-	obj->type	= JSON_OBJECT_BEGIN;
-	obj->length	= 0;
-	obj->key	= NULL;
-	return	obj;
+	char*	str	= malloc(length + 1);
+
+	if(!str)
+		return	NULL;
+	memcpy(str, data, length);
+	str[length]	= '\0';
+	return	str;
 }
-JSONNode*
-json_new_array()
+
+void
+json_builder_init(JSONBuilder* builder)
 {
-	JSONNode*	obj	= (JSONNode*)malloc(sizeof(JSONNode));
-	obj->type	= JSON_ARRAY_BEGIN;
-	obj->length	= 0;
-	obj->key	= NULL;
-	return	obj;
+	builder->stack	= NULL;
+	builder->stack_size	= 0;
+	builder->depth	= 0;
+	builder->root	= NULL;
 }
-JSONNode*
-json_new_value(int type, const char* data, uint32_t length)
-{
-	int	i;
-	JSONNode*	obj	= (JSONNode*)malloc(sizeof(JSONNode));
-	obj->type	= type;
-	obj->key	= NULL;
-	obj->length	= -1;
-	switch(type)
-	{
-        case JSON_STRING:
-			obj->val.val_string	= malloc(length*sizeof(char)+1);
-			for( i=0; i<length; i++ )
-				obj->val.val_string[i]	= data[i];
-			obj->val.val_string[i]	= '\0';
-			break;
-        case JSON_INT:
-			obj->val.val_int	= atoi(data);
-			break;
-        case JSON_FLOAT:
-			obj->val.val_float	= atof(data);
-			break;
-	}
-	return	obj;
-}
-JSONNode*
-json_new_const(int type)
+
+/*
+ * json_free_tree
+ * free node's key, value and children (node itself belongs to its parent)
+ */
+static void
+json_free_tree(JSONNode* t)
 {
-	JSONNode*	obj	= (JSONNode*)malloc(sizeof(JSONNode));
-	obj->type	= type;
-	obj->length	= -1;
-	switch(type)
-	{
-        case JSON_NULL:
-			obj->val.val_null	= true;
+	uint32_t	i;
+
+	free(t->key);
+	switch (t->type) {
+		case JSON_OBJECT_BEGIN:
+		case JSON_ARRAY_BEGIN:
+			for( i=0; i<t->length; i++ )
+				json_free_tree(&(t->val.val_array[i]));
+			free(t->val.val_array);
 			break;
-        case JSON_TRUE:
-			obj->val.val_bool	= true;
+		case JSON_STRING:
+			free(t->val.val_string);
 			break;
-        case JSON_FALSE:
-			obj->val.val_bool	= false;
+		default:
 			break;
 	}
-	return	obj;
 }
 
-void*
-json_tree_create_structure(int nesting, int is_object)
+void
+json_builder_reset(JSONBuilder* builder)
 {
-	if (is_object)
-			return json_new_object();
-	else
-			return json_new_array();
-}
+	int	i;
 
-void*
-json_tree_create_data(int type, const char *data, uint32_t length)
-{
-	switch (type) {
-		case JSON_STRING:
-		case JSON_INT:
-		case JSON_FLOAT:
-				return json_new_value(type, data, length);
-		case JSON_NULL:
-		case JSON_TRUE:
-		case JSON_FALSE:
-				return json_new_const(type);
+	/* key of unfinished object member */
+	for( i=0; i<builder->depth; i++ )
+		free(builder->stack[i].key);
+	if(builder->root)
+	{
+		json_free_tree(builder->root);
+		free(builder->root);
 	}
-	return	NULL;
+	builder->depth	= 0;
+	builder->root	= NULL;
 }
 
 void
-json_copy_node(JSONNode *from, JSONNode* to)
+json_builder_free(JSONBuilder* builder)
 {
-	to->type	= from->type;
-	to->val		= from->val;
-	to->length	= from->length;
-	to->key		= from->key;
+	json_builder_reset(builder);
+	free(builder->stack);
+	builder->stack	= NULL;
+	builder->stack_size	= 0;
 }
 
-void
-json_append_object(JSONNode *object, char *key, uint32_t key_length, void *obj)
+/*
+ * json_builder_node
+ * new node for the current position: root or next child of open container
+ * child vector is doubled when it's full
+ * (children of open container are never moved: container gets
+ * next child only after previous one is closed)
+ */
+static JSONNode*
+json_builder_node(JSONBuilder* builder, int type)
 {
-	int	i,j;
-	JSONNode*	obj_ptr	= malloc( (object->length+1) * sizeof(JSONNode) );
+	JSONFrame*	frame;
+	JSONNode*	parent;
+	JSONNode*	children;
+	JSONNode*	node;
+
+	if(0 == builder->depth)
+	{
+		node	= malloc(sizeof(JSONNode));
+		if(!node)
+			return	NULL;
+		node->key	= NULL;
+		builder->root	= node;
+	}
+	else
+	{
+		frame	= &(builder->stack[builder->depth - 1]);
+		parent	= frame->node;
+		if(parent->length == frame->capacity)
+		{
+			frame->capacity	= frame->capacity ? frame->capacity * 2 : JSON_BUILDER_CHILDREN;
+			children	= realloc(parent->val.val_array, frame->capacity * sizeof(JSONNode));
+			if(!children)
+				return	NULL;
+			parent->val.val_array	= children;
+		}
+		node	= &(parent->val.val_array[parent->length++]);
+		node->key	= frame->key;
+		frame->key	= NULL;
+	}
 
-	/* copy current elements */
-	for( i=0; i<object->length; i++ )
-		json_copy_node(&(object->val.val_object[i]), &(obj_ptr[i]));
-	/* copy new element */
-	json_copy_node((JSONNode*)obj, &(obj_ptr[i]));
-	/* set key name (copy string) */
-	obj_ptr[i].key	= (char*)(malloc(key_length*sizeof(char) + 1));
-	for( j=0; j<key_length; j++ )
-		obj_ptr[i].key[j]	= key[j];
-	obj_ptr[i].key[j]	= '\0';
-	/* free old array */
-	if(object->length) free(object->val.val_object);
-	/* setup new array */
-	object->val.val_object	= obj_ptr;
-	/* increment array length */
-	object->length++;
+	/* value is set by caller, tree stays valid for json_free_tree meanwhile */
+	node->type	= JSON_NULL;
+	node->length	= -1;
+	return	node;
 }
 
-void
-json_append_array(JSONNode *array, void *obj)
+/*
+ * json_builder_push
+ * open container: its children are appended till the end event
+ */
+static int
+json_builder_push(JSONBuilder* builder, JSONNode* node, int type)
 {
-	int	i;
+	JSONFrame*	stack;
 
-	JSONNode*	arr_ptr	= malloc( (array->length+1) * sizeof(JSONNode) );
-	/* copy current elements */
-	for( i=0; i<array->length; i++ )
-		json_copy_node(&(array->val.val_array[i]), &(arr_ptr[i]));
-	/* copy new element */
-	json_copy_node((JSONNode*)obj, &(arr_ptr[i]));
-	/* free old array */
-	if(array->length) free(array->val.val_object);
-	/* setup new array */
-	array->val.val_array	= arr_ptr;
-	/* increment array length */
-	array->length++;
-}
+	node->type	= type;
+	node->length	= 0;
+	node->val.val_array	= NULL;
 
-int
-json_tree_append(void *structure, char *key, uint32_t key_length, void *obj)
-{
-        if (key != NULL) {
-                JSONNode *object = structure;
-                json_append_object(object, key, key_length, obj);
-        } else {
-                JSONNode *array = structure;
-                json_append_array(array, obj);
-        }
+	if(builder->depth == builder->stack_size)
+	{
+		stack	= realloc(builder->stack, (builder->stack_size ? builder->stack_size * 2 : JSON_BUILDER_STACK) * sizeof(JSONFrame));
+		if(!stack)
+			return	JSON_ERROR_NO_MEMORY;
+		builder->stack_size	= builder->stack_size ? builder->stack_size * 2 : JSON_BUILDER_STACK;
+		builder->stack	= stack;
+	}
 
-		return	1;
+	builder->stack[builder->depth].node	= node;
+	builder->stack[builder->depth].capacity	= 0;
+	builder->stack[builder->depth].key	= NULL;
+	builder->depth++;
+	return	0;
 }
 
-void
-json_free_tree(JSONNode* t)
+int
+json_builder_callback(void *userdata, int type, const char *data, uint32_t length)
 {
-	int	i;
-
-	if(t->key) free(t->key);
+	JSONBuilder*	builder	= userdata;
+	JSONNode*	node;
 
-	switch (t->type) {
+	switch (type) {
 		case JSON_OBJECT_BEGIN:
-			for( i=0; i<t->length; i++ )
-				json_free_tree(&(t->val.val_object[i]));
-			if(t->length) free(t->val.val_object);
-			break;
 		case JSON_ARRAY_BEGIN:
-			for( i=0; i<t->length; i++ )
-				json_free_tree(&(t->val.val_array[i]));
-			if(t->length) free(t->val.val_array);
+			node	= json_builder_node(builder, type);
+			if(!node)
+				return	JSON_ERROR_NO_MEMORY;
+			return	json_builder_push(builder, node, type);
+		case JSON_OBJECT_END:
+		case JSON_ARRAY_END:
+			builder->depth--;
 			break;
-		case JSON_STRING:
-			if(t->val.val_string)	free(t->val.val_string);
+		case JSON_KEY:
+			builder->stack[builder->depth - 1].key	= json_strndup(data, length);
+			if(!builder->stack[builder->depth - 1].key)
+				return	JSON_ERROR_NO_MEMORY;
 			break;
-		/* nothing to do */
+		case JSON_STRING:
 		case JSON_INT:
 		case JSON_FLOAT:
 		case JSON_NULL:
 		case JSON_TRUE:
 		case JSON_FALSE:
-		/* not used, here for removing warning */
-		case JSON_NONE:
-		case JSON_KEY:
-		case JSON_ARRAY_END:
-		case JSON_OBJECT_END:
+			node	= json_builder_node(builder, type);
+			if(!node)
+				return	JSON_ERROR_NO_MEMORY;
+			switch (type) {
+				case JSON_STRING:
+					node->val.val_string	= json_strndup(data, length);
+					if(!node->val.val_string)
+						return	JSON_ERROR_NO_MEMORY;
+					break;
+				case JSON_INT:
+					node->val.val_int	= atoi(data);
+					break;
+				case JSON_FLOAT:
+					node->val.val_float	= atof(data);
+					break;
+				case JSON_NULL:
+					node->val.val_null	= true;
+					break;
+				case JSON_TRUE:
+					node->val.val_bool	= true;
+					break;
+				case JSON_FALSE:
+					node->val.val_bool	= false;
+					break;
+			}
+			node->type	= type;
 			break;
 	}
+
+	return	0;
 }
 
 void
@@ -279,14 +299,13 @@ json_print_tree(JSONNode* t, int indent, bool comma)
 }
 
 void
-json_parser_init2(json_parser* parser, json_parser_dom* dom)
+json_parser_init2(json_parser* parser, JSONBuilder* builder)
 {
-	json_parser_dom_init(dom, json_tree_create_structure, json_tree_create_data, json_tree_append);
-	json_parser_init(parser, NULL, json_parser_dom_callback, dom);
+	json_parser_init(parser, NULL, json_builder_callback, builder);
 }
 
 JSONNode*
 json_result_tree(json_parser* parser)
 {
-	return	(JSONNode*)(((json_parser_dom*)(parser->userdata))->stack->val);
+	return	((JSONBuilder*)(parser->userdata))->root;
 }
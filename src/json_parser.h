@@ -33,20 +33,34 @@ typedef	struct	JSONNode
 	char*		key;	/* active only if it belongs to object */
 } JSONNode;
 
-JSONNode*	json_new_object(void);
-JSONNode*	json_new_array(void);
-JSONNode*	json_new_value(int type, const char* data, uint32_t length);
-JSONNode*	json_new_const(int type);
-void*		json_tree_create_structure(int nesting, int is_object);
-void*		json_tree_create_data(int type, const char *data, uint32_t length);
-void		json_copy_node(JSONNode *from, JSONNode* to);
-void		json_append_object(JSONNode *object, char *key, uint32_t key_length, void *obj);
-void		json_append_array(JSONNode *array, void *obj);
-int			json_tree_append(void *structure, char *key, uint32_t key_length, void *obj);
-void		json_free_tree(JSONNode* t);
+/*
+ * JSONBuilder
+ * builds json tree from parser events (json_builder_callback)
+ * child vectors of open containers grow geometrically,
+ * so building of N elements array is linear
+ */
+typedef	struct	JSONFrame
+{
+	JSONNode*	node;
+	uint32_t	capacity;	/* allocated size of node's child vector */
+	char*		key;		/* key for next child of object */
+} JSONFrame;
+
+typedef	struct	JSONBuilder
+{
+	JSONFrame*	stack;		/* open containers */
+	int			depth;
+	int			stack_size;
+	JSONNode*	root;		/* set when first container/value is started */
+} JSONBuilder;
+
+void		json_builder_init(JSONBuilder* builder);
+int			json_builder_callback(void *userdata, int type, const char *data, uint32_t length);
+void		json_builder_reset(JSONBuilder* builder);
+void		json_builder_free(JSONBuilder* builder);
 void		json_print_indent(const int indent);
 void		json_print_tree(JSONNode* t, int indent, bool comma);
-void		json_parser_init2(json_parser* parser, json_parser_dom* dom);
+void		json_parser_init2(json_parser* parser, JSONBuilder* builder);
 JSONNode*	json_result_tree(json_parser* parser);
 
 #endif
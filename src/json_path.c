@@ -0,0 +1,105 @@
+#include "json_path.h"
+
+/* read description in header file (to keep in single place) */
+void
+json_path_init(JSONPathFinder *finder, const char *path)
+{
+	char	   *keys = pstrdup(path),
+			   *p;
+	int			i;
+
+	finder->nkeys = 1;
+	for (p = keys; *p; p++)
+		if ('.' == *p)
+			finder->nkeys++;
+
+	finder->keys = (char **) palloc(finder->nkeys * sizeof(char *));
+	finder->keys[0] = keys;
+	for (i = 1, p = keys; *p; p++)
+	{
+		if ('.' == *p)
+		{
+			*p = '\0';
+			finder->keys[i++] = p + 1;
+		}
+	}
+
+	finder->depth = 0;
+	finder->matched = 0;
+	finder->pending = false;
+	finder->value = NULL;
+}
+
+/* read description in header file (to keep in single place) */
+int
+json_path_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+	JSONPathFinder *finder = (JSONPathFinder *) userdata;
+	bool		pending = finder->pending;
+
+	finder->pending = false;
+	if (finder->value)
+		return 0;
+
+	switch (type)
+	{
+		case JSON_OBJECT_BEGIN:
+			/* object under the path key: its keys are compared with the next one */
+			if (pending && finder->matched + 1 < finder->nkeys)
+				finder->matched++;
+			finder->depth++;
+			break;
+		case JSON_ARRAY_BEGIN:
+			finder->depth++;
+			break;
+		case JSON_OBJECT_END:
+		case JSON_ARRAY_END:
+			/* object on the path is closed */
+			if (finder->depth == finder->matched + 1 && 0 < finder->matched)
+				finder->matched--;
+			finder->depth--;
+			break;
+		case JSON_KEY:
+			finder->pending = finder->depth == finder->matched + 1
+				&& strlen(finder->keys[finder->matched]) == length
+				&& 0 == strncmp(finder->keys[finder->matched], data, length);
+			break;
+		case JSON_STRING:
+		case JSON_INT:
+		case JSON_FLOAT:
+		case JSON_TRUE:
+		case JSON_FALSE:
+			if (pending && finder->matched + 1 == finder->nkeys)
+				finder->value = pnstrdup(data, length);
+			break;
+		case JSON_STRING_ESCAPED:
+			if (pending && finder->matched + 1 == finder->nkeys)
+			{
+				finder->value = (char *) palloc(length + 1);
+				finder->value[json_unescape(data, length, finder->value)] = '\0';
+			}
+			break;
+		default:
+			/* null means no value */
+			break;
+	}
+
+	return 0;
+}
+
+/* read description in header file (to keep in single place) */
+char*
+json_path_find(const char *path, const char *document, uint32 length)
+{
+	JSONPathFinder finder;
+	json_parser parser;
+	int			ret;
+
+	json_path_init(&finder, path);
+	if (json_parser_init(&parser, NULL, json_path_callback, &finder))
+		return NULL;
+	ret = json_parser_string(&parser, document, length, NULL);
+	json_parser_free(&parser);
+
+	return ret ? NULL : finder.value;
+}
@@ -0,0 +1,45 @@
+#ifndef JSON_PATH_H
+#define JSON_PATH_H
+
+#include "postgres.h"
+
+#include "libjson-0.8/json.h"
+
+/*
+ * JSONPathFinder
+ * finds scalar value at path of object keys ("meta.next" - key next
+ * of object under key meta of the root object) in json parser events,
+ * without json tree, so it can watch the same document as json decoder
+ * arrays aren't traversed, first found value wins
+ */
+typedef struct JSONPathFinder
+{
+	char	  **keys;		/* path split by dots */
+	int			nkeys;
+	int			depth;		/* nesting of current position */
+	int			matched;	/* path keys matched by open objects */
+	bool		pending;	/* last key of object on the path is the next path key */
+	char	   *value;		/* found value (text of the token), NULL - not found */
+} JSONPathFinder;
+
+/* json_path_init
+ * prepare finder for the path, memory is allocated in CurrentMemoryContext
+ */
+void
+json_path_init(JSONPathFinder *finder, const char *path);
+
+/* json_path_callback
+ * json parser callback, userdata - JSONPathFinder
+ * (strings can be passed in place, see json_decoder_callback)
+ */
+int
+json_path_callback(void *userdata, int type, const char *data, uint32_t length);
+
+/* json_path_find
+ * value at the path in json document of specified length, NULL - not found
+ * or document isn't valid json
+ */
+char*
+json_path_find(const char *path, const char *document, uint32 length);
+
+#endif
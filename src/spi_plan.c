@@ -0,0 +1,161 @@
+#include "spi_plan.h"
+#include "lib/stringinfo.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils.h"
+
+/*
+ * plan cache key
+ * callback name is stored as it's written in server options,
+ * too long names aren't cached
+ */
+#define SPI_PLAN_CALLBACK_SIZE	(2 * NAMEDATALEN + 8)
+
+typedef struct SPIPlanKey
+{
+	char		callback[SPI_PLAN_CALLBACK_SIZE];
+	int			nargs;
+	Oid			argtypes[WWW_SPI_PLAN_MAX_ARGS];
+} SPIPlanKey;
+
+typedef struct SPIPlanEntry
+{
+	SPIPlanKey	key;		/* hash key (must be first) */
+	SPIPlanPtr	plan;
+	bool		valid;		/* false - pg_proc was changed after plan was prepared */
+} SPIPlanEntry;
+
+static HTAB	*SPIPlanHash = NULL;
+
+/*
+ * spi_plan_invalidate
+ * any change of pg_proc marks all plans invalid:
+ * plan cache revalidates plans on change of function they use,
+ * but not when callback name starts resolving to another function
+ * (new overload, function created earlier in search_path);
+ * plans are freed on next lookup, not here - callback can be called
+ * in the middle of execution of the plan
+ */
+static
+void
+#if PG_VERSION_NUM >= 90200
+spi_plan_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+#else
+spi_plan_invalidate(Datum arg, int cacheid, ItemPointer tuplePtr)
+#endif
+{
+	HASH_SEQ_STATUS	scan;
+	SPIPlanEntry	*entry;
+
+	hash_seq_init(&scan, SPIPlanHash);
+	while ((entry = (SPIPlanEntry *) hash_seq_search(&scan)))
+		entry->valid = false;
+}
+
+/*
+ * spi_plan_init
+ * create plan hash table and register pg_proc invalidation callback
+ * cache lives till the end of backend
+ */
+static
+void
+spi_plan_init(void)
+{
+	HASHCTL		ctl;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(SPIPlanKey);
+	ctl.entrysize = sizeof(SPIPlanEntry);
+	ctl.hash = tag_hash;
+	ctl.hcxt = CacheMemoryContext;
+	SPIPlanHash = hash_create("www_fdw callback plans", 8, &ctl,
+							  HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	CacheRegisterSyscacheCallback(PROCOID, spi_plan_invalidate, (Datum) 0);
+}
+
+/*
+ * spi_plan_prepare
+ * prepare "SELECT * FROM callback($1,...)" in current SPI procedure context
+ */
+static
+SPIPlanPtr
+spi_plan_prepare(const char *callback, int nargs, Oid *argtypes)
+{
+	StringInfoData	cmd;
+	SPIPlanPtr		plan;
+	int				i;
+
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd, "SELECT * FROM %s(", callback);
+	for (i = 1; i <= nargs; i++)
+		appendStringInfo(&cmd, 1 == i ? "$%i" : ",$%i", i);
+	appendStringInfoChar(&cmd, ')');
+
+	plan = SPI_prepare(cmd.data, nargs, argtypes);
+	if (NULL == plan)
+		ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			errmsg("Can't prepare call of callback '%s': %i (%s)", callback, SPI_result, SPI_result_code_string(SPI_result))
+			));
+	pfree(cmd.data);
+
+	return plan;
+}
+
+/* read description in header file (to keep in single place) */
+SPIPlanPtr
+www_spi_plan(const char *callback, int nargs, Oid *argtypes)
+{
+	SPIPlanKey		key;
+	SPIPlanEntry	*entry;
+	SPIPlanPtr		plan;
+	bool			found;
+
+	Assert(nargs <= WWW_SPI_PLAN_MAX_ARGS);
+
+	if (strlen(callback) >= SPI_PLAN_CALLBACK_SIZE)
+		return spi_plan_prepare(callback, nargs, argtypes);
+
+	if (NULL == SPIPlanHash)
+		spi_plan_init();
+
+	MemSet(&key, 0, sizeof(key));
+	strcpy(key.callback, callback);
+	key.nargs = nargs;
+	memcpy(key.argtypes, argtypes, nargs * sizeof(Oid));
+
+	entry = (SPIPlanEntry *) hash_search(SPIPlanHash, &key, HASH_FIND, &found);
+	if (found)
+	{
+		if (entry->valid)
+			return entry->plan;
+
+		d("callback plan of '%s' is invalidated, preparing it again", callback);
+		SPI_freeplan(entry->plan);
+		hash_search(SPIPlanHash, &key, HASH_REMOVE, NULL);
+	}
+
+	/* entry is added only when plan is kept, so failed prepare leaves nothing behind */
+	plan = spi_plan_prepare(callback, nargs, argtypes);
+#if PG_VERSION_NUM >= 90200
+	if (0 != SPI_keepplan(plan))
+#else
+	plan = SPI_saveplan(plan);
+	if (NULL == plan)
+#endif
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+			errmsg("Can't keep plan of callback '%s'", callback)
+			));
+
+	entry = (SPIPlanEntry *) hash_search(SPIPlanHash, &key, HASH_ENTER, NULL);
+	entry->plan = plan;
+	entry->valid = true;
+
+	d("prepared callback plan of '%s'", callback);
+
+	return entry->plan;
+}
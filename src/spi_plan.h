@@ -0,0 +1,20 @@
+#ifndef SPI_PLAN_H
+#define SPI_PLAN_H
+
+#include "postgres.h"
+#include "executor/spi.h"
+
+/* maximum number of callback arguments */
+#define WWW_SPI_PLAN_MAX_ARGS	4
+
+/* www_spi_plan
+ * returns plan of "SELECT * FROM callback($1,...,$nargs)"
+ * plan is prepared on the first call and kept in backend-local cache
+ * (keyed by callback name and argument types) till pg_proc changes
+ * has to be called between SPI_connect/SPI_finish,
+ * plan itself must not be freed by caller
+ */
+SPIPlanPtr
+www_spi_plan(const char *callback, int nargs, Oid *argtypes);
+
+#endif
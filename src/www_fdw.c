@@ -6,6 +6,8 @@
  #include "access/htup_details.h"
 #endif
 
+#include "access/skey.h"
+#include "catalog/pg_attribute.h"
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_foreign_server.h"
 #include "commands/defrem.h"
@@ -16,28 +18,55 @@
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#if PG_VERSION_NUM >= 120000
+ #include "optimizer/optimizer.h"
+#else
+ #include "optimizer/var.h"
+#endif
 #include "parser/parsetree.h"
 #include "storage/fd.h"
 #include "utils/rel.h"
+#include "utils/selfuncs.h"
 #include "utils/builtins.h"
 #include "executor/spi.h"
 #include "utils/fmgroids.h"
+#include "utils/array.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#if PG_VERSION_NUM >= 100000
+ #include "utils/ruleutils.h"
+#endif
+#include "utils/syscache.h"
+#include "utils/tuplestore.h"
 #include "catalog/pg_type.h"
 #include "utils/xml.h"
 
 #include "curl/curl.h"
 #include "libjson-0.8/json.h"
-#include "json_parser.h"
+#include "connection.h"
+#include "json_decoder.h"
+#include "json_path.h"
 #include "serialize_quals.h"
+#include "spi_plan.h"
 #include "utils.h"
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+
 
 PG_MODULE_MAGIC;
 
@@ -74,6 +103,9 @@ static struct WWW_fdw_option valid_options[] =
     { "response_type",    ForeignServerRelationId },
     { "response_deserialize_callback",    ForeignServerRelationId },
     { "response_iterate_callback",    ForeignServerRelationId },
+    { "response_iterate_batch",    ForeignServerRelationId },
+    { "response_stream",    ForeignServerRelationId },
+    { "response_stream_rows",    ForeignServerRelationId },
 
     { "ssl_cert",   ForeignServerRelationId },
     { "ssl_key",    ForeignServerRelationId },
@@ -82,10 +114,149 @@ static struct WWW_fdw_option valid_options[] =
     { "cookie",  ForeignServerRelationId },
     { "username",  ForeignServerRelationId },
     { "password",  ForeignServerRelationId },
+
+    { "connection_idle_timeout",  ForeignServerRelationId },
+    { "connection_max_per_host",  ForeignServerRelationId },
+
+    /* planner estimates, table options override server ones */
+    { "request_latency",    ForeignServerRelationId },
+    { "request_latency",    ForeignTableRelationId },
+    { "response_row_cost",  ForeignServerRelationId },
+    { "response_row_cost",  ForeignTableRelationId },
+    { "expected_rows",  ForeignServerRelationId },
+    { "expected_rows",  ForeignTableRelationId },
+
+    /* parameterized scans (join lookups) */
+    { "request_lookup_limit",   ForeignServerRelationId },
+    { "request_lookup_limit",   ForeignTableRelationId },
+    { "request_lookup_fetch_all",   ForeignServerRelationId },
+    { "request_lookup_fetch_all",   ForeignTableRelationId },
+    { "request_concurrency",    ForeignServerRelationId },
+    { "request_concurrency",    ForeignTableRelationId },
+
+    /* pagination */
+    { "page_next_path",     ForeignServerRelationId },
+    { "page_next_path",     ForeignTableRelationId },
+    { "page_next_header",   ForeignServerRelationId },
+    { "page_next_header",   ForeignTableRelationId },
+    { "page_next_param",    ForeignServerRelationId },
+    { "page_next_param",    ForeignTableRelationId },
+    { "page_limit",     ForeignServerRelationId },
+    { "page_limit",     ForeignTableRelationId },
+    { "page_number_param",  ForeignServerRelationId },
+    { "page_number_param",  ForeignTableRelationId },
+    { "page_offset_param",  ForeignServerRelationId },
+    { "page_offset_param",  ForeignTableRelationId },
+    { "page_size_param",    ForeignServerRelationId },
+    { "page_size_param",    ForeignTableRelationId },
+    { "page_size",      ForeignServerRelationId },
+    { "page_size",      ForeignTableRelationId },
+    { "page_total_path",    ForeignServerRelationId },
+    { "page_total_path",    ForeignTableRelationId },
+    { "page_ordered",   ForeignServerRelationId },
+    { "page_ordered",   ForeignTableRelationId },
+
+    /* url parameter template of LIMIT */
+    { "param_limit",    ForeignServerRelationId },
+    { "param_limit",    ForeignTableRelationId },
+
+    /* order of rows in response */
+    { "response_order", ForeignTableRelationId },
+
+    /* url parameter template of columns needed by the query */
+    { "param_fields",   ForeignServerRelationId },
+    { "param_fields",   ForeignTableRelationId },
+
+    /* url parameter templates of columns (see WWWParamKind) */
+    { "param_eq",   AttributeRelationId },
+    { "param_lt",   AttributeRelationId },
+    { "param_le",   AttributeRelationId },
+    { "param_gt",   AttributeRelationId },
+    { "param_ge",   AttributeRelationId },
+    { "param_in",   AttributeRelationId },
+    { "param_like", AttributeRelationId },
+    { "param_null", AttributeRelationId },
+    { "param_not_null", AttributeRelationId },
+    { "param_sort_asc", AttributeRelationId },
+    { "param_sort_desc",    AttributeRelationId },
     /* Sentinel */
     { NULL,            InvalidOid }
 };
 
+/*
+ * kinds of quals passed to the server as url parameters
+ * (and of ORDER BY keys)
+ * order matches param_* column options in www_param_options
+ */
+typedef enum WWWParamKind
+{
+    WWW_PARAM_EQ,
+    WWW_PARAM_LT,
+    WWW_PARAM_LE,
+    WWW_PARAM_GT,
+    WWW_PARAM_GE,
+    WWW_PARAM_IN,
+    WWW_PARAM_LIKE,
+    WWW_PARAM_NULL,
+    WWW_PARAM_NOT_NULL,
+    WWW_PARAM_SORT_ASC,
+    WWW_PARAM_SORT_DESC,
+    WWW_PARAM_NUM
+} WWWParamKind;
+
+static const char *www_param_options[WWW_PARAM_NUM] =
+{
+    "param_eq",
+    "param_lt",
+    "param_le",
+    "param_gt",
+    "param_ge",
+    "param_in",
+    "param_like",
+    "param_null",
+    "param_not_null",
+    "param_sort_asc",
+    "param_sort_desc"
+};
+
+/*
+ * url parameter templates of a column
+ * "%s" is replaced with url encoded value (comma separated values for param_in),
+ * NULL - qual of this kind isn't passed to the server
+ */
+typedef struct WWWColumnParams
+{
+    char    *name;      /* url encoded column name, NULL - dropped column */
+    char    *templates[WWW_PARAM_NUM];
+} WWWColumnParams;
+
+/*
+ * key of response_order option: rows of response are sorted by it
+ * (nulls go last in ascending order and first in descending one)
+ */
+typedef struct WWWOrderKey
+{
+    AttrNumber  attnum;
+    bool        desc;
+} WWWOrderKey;
+
+/* method_select option */
+typedef enum WWWMethod
+{
+    WWW_METHOD_GET,
+    WWW_METHOD_POST,
+    WWW_METHOD_DELETE,
+    WWW_METHOD_OTHER
+} WWWMethod;
+
+/* response_type option */
+typedef enum WWWResponseFormat
+{
+    WWW_RESPONSE_JSON,
+    WWW_RESPONSE_XML,
+    WWW_RESPONSE_OTHER
+} WWWResponseFormat;
+
 typedef struct    WWW_fdw_options
 {
     char*   uri;
@@ -113,18 +284,127 @@ typedef struct    WWW_fdw_options
     char*   cookie;
     char*   username;
     char*   password;
+    /* options below aren't passed to callbacks (not in WWWFdwOptions type) */
+    char*   connection_idle_timeout;
+    char*   connection_max_per_host;
+    char*   response_stream;
+    char*   response_stream_rows;
+    char*   response_iterate_batch;
+    char*   request_latency;
+    char*   response_row_cost;
+    char*   expected_rows;
+    char*   request_lookup_limit;
+    char*   request_lookup_fetch_all;
+    char*   request_concurrency;
+    char*   page_next_path;
+    char*   page_next_header;
+    char*   page_next_param;
+    char*   page_limit;
+    char*   page_number_param;
+    char*   page_offset_param;
+    char*   page_size_param;
+    char*   page_size;
+    char*   page_total_path;
+    char*   page_ordered;
+    char*   param_limit;
+    char*   response_order;
+    char*   param_fields;
+    /* owner of the options, used as connection pool key */
+    Oid     serverid;
+    Oid     userid;
+    /* derived from options above once, when they're parsed */
+    WWWMethod           method;     /* method_select */
+    WWWResponseFormat   response_format;    /* response_type */
+    int     idle_timeout;
+    int     max_per_host;
+    bool    stream;
+    int     stream_rows;
+    int     iterate_batch;
+    double  latency;    /* ms */
+    double  row_cost;
+    double  rows;
+    int     lookup_limit;   /* lookups before whole response is fetched (fetch_all) */
+    bool    fetch_all;      /* request_lookup_fetch_all: whole response is grouped over lookup_limit */
+    int     concurrency;    /* concurrent requests of a scan, 0 - no fan-out */
+    bool    paged;          /* response has cursor of the next page */
+    int     max_pages;      /* page_limit, 0 - unlimited */
+    bool    offset_paged;   /* pages are numbered, total count is in the first one */
+    int     per_page;       /* page_size */
+    bool    ordered;        /* page_ordered */
+    WWWColumnParams *columns;   /* per column, by attnum - 1 */
+    int     ncolumns;
+    WWWOrderKey *order;     /* response_order */
+    int     norder;
+    /* cached state (see get_options) */
+    MemoryContext   cxt;    /* holds options and values below */
+    Datum   value;          /* WWWFdwOptions value for callbacks, built on demand */
 } WWW_fdw_options;
 
 typedef struct Reply
 {
     HeapTuple        *tuples;    /* array with result tuples */
+    Tuplestorestate  *store;     /* result tuples instead of the array (spilled to disk over work_mem) */
+    char             **raw;      /* per tuple: raw tokens of deferred columns, NULL - none
+                                  * (tuplestore keeps them as the last attribute instead) */
     uint32           ntuples;    /* number of results */
     int              tuple_index;
     WWW_fdw_options  *options;
     Oid              opts_type;
     Datum            opts_value;
+    bool             connection_reused;
+    struct JSONStream *stream;   /* not NULL in streaming mode only */
+    /* batched response_iterate_callback (response_iterate_batch option) */
+    HeapTuple        *iterated;  /* rows returned by the callback for current batch */
+    uint32           niterated;
+    uint32           iterated_index;
+    Oid              iterate_argtype;   /* array of table rows */
+    MemoryContext    iterate_cxt;   /* batch memory, reset for each batch */
+    MemoryContext    cxt;        /* lookup of parameterized scan: reply and state of its request,
+                                  * deleted with the reply, NULL - per query memory */
 } Reply;
 
+/*
+ * JSONRows
+ * reply filled by json decoder row by row
+ */
+typedef struct JSONRows
+{
+    Reply           *reply;
+    TupleDesc       tuple_desc;
+    uint32          size;       /* allocated size of reply->tuples */
+    MemoryContext   array_cxt;  /* reply->tuples/raw are allocated in it */
+    MemoryContext   tuple_cxt;  /* tuples are formed in it */
+    uint32          limit;      /* rows needed by the scan (LIMIT), 0 - all */
+    TupleDesc       raw_desc;   /* rows of store with raw tokens of deferred columns, NULL - none */
+    Datum           *raw_values;    /* row of raw_desc */
+    bool            *raw_isnull;
+} JSONRows;
+
+/*
+ * JSONStream
+ * state of json response, which is transferred and decoded
+ * on demand of www_iterate (response_stream option)
+ * tuples are buffered till response_stream_rows
+ */
+typedef struct JSONStream
+{
+    Reply               *reply;
+    ConnectionHandle    *connection;
+    CURLM               *multi;
+    struct curl_slist   *headers;
+    char                *curl_error_buffer;
+    int                 max_per_host;
+    bool                running;    /* transfer is started, parser initialized */
+    bool                paused;     /* transfer is paused, tuples buffer is full */
+    bool                done;       /* transfer is finished */
+    uint32              max_rows;   /* buffered rows, transfer is paused after them */
+    MemoryContext       batch_cxt;  /* buffered tuples, reset when they are returned */
+    ErrorData           *error;     /* error of write callback, raised after curl returns */
+    JSONRows            rows;
+    JSONDecoder         decoder;
+    json_parser         parser;
+} JSONStream;
+
 typedef struct PostParameters
 {
     bool            post;
@@ -132,8 +412,171 @@ typedef struct PostParameters
     StringInfoData  content_type;
 } PostParameters;
 
+/*
+ * WWWRequest
+ * state of one request: url, pooled curl handle and parsers of the response
+ * request is set up by www_request_start, its transfer is driven
+ * by curl_easy_perform or by curl multi handle (concurrent requests)
+ * and response is turned into reply by www_request_finish
+ */
+typedef struct WWWRequest
+{
+    ConnectionHandle    *connection;
+    char                *curl_error_buffer;
+    struct curl_slist   *headers;
+    StringInfoData      url;
+    PostParameters      post;
+    Oid                 opts_type;
+    Datum               opts_value;
+    StringInfoData      buffer;     /* response for response_deserialize_callback */
+    json_parser         json;
+    JSONDecoder         json_decoder;
+    JSONRows            json_rows;
+    xmlParserCtxtPtr    xml;
+    ErrorData           *error;     /* error of write callback, raised by www_request_finish */
+    JSONStream          *stream;    /* streaming: transfer is driven by www_iterate */
+    /* pagination (page_next_* options) */
+    JSONPathFinder      next_finder;    /* page_next_path in json decoded into rows */
+    const char          *next_header_name;  /* page_next_header */
+    char                *next_header;   /* its value, NULL - not received */
+    char                *next;      /* cursor of the next page, NULL - last page */
+    JSONPathFinder      total_finder;   /* page_total_path in json decoded into rows */
+    char                *total;     /* total count of rows, NULL - not found */
+} WWWRequest;
+
+/*
+ * WWWRelInfo
+ * planner state of the foreign table (baserel->fdw_private)
+ */
+typedef struct WWWRelInfo
+{
+    WWW_fdw_options *opts;
+    List            *remote_conds;  /* RestrictInfos passed to the server as url parameters */
+    List            *recheck_conds; /* remote_conds rechecked locally (all but equality) */
+    List            *local_conds;   /* RestrictInfos checked locally */
+    List            *fanout;        /* url parameters of IN list values, one request per item */
+    Expr            *fanout_expr;   /* array of IN list evaluated by executor, NULL - fanout is rendered */
+    char            *fanout_template;   /* param_eq template of fanout_expr values */
+    double          nfanout;        /* requests of fanned out IN list (estimate for fanout_expr), 0 - none */
+    double          limit;          /* rows needed by LIMIT of the query, 0 - all */
+    double          fetched_rows;   /* rows expected from the server */
+    QualCost        local_cost;     /* cost of local_conds and recheck_conds */
+} WWWRelInfo;
+
+/*
+ * WWWScanState
+ * executor state of the scan (node->fdw_state)
+ * parameterized scan (join clauses passed as url parameters) requests server
+ * for each new set of outer values, replies are cached by rendered parameters,
+ * so repeated outer values don't cause new requests
+ * with request_lookup_fetch_all whole response is fetched once after
+ * request_lookup_limit requests and its rows are grouped into cached replies
+ * by the same parameters (otherwise each new outer value is requested)
+ * each lookup is made in its own memory context, so evicted replies
+ * (over WWW_REPLY_CACHE_SIZE) and streaming ones free all their memory
+ */
+typedef struct WWWScanState
+{
+    WWW_fdw_options *opts;
+    Reply           *reply;         /* reply of the current request, NULL - no rows */
+    bool            requested;      /* reply is valid for current outer values */
+    List            *param_exprs;   /* ExprStates of outer values (fdw_exprs), NIL - not parameterized */
+    List            *param_templates;   /* String templates of param_exprs */
+    List            *param_columns; /* columns compared with param_exprs */
+    List            *fanout;        /* url parameters of fanned out IN list, NIL - none */
+    ExprState       *fanout_expr;   /* array giving fanout at execution, NULL - fanout is rendered */
+    char            *fanout_template;   /* param_eq template of its values */
+    uint32          limit;          /* rows needed by LIMIT of the query, 0 - all */
+    bool            *used;          /* per column: value is needed by the query, NULL - all */
+    bool            *deferred;      /* per column: decoded after local quals, NULL - none */
+    JSONDecoder     *resolver;      /* converts raw tokens of deferred columns */
+    TupleTableSlot  *raw_slot;      /* rows of tuplestore with raw tokens of deferred columns
+                                     * (bytea attribute after columns), NULL - no deferred columns */
+#if PG_VERSION_NUM >= 100000
+    ExprState       *filter;        /* local quals */
+#else
+    List            *filter;
+#endif
+    MemoryContext   row_cxt;        /* allocations of delivered row, reset for each row */
+    uint32          nrows;          /* rows of received pages */
+    /* pagination: next page is transferred while rows of current one are returned */
+    WWWRequest      *page;          /* request of the next page, NULL - none */
+    MemoryContext   page_cxt;       /* its memory */
+    MemoryContext   reply_cxt;      /* memory of current page, NULL - per query memory */
+    CURLM           *page_multi;
+    char            *page_url;      /* url of the first page (page_next_param is added to it) */
+    int             npages;         /* pages received */
+    HTAB            *replies;       /* ParamReplyEntry by rendered parameters */
+    List            *reply_keys;    /* keys of replies, the oldest first (eviction order) */
+    int             nlookups;       /* requests made for outer values */
+    bool            complete;       /* all rows are in replies, parameters without entry have no rows */
+} WWWScanState;
+
+/*
+ * ParamReplyEntry
+ * cached reply of parameterized request
+ */
+typedef struct ParamReplyEntry
+{
+    char            *params;        /* hash key (must be first) */
+    Reply           *reply;         /* NULL - no rows */
+    uint32          size;           /* allocated tuples of grouped reply, 0 - reply of request */
+} ParamReplyEntry;
+
+/*
+ * items of ForeignScan->fdw_private
+ */
+enum WWWScanPrivateIndex
+{
+    /* url parameters for remote quals (String node, empty - none) */
+    WWWScanPrivateUrlParams,
+    /* templates for values of outer rows (List of String, one per fdw_exprs item) */
+    WWWScanPrivateParamTemplates,
+    /* columns compared with values of outer rows (IntList, one per fdw_exprs item) */
+    WWWScanPrivateParamColumns,
+    /* url parameters of fanned out IN list (List of String, one request per item, NIL - none) */
+    WWWScanPrivateFanout,
+    /* rows needed by LIMIT of the query (Integer, 0 - all) */
+    WWWScanPrivateLimit,
+    /* columns not needed by the query, their values aren't decoded (IntList, NIL - none) */
+    WWWScanPrivateUnused,
+    /* columns decoded for rows passing local quals only (IntList, NIL - none),
+     * local quals are checked by www_iterate then (fdw_exprs after outer values and fan-out array) */
+    WWWScanPrivateDeferred,
+    /* param_eq template of fan-out array evaluated by executor (String, empty - none),
+     * the array is fdw_exprs item after outer values */
+    WWWScanPrivateFanoutTemplate
+};
+
+/*
+ * planner cost units per millisecond of request latency
+ * (sequential page read, cost 1.0, is taken as ~10 microseconds)
+ */
+#define WWW_COST_PER_MS 100.0
+
+/*
+ * cost of a request sorted by the server (param_sort_* templates)
+ * relative to unsorted one, so it's chosen only if the order is useful
+ */
+#define WWW_SORT_COST_MULTIPLIER 1.05
+
+/*
+ * rows returned between progress calls of the next page transfer
+ */
+#define WWW_PAGE_POLL_ROWS 64
+
+/*
+ * numbered pages requested by one fan-out (see www_request_pages)
+ */
+#define WWW_PAGE_BATCH 256
+
+/*
+ * cached replies of parameterized scan, the oldest one is dropped over it
+ */
+#define WWW_REPLY_CACHE_SIZE 256
+
 static bool www_is_valid_option(const char *option, Oid context);
-static void get_options(Oid foreigntableid, WWW_fdw_options *opts);
+static WWW_fdw_options *get_options(Oid foreigntableid);
 
 /*
  * SQL functions
@@ -147,6 +590,8 @@ PG_FUNCTION_INFO_V1(www_fdw_validator);
 /*
  * FDW callback routines
  */
+static void parse_column_options(Oid foreigntableid, WWW_fdw_options *opts);
+static char *percent_encode(unsigned char *s, int srclen);
 static void www_get_foreign_rel_size(PlannerInfo *root,
                                   RelOptInfo *baserel,
                                   Oid foreigntableid);
@@ -175,7 +620,7 @@ static void www_rescan(ForeignScanState *node);
 static void www_end(ForeignScanState *node);
 
 static void get_www_fdw_options(WWW_fdw_options *opts, Oid *opts_type, Datum *opts_value);
-static void get_www_fdw_post_parameters(PostParameters *post, Oid *post_type, Datum *post_value);
+static void get_www_fdw_post_parameters(WWW_fdw_options *opts, PostParameters *post, Oid *post_type, Datum *post_value);
 
 static size_t json_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp);
 static size_t xml_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp);
@@ -206,6 +651,61 @@ parse_parameter(char* name, char** var, DefElem* param)
     return    false;
 }
 
+/*
+ * check_non_negative_int
+ * raise error if option value isn't non negative integer
+ */
+static void
+check_non_negative_int(char* name, char* value)
+{
+    char    *end;
+    long    v;
+
+    errno = 0;
+    v = strtol(value, &end, 10);
+    if (end == value || '\0' != *end || 0 != errno || 0 > v || INT_MAX < v)
+        ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("invalid value for %s: %s (non negative integer is expected)", name, value)
+            ));
+}
+
+/*
+ * check_non_negative_real
+ * raise error if option value isn't non negative number
+ */
+static void
+check_non_negative_real(char* name, char* value)
+{
+    char    *end;
+    double  v;
+
+    errno = 0;
+    v = strtod(value, &end);
+    if (end == value || '\0' != *end || 0 != errno || !(0 <= v) || isinf(v))
+        ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("invalid value for %s: %s (non negative number is expected)", name, value)
+            ));
+}
+
+/*
+ * check_param_template
+ * raise error if url parameter template of column has wrong number of "%s"
+ * (one for value, none for param_null/param_not_null/param_sort_*)
+ */
+static void
+check_param_template(char* name, char* value)
+{
+    char    *placeholder = strstr(value, "%s");
+    bool    valueless = 0 == strcmp(name, "param_null") || 0 == strcmp(name, "param_not_null")
+                        || 0 == strncmp(name, "param_sort_", strlen("param_sort_"));
+
+    if (valueless ? NULL != placeholder : (NULL == placeholder || NULL != strstr(placeholder + 2, "%s")))
+        ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("invalid value for %s: %s (%s)", name, value,
+                valueless ? "\"%s\" isn't expected" : "exactly one \"%s\" for value is expected")
+            ));
+}
+
 /*
  * www_fdw_validator
  * FDW callback realization
@@ -241,6 +741,27 @@ www_fdw_validator(PG_FUNCTION_ARGS)
     char        *cookie        = NULL;
     char        *username      = NULL;
     char        *password      = NULL;
+    char        *connection_idle_timeout   = NULL;
+    char        *connection_max_per_host   = NULL;
+    char        *response_stream   = NULL;
+    char        *response_stream_rows  = NULL;
+    char        *response_iterate_batch    = NULL;
+    char        *request_latency   = NULL;
+    char        *response_row_cost = NULL;
+    char        *expected_rows = NULL;
+    char        *request_lookup_limit  = NULL;
+    char        *request_lookup_fetch_all  = NULL;
+    char        *request_concurrency   = NULL;
+    char        *page_next_path    = NULL;
+    char        *page_next_header  = NULL;
+    char        *page_next_param   = NULL;
+    char        *page_limit    = NULL;
+    char        *page_number_param = NULL;
+    char        *page_offset_param = NULL;
+    char        *page_size_param   = NULL;
+    char        *page_size     = NULL;
+    char        *page_total_path   = NULL;
+    char        *page_ordered  = NULL;
 
     d("www_fdw_validator routine");
 
@@ -276,6 +797,11 @@ www_fdw_validator(PG_FUNCTION_ARGS)
                 ));
         }
 
+        if(0 == strncmp(def->defname, "param_", strlen("param_")))
+        {
+            check_param_template(def->defname, defGetString(def));
+            continue;
+        }
         if(parse_parameter("uri", &uri, def)) continue;
         if(parse_parameter("uri_select", &uri_select, def)) continue;
         if(parse_parameter("uri_insert", &uri_insert, def)) continue;
@@ -322,6 +848,100 @@ www_fdw_validator(PG_FUNCTION_ARGS)
         };
         if(parse_parameter("response_deserialize_callback", &response_deserialize_callback, def)) continue;
         if(parse_parameter("response_iterate_callback", &response_iterate_callback, def)) continue;
+        if(parse_parameter("response_iterate_batch", &response_iterate_batch, def))
+        {
+            check_non_negative_int("response_iterate_batch", response_iterate_batch);
+            continue;
+        }
+        if(parse_parameter("response_stream", &response_stream, def))
+        {
+            if(
+                0 != strcmp(response_stream, "0")
+                &&
+                0 != strcmp(response_stream, "1")
+            )
+            {
+                ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+                    errmsg("invalid value for response_stream: %s (0 or 1 are available only)", response_stream)
+                    ));
+            }
+            continue;
+        }
+        if(parse_parameter("response_stream_rows", &response_stream_rows, def))
+        {
+            check_non_negative_int("response_stream_rows", response_stream_rows);
+            continue;
+        }
+        if(parse_parameter("request_latency", &request_latency, def))
+        {
+            check_non_negative_real("request_latency", request_latency);
+            continue;
+        }
+        if(parse_parameter("response_row_cost", &response_row_cost, def))
+        {
+            check_non_negative_real("response_row_cost", response_row_cost);
+            continue;
+        }
+        if(parse_parameter("expected_rows", &expected_rows, def))
+        {
+            check_non_negative_int("expected_rows", expected_rows);
+            continue;
+        }
+        if(parse_parameter("request_lookup_limit", &request_lookup_limit, def))
+        {
+            check_non_negative_int("request_lookup_limit", request_lookup_limit);
+            continue;
+        }
+        if(parse_parameter("request_lookup_fetch_all", &request_lookup_fetch_all, def))
+        {
+            if(
+                0 != strcmp(request_lookup_fetch_all, "0")
+                &&
+                0 != strcmp(request_lookup_fetch_all, "1")
+            )
+            {
+                ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+                    errmsg("invalid value for request_lookup_fetch_all: %s (0 or 1 are available only)", request_lookup_fetch_all)
+                    ));
+            }
+            continue;
+        }
+        if(parse_parameter("request_concurrency", &request_concurrency, def))
+        {
+            check_non_negative_int("request_concurrency", request_concurrency);
+            continue;
+        }
+        if(parse_parameter("page_next_path", &page_next_path, def)) continue;
+        if(parse_parameter("page_next_header", &page_next_header, def)) continue;
+        if(parse_parameter("page_next_param", &page_next_param, def)) continue;
+        if(parse_parameter("page_limit", &page_limit, def))
+        {
+            check_non_negative_int("page_limit", page_limit);
+            continue;
+        }
+        if(parse_parameter("page_number_param", &page_number_param, def)) continue;
+        if(parse_parameter("page_offset_param", &page_offset_param, def)) continue;
+        if(parse_parameter("page_size_param", &page_size_param, def)) continue;
+        if(parse_parameter("page_size", &page_size, def))
+        {
+            check_non_negative_int("page_size", page_size);
+            continue;
+        }
+        if(parse_parameter("page_total_path", &page_total_path, def)) continue;
+        if(parse_parameter("page_ordered", &page_ordered, def))
+        {
+            if(
+                0 != strcmp(page_ordered, "0")
+                &&
+                0 != strcmp(page_ordered, "1")
+            )
+            {
+                ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+                    errmsg("invalid value for page_ordered: %s (0 or 1 are available only)", page_ordered)
+                    ));
+            }
+            continue;
+        }
         if(parse_parameter("ssl_cert", &ssl_cert, def)) continue;
         if(parse_parameter("ssl_key", &ssl_key, def)) continue;
         if(parse_parameter("cainfo", &cainfo, def)) continue;
@@ -329,8 +949,24 @@ www_fdw_validator(PG_FUNCTION_ARGS)
         if(parse_parameter("cookie", &cookie, def)) continue;
         if(parse_parameter("username", &username, def)) continue;
         if(parse_parameter("password", &password, def)) continue;
+        if(parse_parameter("connection_idle_timeout", &connection_idle_timeout, def))
+        {
+            check_non_negative_int("connection_idle_timeout", connection_idle_timeout);
+            continue;
+        }
+        if(parse_parameter("connection_max_per_host", &connection_max_per_host, def))
+        {
+            check_non_negative_int("connection_max_per_host", connection_max_per_host);
+            continue;
+        }
     }
 
+    /* options of server and table together are checked by parse_options */
+    if(page_number_param && page_offset_param)
+        ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("page_number_param and page_offset_param can't be used together")
+            ));
+
     PG_RETURN_VOID();
 }
 
@@ -427,1328 +1063,3748 @@ percent_encode(unsigned char *s, int srclen)
 }
 
 /*
- * www_param
- *  check and create column=value string for column=value criteria in query
- *  raise error for operators differ from '='
- *  raise error for operators with not 2 arguments
+ * www_param_var
+ *  column of the foreign table under node (binary compatible casts are skipped)
+ *  returns 0 if node isn't column of the scanned relation
  */
-static char *
-www_param(Node *node, TupleDesc tupdesc)
+static AttrNumber
+www_param_var(Node *node, WWW_fdw_options *opts, Index relid)
 {
-    if (node == NULL)
-        return NULL;
-
-    if (
-        /* col=false
-            :qual (
-                {BOOLEXPR
-                :boolop not
-                :args (
-                {VAR
-                :varno 1
-                :varattno 2
-                :vartype 16
-                :vartypmod -1
-                :varcollid 0
-                :varlevelsup 0
-                :varnoold 1
-                :varoattno 2
-                :location 33
-                }
-                )
-                :location -1
-                }
-            )
-        */
-        IsA(node, BoolExpr)
-    ) {
-        BoolExpr    *op = (BoolExpr*)node;
-        if(
-            NOT_EXPR == op->boolop
-            &&
-            1 == list_length(op->args)
-        ) {
-            Node    *arg = list_nth(op->args, 0);
-            if( IsA(arg, Var) ) {
-                char    *key;
-                StringInfoData    buf;
-                Index   varattno = ((Var *) arg)->varattno;
-                Assert(0 < varattno && varattno <= tupdesc->natts);
-                key = NameStr(tupdesc->attrs[varattno - 1]->attname);
-
-                initStringInfo(&buf);
-                appendStringInfo(&buf, "%s=%s", percent_encode((unsigned char *) key, -1),
-                    percent_encode((unsigned char*)"false", -1));
-                return buf.data;
-            }
-            else {
-                ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("NOT operator with not a var detected")));
-            }
-        }
-    }
-    else if (
-        /* col=true
-              :qual (
-                 {VAR
-                 :varno 1
-                 :varattno 2
-                 :vartype 16
-                 :vartypmod -1
-                 :varcollid 0
-                 :varlevelsup 0
-                 :varnoold 1
-                 :varoattno 2
-                 :location 33
-                 }
-              )
-        */
-        IsA(node, Var)
-    ) {
-        char    *key;
-        StringInfoData    buf;
-        Index   varattno = ((Var *) node)->varattno;
-        Assert(0 < varattno && varattno <= tupdesc->natts);
-        key = NameStr(tupdesc->attrs[varattno - 1]->attname);
-
-        initStringInfo(&buf);
-        appendStringInfo(&buf, "%s=%s", percent_encode((unsigned char *) key, -1),
-            percent_encode((unsigned char*)"true", -1));
-        return buf.data;
-    }
-    else if (IsA(node, OpExpr))
-    {
-        OpExpr       *op = (OpExpr *) node;
-        Node       *left, *right, *tmp;
-        Index        varattno;
-        char       *key, *val;
-        StringInfoData    buf;
-
-        if (list_length(op->args) != 2)
-            ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("Operators with not 2 arguments aren't supported")));
-
-        if (!(
-            op->opfuncid == F_TEXTEQ
-            ||
-            /* integers */
-            op->opfuncid == F_INT2EQ
-            ||
-            op->opfuncid == F_INT4EQ
-            ||
-            op->opfuncid == F_INT24EQ
-            ||
-            op->opfuncid == F_INT42EQ
-            ||
-            op->opfuncid == F_INT8EQ
-            ||
-            op->opfuncid == F_INT84EQ
-            ||
-            op->opfuncid == F_INT48EQ
-            ||
-            op->opfuncid == F_INT28EQ
-            ||
-            op->opfuncid == F_INT82EQ
-            ||
-            op->opfuncid == F_DATE_EQ
-            ||
-            op->opfuncid == F_TIME_EQ
-            ||
-            op->opfuncid == F_TIMESTAMP_EQ
-            ||
-            /* can't find it's definition, but it's also TIMESTAMP_EQ */
-            op->opfuncid == 2052
-            /*
-            ||
-            op->opfuncid ==
-            */
-        ))
-            ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("Invalid operator, only '=' is supported")));
+    Var     *var;
 
-        left = list_nth(op->args, 0);
-        right = list_nth(op->args, 1);
-        if(!(
-            (IsA(left, Var) && IsA(right, Const))
-            ||
-            (IsA(left, Const) && IsA(right, Var))
-        ))
-            ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("One operand supposed to be column another constant")));
-        if(IsA(left, Const) && IsA(right, Var))
-        {
-            tmp        = left;
-            left    = right;
-            right    = tmp;
-        }
+    while (node && IsA(node, RelabelType))
+        node = (Node *) ((RelabelType *) node)->arg;
 
-        varattno = ((Var *) left)->varattno;
-        Assert(0 < varattno && varattno <= tupdesc->natts);
-        key = NameStr(tupdesc->attrs[varattno - 1]->attname);
-
-        initStringInfo(&buf);
-        val = serialize_const((Const *) right);
-        appendStringInfo(&buf, "%s=%s", percent_encode((unsigned char *) key, -1),
-            percent_encode((unsigned char *) val, -1));
-        return buf.data;
-    }
-    else
-    {
-        ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("Only simple WHERE statements are covered: column=const [AND column2=const2 ...]")));
-    }
+    if (!node || !IsA(node, Var))
+        return 0;
 
-    ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("Strange error in parameter parser")));
+    var = (Var *) node;
+    if (var->varno != relid || 0 != var->varlevelsup
+        || 0 >= var->varattno || var->varattno > opts->ncolumns)
+        return 0;
 
-    return NULL;
+    return var->varattno;
 }
 
 /*
- * www_get_forein_rel_size
- *   Create a FdwPlan, which is empty for now.
- *     Obtain relation size estimates for a foreign table
+ * www_param_value
+ *  text representation of the value, url encoded
  */
-static void
-www_get_foreign_rel_size(PlannerInfo *root,
-                     RelOptInfo *baserel,
-                     Oid foreigntableid)
+static char *
+www_param_value(Oid type, Datum value)
 {
-   baserel->fdw_private = NULL;
-   /* we can't calculate value for baserel->rows here */
+    Oid     output;
+    bool    varlena;
+
+    if (BOOLOID == type)
+        return DatumGetBool(value) ? "true" : "false";
+
+    getTypeOutputInfo(type, &output, &varlena);
+    return percent_encode((unsigned char *) OidOutputFunctionCall(output, value), -1);
 }
 
 /*
- * www_get_foreign_paths
- *        Create possible access paths for a scan on the foreign table
- *
- *        Currently we don't support any push-down feature, so there is only one
- *        possible access path, which simply returns all records in the order in
- *        the data file.
+ * www_param_append
+ *  append parameter made from template to buf, "%s" in template is replaced with value
+ *  buf == NULL - just check template exists
  */
-static void
-www_get_foreign_paths(PlannerInfo *root,
-                    RelOptInfo *baserel,
-                    Oid foreigntableid)
+static bool
+www_param_append(StringInfo buf, const char *template, const char *value)
 {
-    /* calculations from file_fdw
-     * we can't calculate value for baserel->rows here
-     * */
-    Cost        cpu_per_tuple   = cpu_tuple_cost * 10 + baserel->baserestrictcost.per_tuple;
-    Cost        startup_cost    = baserel->baserestrictcost.startup;
-    Cost        total_cost      = startup_cost + cpu_per_tuple * baserel->rows;
+    const char  *placeholder;
 
-    /* Create a ForeignPath node and add it as only possible path */
-    add_path(baserel, (Path *)
-            create_foreignscan_path(root, baserel,
-#if PG_VERSION_NUM >= 90600
-                                     NULL, /* PathTarget */
-#endif
-                                     baserel->rows,
-                                     startup_cost,
-                                     total_cost,
-                                     NIL, /* no pathkeys */
-                                     NULL, /* no outer rel either */
-                                     NULL
-#if PG_VERSION_NUM >= 90500
-,
-/*
-* Require PostgreSQL >= 9.5
-*/
-                     NIL /* no fdw_private list */
-#endif
-                                     )); /* no fdw_private data */
+    if (NULL == template)
+        return false;
+    if (NULL == buf)
+        return true;
+
+    if (0 < buf->len)
+        appendStringInfoChar(buf, '&');
+
+    placeholder = strstr(template, "%s");
+    if (NULL == placeholder || NULL == value)
+    {
+        appendStringInfoString(buf, template);
+        return true;
+    }
+
+    appendBinaryStringInfo(buf, template, placeholder - template);
+    appendStringInfoString(buf, value);
+    appendStringInfoString(buf, placeholder + 2);
+    return true;
 }
 
 /*
- * www_get_foreign_plan
- *        Create a ForeignScan plan node for scanning the foreign table
+ * www_param_strategy
+ *  btree strategy of the operator (BTEqualStrategyNumber etc), 0 - not btree comparison
+ *  strategy is taken from operator family, so any type with btree opclass is covered
  */
-static ForeignScan *
-www_get_foreign_plan(PlannerInfo *root,
-                   RelOptInfo *baserel,
-                   Oid foreigntableid,
-                   ForeignPath *best_path,
-                   List *tlist,
-                   List *scan_clauses
-#if PG_VERSION_NUM >= 90500
-,
-/*
-* Require PostgreSQL >= 9.5
-*/
-                    Plan *outer_plan
-#endif
-        )
+static int
+www_param_strategy(Oid opno)
 {
-    Index        scan_relid = baserel->relid;
+    List    *interpretations = get_op_btree_interpretation(opno);
+    int     strategy;
 
-    /*
-     * We have no native ability to evaluate restriction clauses, so we just
-     * put all the scan_clauses into the plan node's qual list for the
-     * executor to check.  So all we have to do here is strip RestrictInfo
-     * nodes from the clauses and ignore pseudoconstants (which will be
-     * handled elsewhere).
-     */
-    scan_clauses = extract_actual_clauses(scan_clauses, false);
+    if (NIL == interpretations)
+        return 0;
 
-    /* Create the ForeignScan node */
-    return make_foreignscan(tlist
-                            ,scan_clauses
-                            ,scan_relid
-                            ,NIL /* no expressions to evaluate */
-                            ,NIL /* no private state either */
-#if (PG_VERSION_NUM >= 90500)
-                            ,NIL /* no scan_tlist either */
-                            ,NIL   /* no remote quals */
-                            ,outer_plan
-#endif
-    );
+    strategy = ((OpBtreeInterpretation *) linitial(interpretations))->strategy;
+    list_free_deep(interpretations);
+
+    return (BTLessStrategyNumber <= strategy && strategy <= BTGreaterStrategyNumber) ? strategy : 0;
 }
 
 /*
- * www_explain
- *   Produce extra output for EXPLAIN
+ * www_like_prefix
+ *  returns prefix of LIKE pattern 'prefix%' (no other wildcards), NULL otherwise
  */
-static void
-www_explain(ForeignScanState *node, ExplainState *es)
+static char *
+www_like_prefix(const char *pattern)
 {
-    d("www_explain routine");
-
-    ExplainPropertyText("WWW API", "Request", es);
-}
+    StringInfoData  buf;
+    const char      *p;
 
-/*
- * describe_spi_code
- * return string description for spi function return code
- */
-static
-char*
-describe_spi_code(int code)
-{
-    switch(code)
+    initStringInfo(&buf);
+    for (p = pattern; *p; p++)
     {
-        case SPI_ERROR_CONNECT:        return "ERROR CONNECT";
-        case SPI_ERROR_COPY:            return "ERROR COPY";
-        case SPI_ERROR_OPUNKNOWN:    return "ERROR OPUNKNOWN";
-        case SPI_ERROR_UNCONNECTED:    return "ERROR UNCONNECTED";
-        case SPI_ERROR_CURSOR:        return "ERROR CURSOR";
-        case SPI_ERROR_ARGUMENT:        return "ERROR ARGUMENT";
-        case SPI_ERROR_PARAM:        return "ERROR PARAM";
-        case SPI_ERROR_TRANSACTION:    return "ERROR TRANSACTION";
-        case SPI_ERROR_NOATTRIBUTE:    return "ERROR NOATTRIBUTE";
-        case SPI_ERROR_NOOUTFUNC:    return "ERROR NOOUTFUNC";
-        case SPI_ERROR_TYPUNKNOWN:    return "ERROR TYPUNKNOWN";
-
-        case SPI_OK_CONNECT:            return "OK CONNECT";
-        case SPI_OK_FINISH:            return "OK FINISH";
-        case SPI_OK_FETCH:            return "OK FETCH";
-        case SPI_OK_UTILITY:            return "OK UTILITY";
-        case SPI_OK_SELECT:            return "OK SELECT";
-        case SPI_OK_SELINTO:            return "OK SELINTO";
-        case SPI_OK_INSERT:            return "OK INSERT";
-        case SPI_OK_DELETE:            return "OK DELETE";
-        case SPI_OK_UPDATE:            return "OK UPDATE";
-        case SPI_OK_CURSOR:            return "OK CURSOR";
-        case SPI_OK_INSERT_RETURNING: return "OK INSERT_RETURNING";
-        case SPI_OK_DELETE_RETURNING: return "OK DELETE_RETURNING";
-        case SPI_OK_UPDATE_RETURNING: return "OK UPDATE_RETURNING";
-        case SPI_OK_REWRITTEN:        return "OK REWRITTEN";
+        if ('\\' == *p)
+        {
+            if ('\0' == *++p)
+                return NULL;
+        }
+        else if ('_' == *p)
+            return NULL;
+        else if ('%' == *p)
+            return ('\0' == p[1] && 0 < buf.len) ? buf.data : NULL;
 
-        default:
-            return    "undefined code";
+        appendStringInfoChar(&buf, *p);
     }
 
-    return    "undefined code";
+    /* pattern without wildcards is equality, not a prefix */
+    return NULL;
 }
 
 /*
- * serialize_request_parameters_with_callback
- * serialize request parameters using specified callback
- * currently following serialize of quals are supported:
- *  * null (pass as it as null no matter on quals)
- *  * log (same as with debug_print_parse)
- *  * empty string otherwise (plus issue warning)
- *  * json (pass as it as null no matter on quals)
- *  * xml (pass as it as null no matter on quals)
- * there is not finished branch for tree serialization into json/xml
- * but it started taking too much time and postponed for next versions (if any)
+ * www_param
+ *  render qual as url parameter using templates of the column (column options param_*)
+ *  returns false if qual can't be passed to the server:
+ *  supported quals are column op const for btree =, <, <=, >, >=,
+ *  column = ANY(const array), column LIKE 'prefix%', column IS [NOT] NULL
+ *  and boolean column/NOT column
+ *  buf == NULL - check only
  */
-static
-void
-serialize_request_with_callback(WWW_fdw_options *opts, Oid opts_type, Datum opts_value, ForeignScanState *node, StringInfoData *url, PostParameters *post)
+static bool
+www_param(Node *node, WWW_fdw_options *opts, Index relid, StringInfo buf)
 {
-    int    res;
-    StringInfoData    cmd, qualSer;
-    Oid    argtypes[4];
-    Datum argvalues[4], rpost;
-    char nulls[4];
-    char *rurl = NULL;
-    HeapTupleHeader rpost_tuple_header;
-    bool isnull;
-    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
+    AttrNumber  attnum;
+    char        **templates;
 
-    argtypes[0] = opts_type;
-    argvalues[0] = opts_value;
-    nulls[0] = 0;
+    if (node == NULL)
+        return false;
 
-    if(0 == strcmp("log", opts->request_serialize_type))
-    {
-        initStringInfo(&qualSer);
-        appendStringInfoString( &qualSer, nodeToString(node->ss.ps.plan->qual) );
-        nulls[1] = ' ';
-    }
-    else if(0 == strcmp("null", opts->request_serialize_type))
+    /* col=false */
+    if (IsA(node, BoolExpr))
     {
-        nulls[1] = 'n';
+        BoolExpr    *op = (BoolExpr*)node;
+
+        if (NOT_EXPR != op->boolop || 1 != list_length(op->args)
+            || 0 == (attnum = www_param_var(linitial(op->args), opts, relid)))
+            return false;
+        return www_param_append(buf, opts->columns[attnum - 1].templates[WWW_PARAM_EQ], "false");
     }
-    else if(0 == strcmp("json", opts->request_serialize_type))
+
+    /* col=true */
+    if (IsA(node, Var))
     {
-        initStringInfo(&qualSer);
-        appendStringInfoString( &qualSer, serialize_quals(
-                                    (0 == strcmp("0",opts->request_serialize_human_readable) ? 0 : 1),
-                                    node->ss.ps.plan->qual,
-                                    serialize_node_with_children_callback_json,
-                                    serialize_node_without_children_callback_json,
-                                    serialize_list_separator_callback_json) );
-        nulls[1] = ' ';
+        if (BOOLOID != ((Var *) node)->vartype || 0 == (attnum = www_param_var(node, opts, relid)))
+            return false;
+        return www_param_append(buf, opts->columns[attnum - 1].templates[WWW_PARAM_EQ], "true");
     }
-    else if(0 == strcmp("xml", opts->request_serialize_type))
+
+    /* col IS [NOT] NULL */
+    if (IsA(node, NullTest))
     {
-        initStringInfo(&qualSer);
-        appendStringInfoString( &qualSer, serialize_quals(
-                                    (0 == strcmp("0",opts->request_serialize_human_readable) ? 0 : 1),
-                                    node->ss.ps.plan->qual,
-                                    serialize_node_with_children_callback_xml,
-                                    serialize_node_without_children_callback_xml,
-                                    serialize_list_separator_callback_xml) );
-        nulls[1] = ' ';
+        NullTest    *test = (NullTest *) node;
+
+        if (test->argisrow || 0 == (attnum = www_param_var((Node *) test->arg, opts, relid)))
+            return false;
+        templates = opts->columns[attnum - 1].templates;
+        return www_param_append(buf, templates[IS_NULL == test->nulltesttype ? WWW_PARAM_NULL : WWW_PARAM_NOT_NULL], NULL);
     }
-    else
+
+    /* col = ANY(const array) */
+    if (IsA(node, ScalarArrayOpExpr))
     {
-        /* set empty string and issue warning */
-        initStringInfo(&qualSer);
+        ScalarArrayOpExpr   *op = (ScalarArrayOpExpr *) node;
+        Const       *c;
+        ArrayType   *array;
+        Oid         elemtype;
+        int16       elemlen;
+        bool        elembyval;
+        char        elemalign;
+        Datum       *elems;
+        bool        *nulls;
+        int         nelems, i;
+        StringInfoData  values;
+
+        if (!op->useOr || 2 != list_length(op->args)
+            || 0 == (attnum = www_param_var(linitial(op->args), opts, relid))
+            || !IsA(lsecond(op->args), Const)
+            || BTEqualStrategyNumber != www_param_strategy(op->opno))
+            return false;
+
+        c = (Const *) lsecond(op->args);
+        templates = opts->columns[attnum - 1].templates;
+        if (c->constisnull || NULL == templates[WWW_PARAM_IN])
+            return false;
+
+        array = DatumGetArrayTypeP(c->constvalue);
+        elemtype = ARR_ELEMTYPE(array);
+        get_typlenbyvalalign(elemtype, &elemlen, &elembyval, &elemalign);
+        deconstruct_array(array, elemtype, elemlen, elembyval, elemalign, &elems, &nulls, &nelems);
+
+        /* nulls never match, so they're skipped */
+        initStringInfo(&values);
+        for (i = 0; i < nelems; i++)
+        {
+            if (nulls[i])
+                continue;
+            if (0 < values.len)
+                appendStringInfoChar(&values, ',');
+            appendStringInfoString(&values, www_param_value(elemtype, elems[i]));
+        }
 
-        ereport(WARNING,
-            (
-                errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
-                errmsg("Invalid request_serialize_type: %s", opts->request_serialize_type)
-            )
-        );
+        /* empty list matches nothing, it's left for local check */
+        if (0 == values.len)
+            return false;
 
-        nulls[1] = ' ';
+        return www_param_append(buf, templates[WWW_PARAM_IN], values.data);
     }
-    argtypes[1] = TEXTOID;
-    argvalues[1] = 'n' == nulls[1] ? PointerGetDatum(NULL) : make_text_data(&qualSer);
 
-    argtypes[2] = TEXTOID;
-    argvalues[2] = make_text_data(url);
-    nulls[2] = 0;
+    /* col op const, const op col */
+    if (IsA(node, OpExpr))
+    {
+        OpExpr      *op = (OpExpr *) node;
+        Node        *left, *right;
+        Const       *c;
+        int         strategy;
+        char        *prefix;
+
+        if (2 != list_length(op->args))
+            return false;
+
+        left = linitial(op->args);
+        right = lsecond(op->args);
+
+        if (0 != (attnum = www_param_var(left, opts, relid)) && IsA(right, Const))
+            c = (Const *) right;
+        else if (0 != (attnum = www_param_var(right, opts, relid)) && IsA(left, Const))
+            c = (Const *) left;
+        else
+            return false;
 
-    get_www_fdw_post_parameters(post, &(argtypes[3]), &(argvalues[3]));
-    nulls[3] = argvalues[3] ? 0 : 1;
+        if (c->constisnull)
+            return false;
 
-    initStringInfo(&cmd);
-    appendStringInfo(&cmd, "SELECT * FROM %s($1,$2,$3,$4)", opts->request_serialize_callback);
+        templates = opts->columns[attnum - 1].templates;
 
-    SPI_connect_wrapper();
-    res    = SPI_execute_with_args(cmd.data, 4, argtypes, argvalues, nulls, true, 0);
+        /* col LIKE 'prefix%' */
+        if (F_TEXTLIKE == op->opfuncid || F_BPCHARLIKE == op->opfuncid)
+        {
+            if (c != (Const *) right || NULL == templates[WWW_PARAM_LIKE]
+                || NULL == (prefix = www_like_prefix(TextDatumGetCString(c->constvalue))))
+                return false;
+            return www_param_append(buf, templates[WWW_PARAM_LIKE], percent_encode((unsigned char *) prefix, -1));
+        }
 
-    if(0 > res)
-    {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("Can't spi execute: %i (%s)", res, describe_spi_code(res))
-            )
-        );
+        strategy = www_param_strategy(op->opno);
+        /* const op col: operator is commuted */
+        if (c == (Const *) left)
+        {
+            switch (strategy)
+            {
+                case BTLessStrategyNumber:          strategy = BTGreaterStrategyNumber; break;
+                case BTLessEqualStrategyNumber:     strategy = BTGreaterEqualStrategyNumber; break;
+                case BTGreaterEqualStrategyNumber:  strategy = BTLessEqualStrategyNumber; break;
+                case BTGreaterStrategyNumber:       strategy = BTLessStrategyNumber; break;
+            }
+        }
+
+        switch (strategy)
+        {
+            case BTEqualStrategyNumber:         templates = &templates[WWW_PARAM_EQ]; break;
+            case BTLessStrategyNumber:          templates = &templates[WWW_PARAM_LT]; break;
+            case BTLessEqualStrategyNumber:     templates = &templates[WWW_PARAM_LE]; break;
+            case BTGreaterEqualStrategyNumber:  templates = &templates[WWW_PARAM_GE]; break;
+            case BTGreaterStrategyNumber:       templates = &templates[WWW_PARAM_GT]; break;
+            default:
+                return false;
+        }
+
+        if (NULL == *templates)
+            return false;
+        return www_param_append(buf, *templates, buf ? www_param_value(c->consttype, c->constvalue) : NULL);
     }
 
-    if(0 == SPI_processed)
+    return false;
+}
+
+/*
+ * www_param_exact
+ *  qual passed to the server by www_param is equality (col = const,
+ *  col IN (...), boolean col), server's filter is trusted for it
+ *  other quals (ranges, LIKE prefix, IS [NOT] NULL) are rechecked locally:
+ *  server can compare in other collation or case, treat bounds,
+ *  escapes or missing values in its own way
+ */
+static bool
+www_param_exact(Node *node)
+{
+    if (IsA(node, Var) || IsA(node, BoolExpr) || IsA(node, ScalarArrayOpExpr))
+        return true;
+    return IsA(node, OpExpr) && BTEqualStrategyNumber == www_param_strategy(((OpExpr *) node)->opno);
+}
+
+/*
+ * www_fanout_params
+ *  url parameters for values of array, one param_eq parameter per distinct value
+ *  NIL - array has no values to ask for
+ */
+static List *
+www_fanout_params(const char *template, Datum value)
+{
+    ArrayType   *array = DatumGetArrayTypeP(value);
+    Oid         elemtype = ARR_ELEMTYPE(array);
+    int16       elemlen;
+    bool        elembyval;
+    char        elemalign;
+    Datum       *elems;
+    bool        *nulls;
+    int         nelems, i;
+    List        *params = NIL;
+
+    get_typlenbyvalalign(elemtype, &elemlen, &elembyval, &elemalign);
+    deconstruct_array(array, elemtype, elemlen, elembyval, elemalign, &elems, &nulls, &nelems);
+
+    /* nulls never match, duplicates would return same rows twice */
+    for (i = 0; i < nelems; i++)
     {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("No results were returned from request_serialize_callback '%s': %i", opts->request_serialize_callback, SPI_processed)
-            )
-        );
+        StringInfoData  param;
+
+        if (nulls[i])
+            continue;
+        initStringInfo(&param);
+        www_param_append(&param, template, www_param_value(elemtype, elems[i]));
+        params = list_append_unique(params, makeString(param.data));
     }
 
-    if(1 < SPI_processed)
+    return params;
+}
+
+/*
+ * www_param_fanout
+ *  fan out col = ANY(array)/col IN (...): each value is passed in separate request
+ *  (column without param_in template, request_concurrency > 0)
+ *  const array is rendered into info->fanout, array of parameters
+ *  (e.g. $1 of generic plan) is evaluated by executor (info->fanout_expr)
+ *  returns false if qual can't be fanned out
+ */
+static bool
+www_param_fanout(PlannerInfo *root, Node *node, WWWRelInfo *info, Index relid)
+{
+    ScalarArrayOpExpr   *op = (ScalarArrayOpExpr *) node;
+    WWW_fdw_options *opts = info->opts;
+    AttrNumber  attnum;
+    char        **templates;
+    Node        *array;
+
+    if (0 >= opts->concurrency || NULL == node || !IsA(node, ScalarArrayOpExpr)
+        || !op->useOr || 2 != list_length(op->args)
+        || 0 == (attnum = www_param_var(linitial(op->args), opts, relid))
+        || BTEqualStrategyNumber != www_param_strategy(op->opno))
+        return false;
+
+    templates = opts->columns[attnum - 1].templates;
+    if (NULL != templates[WWW_PARAM_IN] || NULL == templates[WWW_PARAM_EQ])
+        return false;
+
+    array = (Node *) lsecond(op->args);
+    if (IsA(array, Const))
     {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("More than 1 result was returned from request_serialize_callback '%s': %i", opts->request_serialize_callback, SPI_processed)
-            )
-        );
+        if (((Const *) array)->constisnull)
+            return false;
+        info->fanout = www_fanout_params(templates[WWW_PARAM_EQ], ((Const *) array)->constvalue);
+        info->nfanout = list_length(info->fanout);
+        return NIL != info->fanout;
     }
 
-    rurl = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
-    rpost = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &isnull);
+    /* value has to be known before the scan starts */
+    if (contain_var_clause(array) || contain_volatile_functions(array))
+        return false;
 
-    /* recreate data in correct memory context */
-    spimctxt = MemoryContextSwitchTo(mctxt);
+    info->fanout_expr = (Expr *) array;
+    info->fanout_template = templates[WWW_PARAM_EQ];
+#if PG_VERSION_NUM >= 170000
+    info->nfanout = estimate_array_length(root, array);
+#else
+    info->nfanout = estimate_array_length(array);
+#endif
+    return true;
+}
 
-    resetStringInfo(url);
-    appendStringInfoString(url, rurl);
+/*
+ * www_param_join
+ *  check join clause col = outer_expr, where column has param_eq template
+ *  and outer_expr doesn't reference scanned relation (value comes from outer rows)
+ *  returns outer_expr and sets column, NULL if clause can't be passed to the server
+ */
+static Expr *
+www_param_join(Node *node, WWW_fdw_options *opts, Index relid, AttrNumber *column)
+{
+    OpExpr      *op = (OpExpr *) node;
+    AttrNumber  attnum;
+    Node        *outer;
 
-    if(!isnull)
-    {
-        Datum datum;
+    if (node == NULL || !IsA(node, OpExpr) || 2 != list_length(op->args)
+        || BTEqualStrategyNumber != www_param_strategy(op->opno))
+        return NULL;
 
-        rpost_tuple_header = DatumGetHeapTupleHeader(rpost);
-        datum = GetAttributeByName(rpost_tuple_header, "post", &isnull);
-        if(isnull)
-            post->post = false;
-        else
-            post->post = DatumGetBool(datum);
+    if (0 != (attnum = www_param_var(linitial(op->args), opts, relid)))
+        outer = lsecond(op->args);
+    else if (0 != (attnum = www_param_var(lsecond(op->args), opts, relid)))
+        outer = linitial(op->args);
+    else
+        return NULL;
 
-        resetStringInfo(&post->data);
-        datum = GetAttributeByName(rpost_tuple_header, "data", &isnull);
-        if(!isnull)
-            appendStringInfoString(&post->data, TextDatumGetCString(datum));
+    *column = attnum;
+    if (NULL == opts->columns[attnum - 1].templates[WWW_PARAM_EQ]
+#if PG_VERSION_NUM >= 140000
+        || bms_is_member(relid, pull_varnos(NULL, outer))
+#else
+        || bms_is_member(relid, pull_varnos(outer))
+#endif
+        || contain_volatile_functions(outer))
+        return NULL;
 
-        datum = GetAttributeByName(rpost_tuple_header, "content_type", &isnull);
-        resetStringInfo(&post->content_type);
-        if(!isnull)
-            appendStringInfoString(&post->content_type, TextDatumGetCString(datum));
-    }
+    return (Expr *) outer;
+}
 
-    MemoryContextSwitchTo(spimctxt);
+/*
+ * www_ec_member_matches
+ *  callback of generate_implied_equalities_for_column:
+ *  equivalence class member is column with param_eq template
+ */
+static bool
+www_ec_member_matches(PlannerInfo *root, RelOptInfo *rel,
+                      EquivalenceClass *ec, EquivalenceMember *em, void *arg)
+{
+    WWW_fdw_options *opts = (WWW_fdw_options *) arg;
+    AttrNumber      attnum = www_param_var((Node *) em->em_expr, opts, rel->relid);
 
-    SPI_finish_wrapper();
+    return 0 != attnum && NULL != opts->columns[attnum - 1].templates[WWW_PARAM_EQ];
 }
 
 /*
- * serialize_request_parameters
- *  serialize column=value sql conditions into column=value get parameters
- *  column & value are url encoded
+ * www_limit
+ *  rows of the scan needed by LIMIT (plus OFFSET) of the query, 0 - all
+ *  LIMIT applies to rows of the scan only if it's the only relation of plain
+ *  SELECT (no grouping, aggregates, set returning functions)
+ *  and all quals are passed to the server as equalities (other quals are
+ *  rechecked locally, response_iterate_callback can filter rows out too)
  */
-static void
-serialize_request_parameters(ForeignScanState* node, StringInfoData *url)
+static double
+www_limit(PlannerInfo *root, RelOptInfo *baserel, WWWRelInfo *info)
 {
-    if (node->ss.ps.plan->qual)
-    {
-        bool        param_first = true;
-        char        char_first = '?', *ch;
-        ListCell   *lc;
-        List       *quals = list_copy(node->ss.ps.qual);
+    Query       *parse = root->parse;
+
+    if (0 >= root->limit_tuples
+        || NIL != info->local_conds || NIL != info->recheck_conds
+        || NULL != info->opts->response_iterate_callback
+        || CMD_SELECT != parse->commandType
+        || BMS_SINGLETON != bms_membership(root->all_baserels)
+        || NIL != parse->groupClause || NIL != parse->distinctClause
+        || parse->hasAggs || parse->hasWindowFuncs || NULL != parse->havingQual
+        || expression_returns_set((Node *) parse->targetList))
+        return 0;
+
+    return root->limit_tuples;
+}
 
-        /* check if we have '?' already in the url -
-         * append our parameters starting with '&', not '?' */
-        for(ch = url->data; *ch; ch++)
-            if('?' == *ch)
-            {
-                char_first    = '&';
-                break;
-            }
+/*
+ * www_path_limit
+ *  LIMIT of the query (see www_limit) for path of the scan with pathkeys:
+ *  rows of the query are sorted, so LIMIT applies to rows of the path
+ *  only if they come in the order of the query already
+ */
+static double
+www_path_limit(PlannerInfo *root, WWWRelInfo *info, List *pathkeys)
+{
+    if (NIL != root->parse->sortClause && !pathkeys_contained_in(root->query_pathkeys, pathkeys))
+        return 0;
+    return info->limit;
+}
 
-        foreach (lc, quals)
-        {
-            ExprState       *state = lfirst(lc);
+/*
+ * www_get_forein_rel_size
+ *     Obtain relation size estimates for a foreign table
+ *     server returns expected_rows rows without url parameters,
+ *     selectivity of quals passed as url parameters reduces it
+ */
+static void
+www_get_foreign_rel_size(PlannerInfo *root,
+                     RelOptInfo *baserel,
+                     Oid foreigntableid)
+{
+    WWWRelInfo  *info = (WWWRelInfo*)palloc0(sizeof(WWWRelInfo));
+    ListCell    *lc;
 
-            char *param = www_param((Node *) state->expr,
-                            node->ss.ss_currentRelation->rd_att);
+    info->opts = get_options(foreigntableid);
 
-            if (param)
-            {
-                if (param_first)
-                {
-                    appendStringInfoChar(url, char_first);
-                    param_first    = false;
-                }
-                else
-                    appendStringInfoChar(url, '&');
-                appendStringInfoString(url, param);
+    /* quals are passed to request_serialize_callback as a whole and checked locally */
+    foreach(lc, baserel->baserestrictinfo)
+    {
+        RestrictInfo    *ri = (RestrictInfo *) lfirst(lc);
 
-                /* take it from original qual */
-                node->ss.ps.qual = list_delete(node->ss.ps.qual, (void *) state);
-            }
-            else
-                ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR), errmsg("Unknown qual")));
+        if (info->opts->request_serialize_callback)
+            info->local_conds = lappend(info->local_conds, ri);
+        else if (www_param((Node *) ri->clause, info->opts, baserel->relid, NULL))
+        {
+            info->remote_conds = lappend(info->remote_conds, ri);
+            if (!www_param_exact((Node *) ri->clause))
+                info->recheck_conds = lappend(info->recheck_conds, ri);
         }
+        /* single IN list is fanned out, requests for values of several lists would multiply */
+        else if (0 == info->nfanout
+                 && www_param_fanout(root, (Node *) ri->clause, info, baserel->relid))
+            info->remote_conds = lappend(info->remote_conds, ri);
+        else
+            info->local_conds = lappend(info->local_conds, ri);
     }
+
+    info->fetched_rows = clamp_row_est(info->opts->rows *
+            clauselist_selectivity(root, info->remote_conds, baserel->relid, JOIN_INNER, NULL));
+    cost_qual_eval(&info->local_cost, list_concat(list_copy(info->local_conds), info->recheck_conds), root);
+    info->limit = www_limit(root, baserel, info);
+
+    baserel->tuples = info->opts->rows;
+    baserel->rows = clamp_row_est(info->fetched_rows *
+            clauselist_selectivity(root, info->local_conds, baserel->relid, JOIN_INNER, NULL));
+    baserel->fdw_private = info;
 }
 
 /*
- * xml_check_result_array
- *    Check current node to be of following structure:
- *    node
- *        subnode
- *            attr1 > cdata
- *            ...
- *            attrN > cdata
- *        ...
- *        subnode
- *            attr1 > cdata
- *            ...
- *            attrN > cdata
- *    Also node names are checked to match result columns.
- *    At least one name must match. Matching columns must have only one text node child.
- *    All subnodes must have same name.
-*/
-static
-bool
-xml_check_result_array(xmlNodePtr node, TupleDesc tuple_desc, xmlChar **attnames)
+ * www_path_costs
+ *  cost of a request fetching fetched_rows rows, local_cost - quals checked locally
+ */
+static void
+www_path_costs(WWWRelInfo *info, double fetched_rows, QualCost *local_cost,
+               Cost *startup_cost, Cost *total_cost)
 {
-    xmlNodePtr    it        = NULL,
-                itc        = NULL;
-    const xmlChar *name    = NULL;
-    int            i,n        = 0;
-    bool        match    = false;
+    Cost        fetch_cost  = fetched_rows * info->opts->row_cost;
+    Cost        run_cost    = fetched_rows * (cpu_tuple_cost + local_cost->per_tuple);
+    /* fanned out requests are made request_concurrency at a time */
+    double      rounds      = 0 == info->nfanout ? 1 :
+                              ceil(info->nfanout / info->opts->concurrency);
+
+    /* numbered pages after the first one are requested request_concurrency at a time */
+    if (0 == info->nfanout && info->opts->offset_paged && !info->opts->stream)
+    {
+        double      pages = Max(1, ceil(fetched_rows / info->opts->per_page));
 
-    if(NULL == node)
-        return    false;
+        if (0 < info->opts->max_pages)
+            pages = Min(pages, info->opts->max_pages);
+        rounds = 1 + ceil((pages - 1) / Max(1, info->opts->concurrency));
+    }
 
-    /* check all node children have same name */
-    for( it = node->children; NULL != it; it = it->next )
+    *startup_cost = rounds * info->opts->latency * WWW_COST_PER_MS + local_cost->startup;
+    if (info->opts->stream)
+        run_cost += fetch_cost;
+    else
+        *startup_cost += fetch_cost;
+    *total_cost = *startup_cost + run_cost;
+}
+
+/*
+ * www_lookup_costs
+ *  cost of parameterized path per outer row with request_lookup_fetch_all:
+ *  request_lookup_limit lookups, then whole response (all_total) once,
+ *  rows of the rest of outer rows are taken from its groups
+ */
+static void
+www_lookup_costs(PlannerInfo *root, WWWRelInfo *info, Relids required_outer,
+                 double fetched_rows, QualCost *local_cost, Cost all_total,
+                 Cost *startup_cost, Cost *total_cost)
+{
+    double      loops = 1;
+    double      lookups = info->opts->lookup_limit;
+    int         relid;
+
+    /* outer rows: product of rows of outer relations */
+    for (relid = 1; relid < root->simple_rel_array_size; relid++)
+        if (root->simple_rel_array[relid] && bms_is_member(relid, required_outer))
+            loops *= root->simple_rel_array[relid]->rows;
+    loops = clamp_row_est(loops);
+    if (loops <= lookups)
+        return;
+
+    *total_cost = (lookups * *total_cost + all_total
+                   + (loops - lookups) * fetched_rows * (cpu_tuple_cost + local_cost->per_tuple)) / loops;
+    *startup_cost = Min(*startup_cost, *total_cost);
+}
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * www_pathkey_column
+ *  column of the scanned relation sorted by pathkey, 0 - none
+ *  only default btree order of column type (nulls last in ascending order,
+ *  first in descending one) in collation of the column is expected from the server
+ */
+static AttrNumber
+www_pathkey_column(PathKey *pathkey, RelOptInfo *baserel, WWW_fdw_options *opts, bool *desc)
+{
+    EquivalenceClass    *ec = pathkey->pk_eclass;
+    ListCell    *lc;
+
+    *desc = BTGreaterStrategyNumber == pathkey->pk_strategy;
+    if (ec->ec_has_volatile || *desc != pathkey->pk_nulls_first)
+        return 0;
+
+    foreach(lc, ec->ec_members)
     {
-        switch(it->type)
-        {
-            case XML_ELEMENT_NODE:
-                if(NULL == name)
-                    name    = it->name;
-                else
-                    /* check name of node to be the same */
-                    if(1 != xmlStrEqual(name, it->name))
-                        return    false;
+        EquivalenceMember   *em = (EquivalenceMember *) lfirst(lc);
+        AttrNumber          attnum;
+        Node                *expr;
 
-                /* check children */
-                n    = 0;
-                for( itc = it->children; NULL != itc; itc = itc->next )
-                {
-                    /* check sub elements names to match result columns */
-                    for (i = 0; i < tuple_desc->natts; i++)
-                    {
-                        if(1 == xmlStrEqual(attnames[i], itc->name))
-                        {
-                            /* don't check found value to be of ordinary type here - we can serialize it in the answer */
+        if (!bms_equal(em->em_relids, baserel->relids)
+            || 0 == (attnum = www_param_var((Node *) em->em_expr, opts, baserel->relid)))
+            continue;
 
-                            /* TODO: check if we need such check:
-                             * we need to have only single XML_TEXT_NODE among children
-                            if(itc->children)
-                            {
+        if (pathkey->pk_opfamily != get_opclass_family(GetDefaultOpClass(
+                exprType((Node *) em->em_expr), BTREE_AM_OID)))
+            return 0;
+
+        /* server sorts in collation of the column, not in one of COLLATE clause */
+        expr = (Node *) em->em_expr;
+        while (IsA(expr, RelabelType))
+            expr = (Node *) ((RelabelType *) expr)->arg;
+        if (ec->ec_collation != exprCollation(expr))
+            return 0;
+        return attnum;
+    }
 
-                                if(XML_TEXT_NODE != itc->children->type)
-                                    return    false;
+    return 0;
+}
 
-                                if(itc->children->next)
-                                    return    false;
-                            }
-                            */
+/*
+ * www_pathkeys_remote
+ *  check that rows of the scan can come sorted by pathkeys:
+ *  pathkeys are a prefix of response_order or columns of all of them have
+ *  param_sort_asc/param_sort_desc templates, which are rendered into params then
+ */
+static bool
+www_pathkeys_remote(RelOptInfo *baserel, WWWRelInfo *info, List *pathkeys, StringInfo params)
+{
+    WWW_fdw_options *opts = info->opts;
+    ListCell    *lc;
+    bool        declared = list_length(pathkeys) <= opts->norder,
+                pushed = NULL == opts->request_serialize_callback;
+    int         i = 0;
 
-                            n++;
-                            break;
-                        }
-                    }
-                }
+    resetStringInfo(params);
+    foreach(lc, pathkeys)
+    {
+        bool        desc;
+        AttrNumber  attnum = www_pathkey_column((PathKey *) lfirst(lc), baserel, opts, &desc);
 
-                /* none of the children match result columns */
-                if(0 == n)
-                    return    false;
-                else
-                    match    = true;
-                break;
-            case XML_COMMENT_NODE:
-                continue;
-            case XML_ATTRIBUTE_NODE:
-            case XML_TEXT_NODE:
-            case XML_CDATA_SECTION_NODE:
-            case XML_ENTITY_REF_NODE:
-            case XML_ENTITY_NODE:
-            case XML_PI_NODE:
-            case XML_DOCUMENT_NODE:
-            case XML_DOCUMENT_TYPE_NODE:
-            case XML_DOCUMENT_FRAG_NODE:
-            case XML_NOTATION_NODE:
-            case XML_HTML_DOCUMENT_NODE:
-            case XML_DTD_NODE:
-            case XML_ELEMENT_DECL:
-            case XML_ATTRIBUTE_DECL:
-            case XML_ENTITY_DECL:
-            case XML_NAMESPACE_DECL:
-            case XML_XINCLUDE_START:
-            case XML_XINCLUDE_END:
-            case XML_DOCB_DOCUMENT_NODE:
-                return    false;
-        }
+        if (0 == attnum)
+            return false;
+
+        declared = declared && attnum == opts->order[i].attnum && desc == opts->order[i].desc;
+        pushed = pushed && www_param_append(params,
+                opts->columns[attnum - 1].templates[desc ? WWW_PARAM_SORT_DESC : WWW_PARAM_SORT_ASC], NULL);
+        i++;
     }
 
-    return    match;
+    if (declared)
+        resetStringInfo(params);
+    return declared || pushed;
 }
 
 /*
- * xml_get_result_array_in_doc
- *    search for a result in parsed xml
-*/
-static
-xmlNodePtr
-xml_get_result_array_in_doc(xmlDocPtr doc, TupleDesc tuple_desc)
+ * www_add_sorted_paths
+ *  add paths of the full scan with rows sorted by the server
+ *  for ORDER BY of the query and for merge joins
+ *  response_order gives them for free, param_sort_* templates cost a bit
+ *  more (server sorts rows)
+ */
+static void
+www_add_sorted_paths(PlannerInfo *root, RelOptInfo *baserel, WWWRelInfo *info)
 {
-    xmlNodePtr    suspect    = NULL,
-                it        = NULL;
-    List        *curr    = NULL,
-                *next    = NULL;
-    ListCell*    cell;
-    xmlChar**    attnames;
-    int            i;
+    WWW_fdw_options *opts = info->opts;
+    List        *useful = NIL;
+    ListCell    *lc;
+    StringInfoData  params;
 
-    if(NULL == doc)
-        return    NULL;
+    /* rows of several responses are concatenated as they come */
+    if (0 < info->nfanout || (opts->offset_paged && !opts->ordered && !opts->paged))
+        return;
 
-    /* fill all document nodes as current list for check */
-    for( it = doc->children; NULL != it; it = it->next )
+    if (NIL != root->query_pathkeys)
+        useful = lappend(useful, root->query_pathkeys);
+
+    /* single key pathkeys of merge joins */
+    foreach(lc, root->eq_classes)
     {
-        if(XML_ELEMENT_NODE != it->type)
+        EquivalenceClass    *ec = (EquivalenceClass *) lfirst(lc);
+        PathKey     *pathkey;
+        bool        desc;
+        List        *pathkeys;
+
+        if (ec->ec_has_volatile || !eclass_useful_for_merging(root, ec, baserel))
             continue;
-        curr    = lappend( curr, (void*)(it) );
+
+        pathkey = make_canonical_pathkey(root, ec, linitial_oid(ec->ec_opfamilies),
+                                         BTLessStrategyNumber, false);
+        /* descending response_order is useful as well */
+        if (0 < opts->norder && opts->order[0].desc
+            && opts->order[0].attnum == www_pathkey_column(pathkey, baserel, opts, &desc))
+            pathkey = make_canonical_pathkey(root, ec, linitial_oid(ec->ec_opfamilies),
+                                             BTGreaterStrategyNumber, true);
+
+        pathkeys = list_make1(pathkey);
+        if (!list_member(useful, pathkeys))
+            useful = lappend(useful, pathkeys);
     }
 
-    /* prepare attnames in xmlChar*, to save time for strings comparisons in xml_check_result_array */
-    attnames    = (xmlChar**)palloc(tuple_desc->natts * sizeof(xmlChar*));
-    for( i=0; i<tuple_desc->natts; i++ )
-        attnames[i]    = xmlCharStrndup(tuple_desc->attrs[i]->attname.data, strlen(tuple_desc->attrs[i]->attname.data));
+    initStringInfo(&params);
+    foreach(lc, useful)
+    {
+        List        *pathkeys = (List *) lfirst(lc);
+        double      limit = www_path_limit(root, info, pathkeys);
+        Cost        startup_cost;
+        Cost        total_cost;
 
-    while(curr) {
-        foreach(cell, curr)
+        if (!www_pathkeys_remote(baserel, info, pathkeys, &params))
+            continue;
+
+        www_path_costs(info, 0 < limit ? Min(info->fetched_rows, limit) : info->fetched_rows,
+                       &info->local_cost, &startup_cost, &total_cost);
+        if (0 < params.len)
         {
-            suspect    = (xmlNodePtr)(cell->data.ptr_value);
-            switch (suspect->type)
+            startup_cost *= WWW_SORT_COST_MULTIPLIER;
+            total_cost *= WWW_SORT_COST_MULTIPLIER;
+        }
+
+        add_path(baserel, (Path *)
+                create_foreignscan_path(root, baserel,
+                                        NULL, /* PathTarget */
+                                        baserel->rows,
+                                        startup_cost,
+                                        total_cost,
+                                        pathkeys,
+                                        NULL,
+                                        NULL,
+                                        0 < params.len ? list_make1(makeString(pstrdup(params.data))) : NIL));
+    }
+}
+#endif
+
+/*
+ * www_get_foreign_paths
+ *        Create possible access paths for a scan on the foreign table
+ *
+ *        Request round-trip (request_latency) is paid before the first row,
+ *        each fetched row costs response_row_cost plus local quals.
+ *        Without streaming the whole response is fetched before the first row
+ *        too, so it goes to startup cost as well.
+ *
+ *        Join clauses col = outer value (col with param_eq template) give
+ *        parameterized paths: request is made for each outer row with its value
+ *        in url, so nested loop does targeted lookups instead of full download.
+ */
+static void
+www_get_foreign_paths(PlannerInfo *root,
+                    RelOptInfo *baserel,
+                    Oid foreigntableid)
+{
+    WWWRelInfo  *info = (WWWRelInfo *) baserel->fdw_private;
+    Cost        startup_cost;
+    Cost        total_cost;
+    Cost        all_total;
+    List        *join_conds = NIL;
+    List        *outer_sets = NIL;
+    ListCell    *lc;
+    double      limit;
+
+    /* whole response of request_lookup_fetch_all */
+    www_path_costs(info, info->fetched_rows, &info->local_cost, &startup_cost, &all_total);
+
+    /* transfer stops after rows needed by LIMIT */
+    limit = www_path_limit(root, info, NIL);
+    www_path_costs(info, 0 < limit ? Min(info->fetched_rows, limit) : info->fetched_rows,
+                   &info->local_cost, &startup_cost, &total_cost);
+
+    /* Create a ForeignPath node for the full scan */
+    add_path(baserel, (Path *)
+            create_foreignscan_path(root, baserel,
+#if PG_VERSION_NUM >= 90600
+                                     NULL, /* PathTarget */
+#endif
+                                     baserel->rows,
+                                     startup_cost,
+                                     total_cost,
+                                     NIL, /* no pathkeys */
+                                     NULL, /* no outer rel either */
+                                     NULL
+#if PG_VERSION_NUM >= 90500
+,
+/*
+* Require PostgreSQL >= 9.5
+*/
+                     NIL /* no fdw_private list */
+#endif
+                                     )); /* no fdw_private data */
+
+#if PG_VERSION_NUM >= 90600
+    www_add_sorted_paths(root, baserel, info);
+#endif
+
+    /* request_serialize_callback gets quals of the table only */
+    if (info->opts->request_serialize_callback)
+        return;
+
+    /* join clauses, which can be passed as url parameters */
+    foreach(lc, baserel->joininfo)
+    {
+        RestrictInfo    *ri = (RestrictInfo *) lfirst(lc);
+        AttrNumber      attnum;
+
+        if (join_clause_is_movable_to(ri, baserel)
+            && www_param_join((Node *) ri->clause, info->opts, baserel->relid, &attnum))
+            join_conds = lappend(join_conds, ri);
+    }
+    if (baserel->has_eclass_joins)
+    {
+        foreach(lc, generate_implied_equalities_for_column(root, baserel,
+                                                           www_ec_member_matches, info->opts,
+                                                           baserel->lateral_referencers))
+        {
+            RestrictInfo    *ri = (RestrictInfo *) lfirst(lc);
+
+            if (join_clause_is_movable_to(ri, baserel))
+                join_conds = lappend(join_conds, ri);
+        }
+    }
+
+    /* one path per set of outer relations */
+    foreach(lc, join_conds)
+    {
+        RestrictInfo    *ri = (RestrictInfo *) lfirst(lc);
+        Relids          required_outer;
+        ParamPathInfo   *ppi;
+        List            *remote = NIL,
+                        *local = list_concat(list_copy(info->local_conds), list_copy(info->recheck_conds));
+        QualCost        local_cost;
+        double          fetched_rows;
+        ListCell        *lc2;
+        bool            found = false;
+
+        required_outer = bms_union(ri->clause_relids, baserel->lateral_relids);
+        required_outer = bms_del_member(required_outer, baserel->relid);
+        if (bms_is_empty(required_outer))
+            continue;
+
+        foreach(lc2, outer_sets)
+            found = found || bms_equal(required_outer, (Relids) lfirst(lc2));
+        if (found)
+            continue;
+        outer_sets = lappend(outer_sets, required_outer);
+
+        ppi = get_baserel_parampathinfo(root, baserel, required_outer);
+        foreach(lc2, ppi->ppi_clauses)
+        {
+            RestrictInfo    *clause = (RestrictInfo *) lfirst(lc2);
+            AttrNumber      attnum;
+
+            if (www_param_join((Node *) clause->clause, info->opts, baserel->relid, &attnum))
             {
-                case XML_ELEMENT_NODE:
-                    /* check node to be valid answer */
-                    if(xml_check_result_array(suspect, tuple_desc, attnames))
-                    {
-                        /* free structures */
-                        list_free(curr);
-                        list_free(next);
-                        for( i=0; i<tuple_desc->natts; i++ )
-                            free(attnames[i]);
-                        return    suspect;
-                    }
-                    for( it = suspect->children; NULL != it; it = it->next )
-                    {
-                        if(XML_ELEMENT_NODE != it->type)
-                            continue;
-                        next    = lappend( next, (void*)(it) );
-                    }
-                    break;
-                default:
-                    break;
+                remote = lappend(remote, clause);
+                /* rows grouped from whole response are compared locally too */
+                if (info->opts->fetch_all)
+                    local = lappend(local, clause);
             }
+            else
+                local = lappend(local, clause);
+        }
+
+        fetched_rows = clamp_row_est(info->fetched_rows *
+                clauselist_selectivity(root, remote, baserel->relid, JOIN_INNER, NULL));
+        cost_qual_eval(&local_cost, local, root);
+        www_path_costs(info, fetched_rows, &local_cost, &startup_cost, &total_cost);
+        if (info->opts->fetch_all)
+            www_lookup_costs(root, info, required_outer, fetched_rows, &local_cost, all_total,
+                             &startup_cost, &total_cost);
+
+        add_path(baserel, (Path *)
+                create_foreignscan_path(root, baserel,
+#if PG_VERSION_NUM >= 90600
+                                         NULL, /* PathTarget */
+#endif
+                                         ppi->ppi_rows,
+                                         startup_cost,
+                                         total_cost,
+                                         NIL, /* no pathkeys */
+                                         required_outer,
+                                         NULL
+#if PG_VERSION_NUM >= 90500
+                                         ,NIL /* no fdw_private list */
+#endif
+                                         ));
+    }
+}
+
+/*
+ * www_unused_columns
+ *  columns, which values aren't needed by the query: not used in target list
+ *  and in quals (checked locally or rechecked by EvalPlanQual)
+ *  names of needed columns are appended to params with param_fields template
+ *  all columns are needed by whole row references and response_iterate_callback
+ *  if lazy, columns used by target list only are returned in deferred:
+ *  they're decoded for rows passing local quals only
+ */
+static List *
+www_unused_columns(RelOptInfo *baserel, WWWRelInfo *info, List *local_exprs, List *remote_exprs,
+                   bool lazy, List **deferred, StringInfo params)
+{
+    WWW_fdw_options *opts = info->opts;
+    Bitmapset   *attrs_used = NULL,
+                *quals_used = NULL;
+    List        *unused = NIL;
+    StringInfoData  fields;
+    AttrNumber  attnum;
+
+    *deferred = NIL;
+    if (opts->response_iterate_callback)
+        return NIL;
+
+    pull_varattnos((Node *) local_exprs, baserel->relid, &quals_used);
+    pull_varattnos((Node *) remote_exprs, baserel->relid, &quals_used);
+    attrs_used = bms_copy(quals_used);
+#if PG_VERSION_NUM >= 90600
+    pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &attrs_used);
+#else
+    pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &attrs_used);
+#endif
+
+    if (bms_is_member(0 - FirstLowInvalidHeapAttributeNumber, attrs_used))
+        return NIL;
+
+    for (attnum = 1; lazy && attnum <= opts->ncolumns; attnum++)
+        if (bms_is_member(attnum - FirstLowInvalidHeapAttributeNumber, attrs_used)
+            && !bms_is_member(attnum - FirstLowInvalidHeapAttributeNumber, quals_used))
+            *deferred = lappend_int(*deferred, attnum);
+
+    initStringInfo(&fields);
+    for (attnum = 1; attnum <= opts->ncolumns; attnum++)
+    {
+        if (NULL == opts->columns[attnum - 1].name)
+            continue;
+        if (!bms_is_member(attnum - FirstLowInvalidHeapAttributeNumber, attrs_used))
+            unused = lappend_int(unused, attnum);
+        else
+            appendStringInfo(&fields, "%s%s", 0 < fields.len ? "," : "", opts->columns[attnum - 1].name);
+    }
+
+    /* some key is needed to find rows in response (count(*) etc) */
+    for (attnum = 1; 0 == fields.len && attnum <= opts->ncolumns; attnum++)
+        if (opts->columns[attnum - 1].name)
+            appendStringInfoString(&fields, opts->columns[attnum - 1].name);
+
+    if (NIL != unused && opts->param_fields)
+        www_param_append(params, opts->param_fields, fields.data);
+
+    return unused;
+}
+
+/*
+ * www_get_foreign_plan
+ *        Create a ForeignScan plan node for scanning the foreign table
+ */
+static ForeignScan *
+www_get_foreign_plan(PlannerInfo *root,
+                   RelOptInfo *baserel,
+                   Oid foreigntableid,
+                   ForeignPath *best_path,
+                   List *tlist,
+                   List *scan_clauses
+#if PG_VERSION_NUM >= 90500
+,
+/*
+* Require PostgreSQL >= 9.5
+*/
+                    Plan *outer_plan
+#endif
+        )
+{
+    Index        scan_relid = baserel->relid;
+    WWWRelInfo  *info = (WWWRelInfo *) baserel->fdw_private;
+    ParamPathInfo   *ppi = best_path->path.param_info;
+    List        *local_exprs = NIL,
+                *remote_exprs = NIL,
+                *param_exprs = NIL,
+                *param_templates = NIL,
+                *param_columns = NIL;
+    ListCell    *lc;
+    StringInfoData  params;
+    long        limit = 0;
+    List        *unused,
+                *deferred;
+    bool        lazy;
+
+    /*
+     * Quals classified as remote by www_get_foreign_rel_size are passed
+     * to the server as url parameters, the rest is checked by executor
+     * (remote quals other than equality are rechecked by it too).
+     * Join clauses of parameterized path give url parameters too,
+     * their outer values are evaluated by executor (fdw_exprs).
+     * Pseudoconstants are handled elsewhere.
+     */
+    foreach(lc, scan_clauses)
+    {
+        RestrictInfo    *ri = (RestrictInfo *) lfirst(lc);
+        Expr            *outer;
+        AttrNumber      attnum;
+
+        Assert(IsA(ri, RestrictInfo));
+
+        if (ri->pseudoconstant)
+            continue;
+
+        if (list_member_ptr(info->remote_conds, ri))
+        {
+            remote_exprs = lappend(remote_exprs, ri->clause);
+            if (list_member_ptr(info->recheck_conds, ri))
+                local_exprs = lappend(local_exprs, ri->clause);
+        }
+        else if (ppi && list_member_ptr(ppi->ppi_clauses, ri)
+                 && NULL != (outer = www_param_join((Node *) ri->clause, info->opts, scan_relid, &attnum)))
+        {
+            remote_exprs = lappend(remote_exprs, ri->clause);
+            param_exprs = lappend(param_exprs, outer);
+            param_templates = lappend(param_templates,
+                    makeString(info->opts->columns[attnum - 1].templates[WWW_PARAM_EQ]));
+            param_columns = lappend_int(param_columns, attnum);
+            /* rows grouped by www_param_group are matched by rendered text only */
+            if (info->opts->fetch_all)
+                local_exprs = lappend(local_exprs, ri->clause);
+        }
+        else
+            local_exprs = lappend(local_exprs, ri->clause);
+    }
+
+    /* url parameters are rendered once here, executor only appends them */
+    initStringInfo(&params);
+    foreach(lc, remote_exprs)
+        www_param((Node *) lfirst(lc), info->opts, scan_relid, &params);
+
+    /* fan-out array of parameters is evaluated by executor, after outer values */
+    if (info->fanout_expr)
+        param_exprs = lappend(param_exprs, info->fanout_expr);
+
+    /* url parameters of ORDER BY (see www_add_sorted_paths) */
+    if (NIL != best_path->fdw_private)
+        www_param_append(&params, strVal(linitial(best_path->fdw_private)), NULL);
+
+    /* parameterized scan is a part of join, LIMIT isn't applied to its rows */
+    if (NULL == ppi && 0 < www_path_limit(root, info, best_path->path.pathkeys))
+    {
+        limit = (long) www_path_limit(root, info, best_path->path.pathkeys);
+        if (info->opts->param_limit)
+        {
+            char    value[32];
+
+            snprintf(value, sizeof(value), "%ld", limit);
+            www_param_append(&params, info->opts->param_limit, value);
+        }
+    }
+
+    /*
+     * Columns needed by target list only are decoded after local quals
+     * (they're checked by www_iterate then), so rows filtered out
+     * don't pay for conversion of such columns.
+     * Decoder keeps raw tokens for json responses only,
+     * serialize callback gets quals from the plan node.
+     */
+    lazy = NULL == ppi && NIL != local_exprs
+           && WWW_RESPONSE_JSON == info->opts->response_format
+           && NULL == info->opts->response_deserialize_callback
+           && NULL == info->opts->request_serialize_callback;
+    unused = www_unused_columns(baserel, info, local_exprs, remote_exprs, lazy, &deferred, &params);
+    if (NIL != deferred)
+    {
+        param_exprs = list_concat(param_exprs, list_copy(local_exprs));
+        remote_exprs = list_concat(remote_exprs, local_exprs);
+        local_exprs = NIL;
+    }
+
+    /* Create the ForeignScan node */
+    return make_foreignscan(tlist
+                            ,local_exprs
+                            ,scan_relid
+                            ,param_exprs
+                            ,list_concat(list_make4(makeString(params.data), param_templates, param_columns, info->fanout),
+                                         list_make4(makeInteger(limit), unused, deferred,
+                                                    makeString(info->fanout_expr ? info->fanout_template : "")))
+#if (PG_VERSION_NUM >= 90500)
+                            ,NIL /* no scan_tlist either */
+                            ,remote_exprs   /* rechecked by EvalPlanQual */
+                            ,outer_plan
+#endif
+    );
+}
+
+/*
+ * www_explain
+ *   Produce extra output for EXPLAIN
+ */
+static void
+www_explain(ForeignScanState *node, ExplainState *es)
+{
+    WWWScanState    *scan = (WWWScanState *) node->fdw_state;
+    Reply       *reply = scan ? scan->reply : NULL;
+
+    d("www_explain routine");
+
+    ExplainPropertyText("WWW API", "Request", es);
+
+    /* local quals of lazy decoding are checked by the scan, not by the plan node */
+    if (NIL != (List *) list_nth(((ForeignScan *) node->ss.ps.plan)->fdw_private, WWWScanPrivateDeferred))
+    {
+        ForeignScan *plan = (ForeignScan *) node->ss.ps.plan;
+        int         nparams = list_length((List *) list_nth(plan->fdw_private, WWWScanPrivateParamTemplates));
+        List        *filter = list_copy_tail(plan->fdw_exprs, nparams);
+        List        *context;
+
+#if PG_VERSION_NUM >= 130000
+        context = set_deparse_context_plan(es->deparse_cxt, (Plan *) plan, NIL);
+#else
+        context = set_deparse_context_planstate(es->deparse_cxt, (Node *) node, NIL);
+#endif
+        ExplainPropertyText("Filter",
+                            deparse_expression((Node *) make_ands_explicit(filter), context,
+                                               list_length(es->rtable) > 1 || es->verbose, false),
+                            es);
+    }
+
+    if (es->verbose)
+    {
+        ForeignScan *plan = (ForeignScan *) node->ss.ps.plan;
+        StringInfoData  params;
+        ListCell    *lc;
+
+        /* templates of parameterized scan are shown as is, with %s for outer values */
+        initStringInfo(&params);
+        appendStringInfoString(&params, strVal(list_nth(plan->fdw_private, WWWScanPrivateUrlParams)));
+        foreach(lc, (List *) list_nth(plan->fdw_private, WWWScanPrivateParamTemplates))
+            www_param_append(&params, strVal(lfirst(lc)), NULL);
+
+        ExplainPropertyText("Remote Parameters", params.data, es);
+
+        /* one request per fan-out parameter */
+        resetStringInfo(&params);
+        foreach(lc, (List *) list_nth(plan->fdw_private, WWWScanPrivateFanout))
+            appendStringInfo(&params, "%s%s", 0 < params.len ? ", " : "", strVal(lfirst(lc)));
+        /* values of array evaluated by executor */
+        appendStringInfoString(&params, strVal(list_nth(plan->fdw_private, WWWScanPrivateFanoutTemplate)));
+        if (0 < params.len)
+            ExplainPropertyText("Remote Fan-out", params.data, es);
+
+        /* transfer is stopped after these rows */
+        if (0 < intVal(list_nth(plan->fdw_private, WWWScanPrivateLimit)))
+#if PG_VERSION_NUM >= 110000
+            ExplainPropertyInteger("Remote Limit", NULL, intVal(list_nth(plan->fdw_private, WWWScanPrivateLimit)), es);
+#else
+            ExplainPropertyLong("Remote Limit", intVal(list_nth(plan->fdw_private, WWWScanPrivateLimit)), es);
+#endif
+    }
+
+    if (es->analyze && reply)
+    {
+        ExplainPropertyText("Connection", reply->connection_reused ? "reused" : "new", es);
+        /* rows over work_mem went to temp files */
+        if (reply->store)
+            ExplainPropertyText("Reply Storage", tuplestore_in_memory(reply->store) ? "Memory" : "Disk", es);
+#if PG_VERSION_NUM >= 110000
+        ExplainPropertyInteger("Connections Created", NULL, www_connection_stats.created, es);
+        ExplainPropertyInteger("Connections Reused", NULL, www_connection_stats.reused, es);
+#else
+        ExplainPropertyLong("Connections Created", www_connection_stats.created, es);
+        ExplainPropertyLong("Connections Reused", www_connection_stats.reused, es);
+#endif
+    }
+}
+
+/*
+ * describe_spi_code
+ * return string description for spi function return code
+ */
+static
+char*
+describe_spi_code(int code)
+{
+    switch(code)
+    {
+        case SPI_ERROR_CONNECT:        return "ERROR CONNECT";
+        case SPI_ERROR_COPY:            return "ERROR COPY";
+        case SPI_ERROR_OPUNKNOWN:    return "ERROR OPUNKNOWN";
+        case SPI_ERROR_UNCONNECTED:    return "ERROR UNCONNECTED";
+        case SPI_ERROR_CURSOR:        return "ERROR CURSOR";
+        case SPI_ERROR_ARGUMENT:        return "ERROR ARGUMENT";
+        case SPI_ERROR_PARAM:        return "ERROR PARAM";
+        case SPI_ERROR_TRANSACTION:    return "ERROR TRANSACTION";
+        case SPI_ERROR_NOATTRIBUTE:    return "ERROR NOATTRIBUTE";
+        case SPI_ERROR_NOOUTFUNC:    return "ERROR NOOUTFUNC";
+        case SPI_ERROR_TYPUNKNOWN:    return "ERROR TYPUNKNOWN";
+
+        case SPI_OK_CONNECT:            return "OK CONNECT";
+        case SPI_OK_FINISH:            return "OK FINISH";
+        case SPI_OK_FETCH:            return "OK FETCH";
+        case SPI_OK_UTILITY:            return "OK UTILITY";
+        case SPI_OK_SELECT:            return "OK SELECT";
+        case SPI_OK_SELINTO:            return "OK SELINTO";
+        case SPI_OK_INSERT:            return "OK INSERT";
+        case SPI_OK_DELETE:            return "OK DELETE";
+        case SPI_OK_UPDATE:            return "OK UPDATE";
+        case SPI_OK_CURSOR:            return "OK CURSOR";
+        case SPI_OK_INSERT_RETURNING: return "OK INSERT_RETURNING";
+        case SPI_OK_DELETE_RETURNING: return "OK DELETE_RETURNING";
+        case SPI_OK_UPDATE_RETURNING: return "OK UPDATE_RETURNING";
+        case SPI_OK_REWRITTEN:        return "OK REWRITTEN";
+
+        default:
+            return    "undefined code";
+    }
+
+    return    "undefined code";
+}
+
+/*
+ * serialize_request_parameters_with_callback
+ * serialize request parameters using specified callback
+ * currently following serialize of quals are supported:
+ *  * null (pass as it as null no matter on quals)
+ *  * log (same as with debug_print_parse)
+ *  * empty string otherwise (plus issue warning)
+ *  * json (pass as it as null no matter on quals)
+ *  * xml (pass as it as null no matter on quals)
+ * there is not finished branch for tree serialization into json/xml
+ * but it started taking too much time and postponed for next versions (if any)
+ */
+static
+void
+serialize_request_with_callback(WWW_fdw_options *opts, Oid opts_type, Datum opts_value, ForeignScanState *node, StringInfoData *url, PostParameters *post)
+{
+    int    res;
+    StringInfoData    qualSer;
+    Oid    argtypes[4];
+    Datum argvalues[4], rpost;
+    char nulls[4];
+    char *rurl = NULL;
+    HeapTupleHeader rpost_tuple_header;
+    bool isnull;
+    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
+
+    argtypes[0] = opts_type;
+    argvalues[0] = opts_value;
+    nulls[0] = ' ';
+
+    if(0 == strcmp("log", opts->request_serialize_type))
+    {
+        initStringInfo(&qualSer);
+        appendStringInfoString( &qualSer, nodeToString(node->ss.ps.plan->qual) );
+        nulls[1] = ' ';
+    }
+    else if(0 == strcmp("null", opts->request_serialize_type))
+    {
+        nulls[1] = 'n';
+    }
+    else if(0 == strcmp("json", opts->request_serialize_type))
+    {
+        initStringInfo(&qualSer);
+        appendStringInfoString( &qualSer, serialize_quals(
+                                    (0 == strcmp("0",opts->request_serialize_human_readable) ? 0 : 1),
+                                    node->ss.ps.plan->qual,
+                                    serialize_node_with_children_callback_json,
+                                    serialize_node_without_children_callback_json,
+                                    serialize_list_separator_callback_json) );
+        nulls[1] = ' ';
+    }
+    else if(0 == strcmp("xml", opts->request_serialize_type))
+    {
+        initStringInfo(&qualSer);
+        appendStringInfoString( &qualSer, serialize_quals(
+                                    (0 == strcmp("0",opts->request_serialize_human_readable) ? 0 : 1),
+                                    node->ss.ps.plan->qual,
+                                    serialize_node_with_children_callback_xml,
+                                    serialize_node_without_children_callback_xml,
+                                    serialize_list_separator_callback_xml) );
+        nulls[1] = ' ';
+    }
+    else
+    {
+        /* set empty string and issue warning */
+        initStringInfo(&qualSer);
+
+        ereport(WARNING,
+            (
+                errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+                errmsg("Invalid request_serialize_type: %s", opts->request_serialize_type)
+            )
+        );
+
+        nulls[1] = ' ';
+    }
+    argtypes[1] = TEXTOID;
+    argvalues[1] = 'n' == nulls[1] ? PointerGetDatum(NULL) : make_text_data(&qualSer);
+
+    argtypes[2] = TEXTOID;
+    argvalues[2] = make_text_data(url);
+    nulls[2] = ' ';
+
+    get_www_fdw_post_parameters(opts, post, &(argtypes[3]), &(argvalues[3]));
+    nulls[3] = argvalues[3] ? ' ' : 'n';
+
+    SPI_connect_wrapper();
+    res    = SPI_execute_plan(www_spi_plan(opts->request_serialize_callback, 4, argtypes), argvalues, nulls, true, 0);
+
+    if(0 > res)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("Can't spi execute: %i (%s)", res, describe_spi_code(res))
+            )
+        );
+    }
+
+    if(0 == SPI_processed)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("No results were returned from request_serialize_callback '%s': %i", opts->request_serialize_callback, SPI_processed)
+            )
+        );
+    }
+
+    if(1 < SPI_processed)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("More than 1 result was returned from request_serialize_callback '%s': %i", opts->request_serialize_callback, SPI_processed)
+            )
+        );
+    }
+
+    rurl = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+    rpost = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &isnull);
+
+    /* recreate data in correct memory context */
+    spimctxt = MemoryContextSwitchTo(mctxt);
+
+    resetStringInfo(url);
+    appendStringInfoString(url, rurl);
+
+    if(!isnull)
+    {
+        Datum datum;
+
+        rpost_tuple_header = DatumGetHeapTupleHeader(rpost);
+        datum = GetAttributeByName(rpost_tuple_header, "post", &isnull);
+        if(isnull)
+            post->post = false;
+        else
+            post->post = DatumGetBool(datum);
+
+        resetStringInfo(&post->data);
+        datum = GetAttributeByName(rpost_tuple_header, "data", &isnull);
+        if(!isnull)
+            appendStringInfoString(&post->data, TextDatumGetCString(datum));
+
+        datum = GetAttributeByName(rpost_tuple_header, "content_type", &isnull);
+        resetStringInfo(&post->content_type);
+        if(!isnull)
+            appendStringInfoString(&post->content_type, TextDatumGetCString(datum));
+    }
+
+    MemoryContextSwitchTo(spimctxt);
+
+    SPI_finish_wrapper();
+}
+
+/*
+ * serialize_request_parameters
+ *  append url parameters for remote quals, rendered by www_get_foreign_plan
+ *  (column=value get parameters, column & value are url encoded)
+ *  and parameters for outer values of parameterized scan (join_params, NULL - none)
+ */
+static void
+serialize_request_parameters(ForeignScanState* node, StringInfoData *url, const char *join_params)
+{
+    ForeignScan *plan = (ForeignScan *) node->ss.ps.plan;
+    char        *params = strVal(list_nth(plan->fdw_private, WWWScanPrivateUrlParams));
+    /* check if we have '?' already in the url -
+     * append our parameters starting with '&', not '?' */
+    char        separator = strchr(url->data, '?') ? '&' : '?';
+
+    if (*params)
+    {
+        appendStringInfoChar(url, separator);
+        appendStringInfoString(url, params);
+        separator = '&';
+    }
+    if (join_params && *join_params)
+    {
+        appendStringInfoChar(url, separator);
+        appendStringInfoString(url, join_params);
+    }
+}
+
+/*
+ * xml_check_result_array
+ *    Check current node to be of following structure:
+ *    node
+ *        subnode
+ *            attr1 > cdata
+ *            ...
+ *            attrN > cdata
+ *        ...
+ *        subnode
+ *            attr1 > cdata
+ *            ...
+ *            attrN > cdata
+ *    Also node names are checked to match result columns.
+ *    At least one name must match. Matching columns must have only one text node child.
+ *    All subnodes must have same name.
+*/
+static
+bool
+xml_check_result_array(xmlNodePtr node, TupleDesc tuple_desc, xmlChar **attnames)
+{
+    xmlNodePtr    it        = NULL,
+                itc        = NULL;
+    const xmlChar *name    = NULL;
+    int            i,n        = 0;
+    bool        match    = false;
+
+    if(NULL == node)
+        return    false;
+
+    /* check all node children have same name */
+    for( it = node->children; NULL != it; it = it->next )
+    {
+        switch(it->type)
+        {
+            case XML_ELEMENT_NODE:
+                if(NULL == name)
+                    name    = it->name;
+                else
+                    /* check name of node to be the same */
+                    if(1 != xmlStrEqual(name, it->name))
+                        return    false;
+
+                /* check children */
+                n    = 0;
+                for( itc = it->children; NULL != itc; itc = itc->next )
+                {
+                    /* check sub elements names to match result columns */
+                    for (i = 0; i < tuple_desc->natts; i++)
+                    {
+                        if(1 == xmlStrEqual(attnames[i], itc->name))
+                        {
+                            /* don't check found value to be of ordinary type here - we can serialize it in the answer */
+
+                            /* TODO: check if we need such check:
+                             * we need to have only single XML_TEXT_NODE among children
+                            if(itc->children)
+                            {
+
+                                if(XML_TEXT_NODE != itc->children->type)
+                                    return    false;
+
+                                if(itc->children->next)
+                                    return    false;
+                            }
+                            */
+
+                            n++;
+                            break;
+                        }
+                    }
+                }
+
+                /* none of the children match result columns */
+                if(0 == n)
+                    return    false;
+                else
+                    match    = true;
+                break;
+            case XML_COMMENT_NODE:
+                continue;
+            case XML_ATTRIBUTE_NODE:
+            case XML_TEXT_NODE:
+            case XML_CDATA_SECTION_NODE:
+            case XML_ENTITY_REF_NODE:
+            case XML_ENTITY_NODE:
+            case XML_PI_NODE:
+            case XML_DOCUMENT_NODE:
+            case XML_DOCUMENT_TYPE_NODE:
+            case XML_DOCUMENT_FRAG_NODE:
+            case XML_NOTATION_NODE:
+            case XML_HTML_DOCUMENT_NODE:
+            case XML_DTD_NODE:
+            case XML_ELEMENT_DECL:
+            case XML_ATTRIBUTE_DECL:
+            case XML_ENTITY_DECL:
+            case XML_NAMESPACE_DECL:
+            case XML_XINCLUDE_START:
+            case XML_XINCLUDE_END:
+            case XML_DOCB_DOCUMENT_NODE:
+                return    false;
+        }
+    }
+
+    return    match;
+}
+
+/*
+ * xml_get_result_array_in_doc
+ *    search for a result in parsed xml
+*/
+static
+xmlNodePtr
+xml_get_result_array_in_doc(xmlDocPtr doc, TupleDesc tuple_desc)
+{
+    xmlNodePtr    suspect    = NULL,
+                it        = NULL;
+    List        *curr    = NULL,
+                *next    = NULL;
+    ListCell*    cell;
+    xmlChar**    attnames;
+    int            i;
+
+    if(NULL == doc)
+        return    NULL;
+
+    /* fill all document nodes as current list for check */
+    for( it = doc->children; NULL != it; it = it->next )
+    {
+        if(XML_ELEMENT_NODE != it->type)
+            continue;
+        curr    = lappend( curr, (void*)(it) );
+    }
+
+    /* prepare attnames in xmlChar*, to save time for strings comparisons in xml_check_result_array */
+    attnames    = (xmlChar**)palloc(tuple_desc->natts * sizeof(xmlChar*));
+    for( i=0; i<tuple_desc->natts; i++ )
+        attnames[i]    = xmlCharStrndup(tuple_desc->attrs[i]->attname.data, strlen(tuple_desc->attrs[i]->attname.data));
+
+    while(curr) {
+        foreach(cell, curr)
+        {
+            suspect    = (xmlNodePtr)(cell->data.ptr_value);
+            switch (suspect->type)
+            {
+                case XML_ELEMENT_NODE:
+                    /* check node to be valid answer */
+                    if(xml_check_result_array(suspect, tuple_desc, attnames))
+                    {
+                        /* free structures */
+                        list_free(curr);
+                        list_free(next);
+                        for( i=0; i<tuple_desc->natts; i++ )
+                            free(attnames[i]);
+                        return    suspect;
+                    }
+                    for( it = suspect->children; NULL != it; it = it->next )
+                    {
+                        if(XML_ELEMENT_NODE != it->type)
+                            continue;
+                        next    = lappend( next, (void*)(it) );
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        list_free(curr);
+        curr    = next;
+        next    = NULL;
+    }
+
+    /* free structures */
+    for( i=0; i<tuple_desc->natts; i++ )
+        free(attnames[i]);
+
+    return    NULL;
+}
+
+static
+Datum
+make_text_data(StringInfoData *str)
+{
+    text *t    = (text*)palloc(VARHDRSZ + str->len);
+    SET_VARSIZE(t, VARHDRSZ + str->len);
+    memcpy(t->vl_dat, str->data, str->len);
+
+    return PointerGetDatum(t);
+}
+
+/*
+ * call_response_deserialize_callback
+ * call to response_deserialize_callback for "xml" response_type
+ * prepare/setup reply structure from it's answer
+ */
+static
+Reply*
+call_response_deserialize_callback(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, StringInfoData *buffer)
+{
+    int        res, i,j, natts;
+    Oid        opts_argtypes[2]    = { opts_type, TEXTOID };
+    Datum    opts_values[2];
+    Reply    *reply;
+    Relation        rel;
+    AttInMetadata    *attinmeta;
+    char            **values    = NULL,
+        **names    = NULL;
+    int16            *columns;
+    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
+    bool            use_libxml    = false;
+    xmltype            *xml;
+
+    opts_values[0]    = opts_value;
+
+    rel = node->ss.ss_currentRelation;
+    attinmeta = TupleDescGetAttInMetadata(rel->rd_att);
+
+    SPI_connect_wrapper();
+
+    opts_values[1]    = make_text_data(buffer);
+
+#ifdef USE_LIBXML
+    d("compiled with xml support, passing xml data type to callback");
+    use_libxml = true;
+#else
+    d("compiled without xml support, passing text data type to callback");
+#endif
+
+    if(use_libxml && 0 == strcmp("xml", opts->response_type))
+    {
+        opts_argtypes[1] = XMLOID;
+        /* parses xml variable
+         * it parses/checks xml string and returns casted variable
+         */
+        xml    = xmlparse((text*)DatumGetPointer(opts_values[1]), XMLOPTION_DOCUMENT, true);
+        opts_values[1]    = XmlPGetDatum(xml);
+    }
+
+    /* do callback */
+    d("calling response_deserialize_callback: '%s'", opts->response_deserialize_callback);
+
+    res    = SPI_execute_plan(www_spi_plan(opts->response_deserialize_callback, 2, opts_argtypes), opts_values, NULL, true, 0);
+    if(0 > res)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("Can't execute response_deserialize_callback '%s': %i (%s)", opts->response_deserialize_callback, res, describe_spi_code(res))
+            )
+        );
+    }
+
+    /* save result to output parameters */
+    /* allocate it in proper memory context */
+    reply        = (Reply*)SPI_palloc(sizeof(Reply));
+    MemSet(reply, 0, sizeof(Reply));
+    reply->ntuples    = SPI_processed;
+    reply->tuple_index    = 0;
+    reply->options        = opts;
+    reply->opts_type    = opts_type;
+    reply->opts_value    = opts_value;
+    reply->stream    = NULL;
+    /* copy tuples structure: there can be further calls to SPI_exec* */
+    reply->tuples    = (HeapTuple*)SPI_palloc(reply->ntuples * sizeof(HeapTuple));
+
+    /* find correspondence between returned columns and columns we need to return */
+    natts = rel->rd_att->natts;
+    columns    = (int16*)palloc(natts * sizeof(int16));
+    names    = (char**)palloc(SPI_tuptable->tupdesc->natts * sizeof(char*));
+    for( i=1; i<=SPI_tuptable->tupdesc->natts; i++ )
+        names[i-1]    = SPI_fname(SPI_tuptable->tupdesc, i);
+
+    /* find column places */
+    for( i=0; i<natts; i++ )
+    {
+        columns[i]    = -1;
+
+        for( j=0; j<SPI_tuptable->tupdesc->natts; j++ )
+        {
+            if(0 == namestrcmp(&rel->rd_att->attrs[i]->attname, names[j]))
+            {
+                columns[i]    = j+1;
+                break;
+            }
+        }
+    }
+    pfree(names);
+
+    /* fill column values */
+    values = (char **) palloc(sizeof(char *) * natts);
+    for( i=0; i<reply->ntuples; i++ )
+    {
+        for( j=0; j<natts; j++ )
+        {
+            if(-1 == columns[j])
+                values[j]    = NULL;
+            else
+                values[j]    = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, columns[j]);
+        }
+
+        /* build tuple in proper memory context */
+        spimctxt = MemoryContextSwitchTo(mctxt);
+        reply->tuples[i] = BuildTupleFromCStrings(attinmeta, values);
+        MemoryContextSwitchTo(spimctxt);
+
+        /* free strings immediately, w/o losing track of them */
+        for( j=0; j<natts; j++ )
+            if(NULL != values[j])
+                SPI_pfree(values[j]);
+    }
+    pfree(values);
+
+    pfree(columns);
+
+    SPI_finish_wrapper();
+
+    return    reply;
+}
+
+/*
+ * OIDs of extension types passed to callbacks
+ * resolved once per backend, reset on any change of pg_type
+ */
+static Oid  www_fdw_options_type = InvalidOid;
+static Oid  www_fdw_post_parameters_type = InvalidOid;
+
+/*
+ * options cache entry
+ * parsed options of the foreign table for the user,
+ * invalidated on change of foreign table, its columns, server, user mapping or type
+ */
+typedef struct OptionsCacheKey
+{
+    Oid     foreigntableid;
+    Oid     userid;
+} OptionsCacheKey;
+
+typedef struct OptionsCacheEntry
+{
+    OptionsCacheKey key;        /* hash key (must be first) */
+    bool            valid;
+    WWW_fdw_options *opts;      /* allocated in own context (opts->cxt) */
+} OptionsCacheEntry;
+
+static HTAB *OptionsCacheHash = NULL;
+
+/*
+ * options_cache_invalidate
+ * syscache callback for foreign tables, servers, user mappings and types:
+ * all cached options are marked invalid (options change rarely),
+ * they're parsed again on the next scan
+ */
+static
+void
+#if PG_VERSION_NUM >= 90200
+options_cache_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+#else
+options_cache_invalidate(Datum arg, int cacheid, ItemPointer tuplePtr)
+#endif
+{
+    HASH_SEQ_STATUS     scan;
+    OptionsCacheEntry   *entry;
+
+    if(TYPEOID == cacheid)
+    {
+        www_fdw_options_type = InvalidOid;
+        www_fdw_post_parameters_type = InvalidOid;
+    }
+
+    hash_seq_init(&scan, OptionsCacheHash);
+    while ((entry = (OptionsCacheEntry *) hash_seq_search(&scan)))
+        entry->valid = false;
+}
+
+/*
+ * options_cache_init
+ * create options cache and register invalidation callbacks
+ * cache lives till the end of backend
+ */
+static
+void
+options_cache_init(void)
+{
+    HASHCTL     ctl;
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(OptionsCacheKey);
+    ctl.entrysize = sizeof(OptionsCacheEntry);
+    ctl.hash = tag_hash;
+    ctl.hcxt = CacheMemoryContext;
+    OptionsCacheHash = hash_create("www_fdw options", 8, &ctl,
+                                   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+    CacheRegisterSyscacheCallback(FOREIGNTABLEREL, options_cache_invalidate, (Datum) 0);
+    CacheRegisterSyscacheCallback(FOREIGNSERVEROID, options_cache_invalidate, (Datum) 0);
+    CacheRegisterSyscacheCallback(USERMAPPINGOID, options_cache_invalidate, (Datum) 0);
+    /* column options */
+    CacheRegisterSyscacheCallback(ATTNUM, options_cache_invalidate, (Datum) 0);
+    CacheRegisterSyscacheCallback(TYPEOID, options_cache_invalidate, (Datum) 0);
+}
+
+/*
+ * get_www_fdw_type
+ * get Oid of extension type through syscache
+ * extension is relocatable, so type is searched in schema of
+ * the handler function of server's foreign data wrapper
+ */
+static
+Oid
+get_www_fdw_type(const char *typname, Oid serverid)
+{
+    ForeignDataWrapper  *fdw = GetForeignDataWrapper(GetForeignServer(serverid)->fdwid);
+    Oid                 typnamespace = get_func_namespace(fdw->fdwhandler);
+    Oid                 type;
+
+#if PG_VERSION_NUM >= 120000
+    type = GetSysCacheOid2(TYPENAMENSP, Anum_pg_type_oid, CStringGetDatum(typname), ObjectIdGetDatum(typnamespace));
+#else
+    type = GetSysCacheOid2(TYPENAMENSP, CStringGetDatum(typname), ObjectIdGetDatum(typnamespace));
+#endif
+    if(!OidIsValid(type))
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_UNDEFINED_OBJECT),
+                errmsg("Can't identify %s OID in schema of www_fdw extension", typname)
+            )
+        );
+
+    return type;
+}
+
+/*
+ * get_www_fdw_options
+ * get Oid for options type, set up Datum value for it properly
+ * will be used to pass it to callbacks
+ * value is built once and kept with cached options
+ */
+static
+void
+get_www_fdw_options(WWW_fdw_options *opts, Oid *opts_type, Datum *opts_value)
+{
+    char*    options[]    = {
+        opts->uri,
+        opts->uri_select,
+        opts->uri_insert,
+        opts->uri_delete,
+        opts->uri_update,
+        opts->uri_callback,
+
+        opts->method_select,
+        opts->method_insert,
+        opts->method_delete,
+        opts->method_update,
+
+        opts->request_user_agent,
+        opts->request_user_header,
+        opts->request_serialize_callback,
+        opts->request_serialize_type,
+        opts->request_serialize_human_readable,
+
+        opts->response_type,
+        opts->response_deserialize_callback,
+        opts->response_iterate_callback,
+
+        opts->ssl_cert,
+        opts->ssl_key,
+        opts->cainfo,
+        opts->proxy,
+        opts->cookie,
+        opts->username,
+        opts->password
+    };
+    AttInMetadata*      aim;
+    Datum               value;
+    MemoryContext       oldcontext;
+
+    if(!OidIsValid(www_fdw_options_type))
+        www_fdw_options_type = get_www_fdw_type("wwwfdwoptions", opts->serverid);
+    *opts_type  = www_fdw_options_type;
+
+    if(!DatumGetPointer(opts->value))
+    {
+        aim = TupleDescGetAttInMetadata(TypeGetTupleDesc(*opts_type, NIL));
+        value = HeapTupleGetDatum( BuildTupleFromCStrings(aim, options) );
+
+        oldcontext = MemoryContextSwitchTo(opts->cxt);
+        opts->value = datumCopy(value, false, -1);
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    *opts_value = opts->value;
+}
+
+/*
+ * get_www_fdw_post_parameters
+ * get Oid for WWWFdwPostParameters type, set up Datum value for it properly
+ * will be used to pass it to callbacks
+ */
+static
+void
+get_www_fdw_post_parameters(WWW_fdw_options *opts, PostParameters *post, Oid *post_type, Datum *post_value)
+{
+    char*    postparams[]    = {
+        post->post ? "t" : "f",
+        post->data.data,
+        post->content_type.data
+    };
+    AttInMetadata*    aim;
+
+    if(!OidIsValid(www_fdw_post_parameters_type))
+        www_fdw_post_parameters_type = get_www_fdw_type("wwwfdwpostparameters", opts->serverid);
+    *post_type  = www_fdw_post_parameters_type;
+
+    aim         = TupleDescGetAttInMetadata(TypeGetTupleDesc(*post_type, NIL));
+    *post_value = HeapTupleGetDatum( BuildTupleFromCStrings(aim, postparams) );
+}
+
+/*
+ * prepare_xml_result
+ * go through parsed result and prepare reply/result structure
+ */
+static
+Reply*
+prepare_xml_result(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, xmlDocPtr doc)
+{
+    xmlNodePtr    result    = NULL,
+        it = NULL,
+        itc= NULL;
+    Relation    rel;
+    AttInMetadata    *attinmeta;
+    Reply            *reply;
+    xmlChar            **attnames;
+    int                i,j, natts;
+    char            **values    = NULL;
+    bool            *used       = node->fdw_state ? ((WWWScanState *) node->fdw_state)->used : NULL;
+
+    rel = node->ss.ss_currentRelation;
+    attinmeta = TupleDescGetAttInMetadata(rel->rd_att);
+
+    result    = xml_get_result_array_in_doc(doc, rel->rd_att);
+    if(!result)
+        ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                 errmsg("Can't find result in parsed server's xml response")
+                    ));
+
+    d("Result array was found in xml response");
+
+    /* save result */
+    reply = (Reply*)palloc0(sizeof(Reply));
+    reply->tuple_index = 0;
+    reply->options = opts;
+    reply->opts_type = opts_type;
+    reply->opts_value = opts_value;
+    reply->stream = NULL;
+
+    /* calculate number of results */
+    reply->ntuples = 0;
+    for( it = result->children; NULL != it; it = it->next )
+        reply->ntuples++;
+
+    reply->tuples = (0 == reply->ntuples) ?
+        NULL :
+        (HeapTuple*)palloc(reply->ntuples * sizeof(HeapTuple));
+
+    /* prepare result column names in xmlChar* for proper comparison */
+    natts = rel->rd_att->natts;
+    attnames    = (xmlChar**)palloc(natts * sizeof(xmlChar*));
+    for (i = 0; i < natts; i++)
+        attnames[i]    = xmlCharStrndup(rel->rd_att->attrs[i]->attname.data, strlen(rel->rd_att->attrs[i]->attname.data));
+
+    /* find column places, columns not needed by the query are left null */
+    values = (char **) palloc(sizeof(char *) * natts);
+    for( it = result->children, j=0 ; NULL != it; it = it->next, j++ )
+    {
+        for (i = 0; i < natts; i++)
+        {
+            values[i]    = NULL;
+            if(used && !used[i])
+                continue;
+
+            for( itc = it->children; NULL != itc; itc = itc->next )
+                if(1 == xmlStrEqual(attnames[i], itc->name))
+                    break;
+
+            if(itc)
+                values[i]    = (char*)itc->children->content;
+            else
+                values[i]    = NULL;
+        }
+
+        reply->tuples[j] = BuildTupleFromCStrings(attinmeta, values);
+    }
+    pfree(values);
+
+    pfree(attnames);
+
+    return    reply;
+}
+
+/*
+ * json_rows_init
+ * prepare reply, which is filled by json decoder
+ * size - initial size of tuples array
+ */
+static
+void
+json_rows_init(JSONRows *rows, ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, uint32 size)
+{
+    Reply       *reply = (Reply*)palloc0(sizeof(Reply));
+
+    reply->options = opts;
+    reply->opts_type = opts_type;
+    reply->opts_value = opts_value;
+    reply->tuples = (HeapTuple*)palloc(size * sizeof(HeapTuple));
+
+    rows->reply = reply;
+    rows->tuple_desc = node->ss.ss_currentRelation->rd_att;
+    rows->size = size;
+    rows->array_cxt = CurrentMemoryContext;
+    rows->tuple_cxt = CurrentMemoryContext;
+}
+
+/*
+ * www_reply_tuple
+ *   next row of reply as heap tuple in CurrentMemoryContext
+ *   (rows of tuplestore are read through slot, slot is cleared after it)
+ */
+static HeapTuple
+www_reply_tuple(Reply *reply, TupleTableSlot *slot)
+{
+    HeapTuple   tuple;
+
+    if (NULL == reply->store)
+        return reply->tuples[reply->tuple_index++];
+
+    reply->tuple_index++;
+    if (!tuplestore_gettupleslot(reply->store, true, false, slot))
+        elog(ERROR, "www_fdw: unexpected end of reply rows");
+    tuple = ExecCopySlotTuple(slot);
+    ExecClearTuple(slot);
+    /* tuple is passed to callbacks as composite datum */
+    HeapTupleHeaderSetDatumLength(tuple->t_data, tuple->t_len);
+    HeapTupleHeaderSetTypeId(tuple->t_data, slot->tts_tupleDescriptor->tdtypeid);
+    HeapTupleHeaderSetTypMod(tuple->t_data, slot->tts_tupleDescriptor->tdtypmod);
+    return tuple;
+}
+
+/*
+ * www_reply_rewind
+ *   return rows of reply from the first one again
+ */
+static void
+www_reply_rewind(Reply *reply)
+{
+    reply->tuple_index = 0;
+    if (reply->store)
+        tuplestore_rescan(reply->store);
+}
+
+/*
+ * www_reply_free_rows
+ *   release tuplestore of reply (its temp files are removed at once),
+ *   arrays go away with memory context of reply
+ */
+static void
+www_reply_free_rows(Reply *reply)
+{
+    if (reply && reply->store)
+    {
+        tuplestore_end(reply->store);
+        reply->store = NULL;
+    }
+}
+
+/*
+ * json_rows_append
+ * json decoder row callback: form tuple and add it to the reply
+ * raw tokens of deferred columns are kept next to it (length goes first)
+ */
+static
+void
+json_rows_append(void *arg, Datum *values, bool *isnull, StringInfo raw)
+{
+    JSONRows        *rows = (JSONRows*)arg;
+    Reply           *reply = rows->reply;
+    MemoryContext   oldcontext;
+
+    /* rest of the chunk after rows needed by LIMIT */
+    if(rows->limit && reply->ntuples >= rows->limit)
+        return;
+
+    /* store copies the row into its own memory (or temp file) */
+    if(reply->store && rows->raw_desc)
+    {
+        int     natts = rows->tuple_desc->natts;
+        bytea   *token = NULL;
+
+        memcpy(rows->raw_values, values, natts * sizeof(Datum));
+        memcpy(rows->raw_isnull, isnull, natts * sizeof(bool));
+        if(raw)
+        {
+            token = (bytea*)MemoryContextAlloc(rows->tuple_cxt, VARHDRSZ + raw->len);
+            SET_VARSIZE(token, VARHDRSZ + raw->len);
+            memcpy(VARDATA(token), raw->data, raw->len);
+        }
+        rows->raw_values[natts] = PointerGetDatum(token);
+        rows->raw_isnull[natts] = NULL == token;
+        tuplestore_putvalues(reply->store, rows->raw_desc, rows->raw_values, rows->raw_isnull);
+        if(token)
+            pfree(token);
+        reply->ntuples++;
+        return;
+    }
+    if(reply->store)
+    {
+        tuplestore_putvalues(reply->store, rows->tuple_desc, values, isnull);
+        reply->ntuples++;
+        return;
+    }
+
+    if(reply->ntuples >= rows->size)
+    {
+        /* one chunk can contain more rows than buffer was prepared for */
+        rows->size *= 2;
+        reply->tuples = (HeapTuple*)repalloc(reply->tuples, rows->size * sizeof(HeapTuple));
+        if(reply->raw)
+            reply->raw = (char**)repalloc(reply->raw, rows->size * sizeof(char*));
+    }
+    if(raw && !reply->raw)
+        reply->raw = (char**)MemoryContextAllocZero(rows->array_cxt, rows->size * sizeof(char*));
+
+    oldcontext = MemoryContextSwitchTo(rows->tuple_cxt);
+    if(raw)
+    {
+        uint32  length = raw->len;
+
+        reply->raw[reply->ntuples] = (char*)palloc(sizeof(length) + length);
+        memcpy(reply->raw[reply->ntuples], &length, sizeof(length));
+        memcpy(reply->raw[reply->ntuples] + sizeof(length), raw->data, length);
+    }
+    reply->tuples[reply->ntuples++] = heap_form_tuple(rows->tuple_desc, values, isnull);
+    MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * www_write_catch
+ *    keep error raised by write callback (in PG_CATCH block of it):
+ *    longjmp out of libcurl leaves its handles in undefined state,
+ *    so callback returns 0 (transfer is aborted) and error is raised
+ *    by www_write_rethrow after curl returns
+ */
+static void
+www_write_catch(ErrorData **error, MemoryContext cxt)
+{
+    MemoryContextSwitchTo(cxt);
+    *error = CopyErrorData();
+    FlushErrorState();
+}
+
+/*
+ * www_write_rethrow
+ *    raise error kept by www_write_catch, if any
+ */
+static void
+www_write_rethrow(ErrorData **error)
+{
+    ErrorData   *edata = *error;
+
+    if (edata)
+    {
+        *error = NULL;
+        ReThrowError(edata);
+    }
+}
+
+/*
+ * json_stream_write_data
+ *    parse json chunk by chunk in streaming mode
+ *    pause transfer if enough rows are buffered already
+*/
+static size_t
+json_stream_write_data(void *buffer, size_t size, size_t nmemb, void *userp)
+{
+    int            segsize = size * nmemb;
+    JSONStream     *stream = (JSONStream*) userp;
+    MemoryContext  oldcontext = CurrentMemoryContext;
+    int            ret;
+
+    if(stream->reply->ntuples >= stream->max_rows)
+    {
+        stream->paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    PG_TRY();
+    {
+        ret = json_parser_string(&stream->parser, buffer, segsize, NULL);
+        if (ret)
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                errmsg("Can't parse server's json response, parser error code: %i", ret)
+                ));
+    }
+    PG_CATCH();
+    {
+        www_write_catch(&stream->error, oldcontext);
+        return 0;
+    }
+    PG_END_TRY();
+
+    return segsize;
+}
+
+/*
+ * json_decoder_parser_init
+ * parser for json decoder (and path finders): strings are passed right from
+ * received chunks, escaped ones are unescaped once, into column values
+ * utf-8 is checked by parser in bulk, so text values are valid in utf-8 database
+ */
+static
+int
+json_decoder_parser_init(json_parser *parser, json_parser_callback callback, void *userdata)
+{
+    json_config config;
+
+    MemSet(&config, 0, sizeof(config));
+    config.inplace_strings = 1;
+    config.validate_utf8 = PG_UTF8 == GetDatabaseEncoding();
+    return json_parser_init(parser, &config, callback, userdata);
+}
+
+/*
+ * json_stream_create
+ * prepare reply for streaming mode
+ * tuples buffer is preallocated for response_stream_rows tuples
+ */
+static
+JSONStream*
+json_stream_create(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value)
+{
+    JSONStream  *stream = (JSONStream*)palloc0(sizeof(JSONStream));
+
+    stream->max_per_host = opts->max_per_host;
+    stream->max_rows = opts->stream_rows;
+    stream->batch_cxt = AllocSetContextCreate(CurrentMemoryContext,
+                                              "www_fdw stream batch",
+                                              ALLOCSET_DEFAULT_MINSIZE,
+                                              ALLOCSET_DEFAULT_INITSIZE,
+                                              ALLOCSET_DEFAULT_MAXSIZE);
+
+    json_rows_init(&stream->rows, node, opts, opts_type, opts_value, stream->max_rows);
+    stream->rows.tuple_cxt = stream->batch_cxt;
+    stream->reply = stream->rows.reply;
+    stream->reply->stream = stream;
+
+    json_decoder_init(&stream->decoder, stream->rows.tuple_desc, json_rows_append, &stream->rows);
+    if (node->fdw_state)
+    {
+        json_decoder_project(&stream->decoder, ((WWWScanState *) node->fdw_state)->used);
+        json_decoder_defer(&stream->decoder, ((WWWScanState *) node->fdw_state)->deferred);
+    }
+
+    return stream;
+}
+
+/*
+ * json_stream_start
+ * (re)start transfer, it's driven by json_stream_fill then
+ */
+static
+void
+json_stream_start(JSONStream *stream)
+{
+    int         ret;
+    CURLMcode   mret;
+
+    ret = json_decoder_parser_init(&stream->parser, json_decoder_callback, &stream->decoder);
+    if(ret)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+            errmsg("Can't initialize json parser, error code: %i", ret)
+            ));
+    json_decoder_reset(&stream->decoder);
+
+    stream->paused = false;
+    stream->done = false;
+    stream->reply->ntuples = 0;
+    stream->reply->tuple_index = 0;
+    MemoryContextReset(stream->batch_cxt);
+
+    mret = curl_multi_add_handle(stream->multi, stream->connection->curl);
+    if(CURLM_OK != mret)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+            errmsg("Can't start request: %s", curl_multi_strerror(mret))
+            ));
+    stream->running = true;
+}
+
+/*
+ * json_stream_stop
+ * stop transfer (if it isn't finished, connection is closed)
+ */
+static
+void
+json_stream_stop(JSONStream *stream)
+{
+    if(!stream->running)
+        return;
+
+    curl_multi_remove_handle(stream->multi, stream->connection->curl);
+    json_parser_free(&stream->parser);
+    stream->running = false;
+}
+
+/*
+ * json_stream_finish
+ * check transfer result, when it's completed
+ */
+static
+void
+json_stream_finish(JSONStream *stream)
+{
+    CURLMsg     *msg;
+    CURLcode    ret = CURLE_OK;
+    int         left;
+
+    stream->done = true;
+
+    while(NULL != (msg = curl_multi_info_read(stream->multi, &left)))
+    {
+        if(CURLMSG_DONE == msg->msg)
+            ret = msg->data.result;
+    }
+
+    if(ret)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+            errmsg("Can't get a response from server: %s", stream->curl_error_buffer)
+            ));
+
+    if(!stream->decoder.found)
+        ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                 errmsg("Can't find result in parsed server's json response")
+                    ));
+}
+
+/*
+ * json_stream_fill
+ * drop returned tuples and pump transfer till next tuples are parsed
+ * (or till the end of the response)
+ */
+static
+void
+json_stream_fill(JSONStream *stream)
+{
+    Reply       *reply = stream->reply;
+    CURLMcode   mret;
+    int         running;
+
+    MemoryContextReset(stream->batch_cxt);
+    reply->ntuples = 0;
+    reply->tuple_index = 0;
+
+    while(0 == reply->ntuples && !stream->done)
+    {
+        if(stream->paused)
+        {
+            /* buffer is empty now: data, which was paused, is passed to parser right here */
+            stream->paused = false;
+            curl_easy_pause(stream->connection->curl, CURLPAUSE_CONT);
+            www_write_rethrow(&stream->error);
+            continue;
+        }
+
+        mret = curl_multi_perform(stream->multi, &running);
+        www_write_rethrow(&stream->error);
+        if(CURLM_OK != mret)
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+                errmsg("Can't get a response from server: %s", curl_multi_strerror(mret))
+                ));
+
+        if(0 == running)
+        {
+            json_stream_finish(stream);
+            break;
+        }
+
+        if(0 < reply->ntuples)
+            break;
+
+        mret = curl_multi_wait(stream->multi, NULL, 0, 1000, NULL);
+        if(CURLM_OK != mret)
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+                errmsg("Can't wait for a response from server: %s", curl_multi_strerror(mret))
+                ));
+        CHECK_FOR_INTERRUPTS();
+    }
+}
+
+/*
+ * www_page_json_callback
+ *   json parser callback of paged response: events go to rows decoder
+ *   and to finders of the next page cursor (page_next_path)
+ *   and of the total count (page_total_path)
+ */
+static int
+www_page_json_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+    WWWRequest  *req = (WWWRequest *) userdata;
+
+    if (req->next_finder.keys)
+        json_path_callback(&req->next_finder, type, data, length);
+    if (req->total_finder.keys)
+        json_path_callback(&req->total_finder, type, data, length);
+    return json_decoder_callback(&req->json_decoder, type, data, length);
+}
+
+/*
+ * www_page_header
+ *   curl header callback: keep value of page_next_header
+ *   (last one wins, so headers of redirects are overwritten)
+ */
+static size_t
+www_page_header(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    WWWRequest  *req = (WWWRequest *) userp;
+    size_t      length = size * nitems,
+                namelen = strlen(req->next_header_name);
+    char        *value,
+                *end;
+
+    if (length <= namelen || ':' != buffer[namelen]
+        || 0 != pg_strncasecmp(buffer, req->next_header_name, namelen))
+        return length;
+
+    value = buffer + namelen + 1;
+    end = buffer + length;
+    while (value < end && (' ' == *value || '\t' == *value))
+        value++;
+    while (end > value && ('\r' == end[-1] || '\n' == end[-1] || ' ' == end[-1]))
+        end--;
+
+    req->next_header = pnstrdup(value, end - value);
+    return length;
+}
+
+/*
+ * www_link_next
+ *   url of rel=next link in Link header value:
+ *   <url1>; rel="prev", <url2>; rel="next"
+ *   returns NULL if there is no such link
+ */
+static char *
+www_link_next(const char *link)
+{
+    const char  *p = link;
+
+    while (p && (p = strchr(p, '<')))
+    {
+        const char  *url = p + 1,
+                    *url_end = strchr(url, '>'),
+                    *params_end;
+        char        *params;
+        bool        found;
+
+        if (NULL == url_end)
+            return NULL;
+
+        /* parameters of the link last till next link */
+        params_end = strchr(url_end, '<');
+        params = params_end ? pnstrdup(url_end, params_end - url_end) : pstrdup(url_end);
+        found = NULL != strstr(params, "rel=\"next\"") || NULL != strstr(params, "rel=next");
+        pfree(params);
+        if (found)
+            return pnstrdup(url, url_end - url);
+
+        p = url_end;
+    }
+
+    return NULL;
+}
+
+/*
+ * xml_find_text
+ *   text of the first element with specified name (document order), NULL - not found
+ */
+static char *
+xml_find_text(xmlNodePtr node, const char *name)
+{
+    for (; node; node = node->next)
+    {
+        char    *text;
+
+        if (XML_ELEMENT_NODE != node->type)
+            continue;
+
+        if (0 == xmlStrcmp(node->name, (const xmlChar *) name))
+        {
+            xmlChar *content = xmlNodeGetContent(node);
+
+            text = content ? pstrdup((char *) content) : NULL;
+            xmlFree(content);
+            return text;
+        }
+
+        if ((text = xml_find_text(node->children, name)))
+            return text;
+    }
+
+    return NULL;
+}
+
+/*
+ * www_request_limited
+ *   rows needed by LIMIT of the scan are decoded already, rest of response isn't needed
+ */
+static bool
+www_request_limited(WWWRequest *req)
+{
+    return req->json_rows.limit && req->json_rows.reply
+        && req->json_rows.reply->ntuples >= req->json_rows.limit;
+}
+
+/*
+ * www_request_setup
+ *   Setup curl handle and parsers of the response for request to req->url
+ *   (url of next page is taken from previous response as is)
+ */
+static void
+www_request_setup(ForeignScanState *node, WWW_fdw_options *opts, bool stream, WWWRequest *req)
+{
+    CURL              *curl;
+    StringInfoData    postContentType;
+
+    d("Url for request: '%s'", req->url.data);
+
+    /* interacting with the server:
+     * handle comes from per backend pool, so connection to the server
+     * (dns, tcp, tls) is set up only once for all scans of the server
+     */
+    req->connection = www_connection_acquire(opts->serverid, opts->userid, opts->idle_timeout);
+    curl = req->connection->curl;
+    /* error buffer has to live till the end of the scan in streaming mode */
+    req->curl_error_buffer = (char*)palloc0(CURL_ERROR_SIZE+1);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_URL, req->url.data);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, opts->request_user_agent);
+    if ( opts->username ) 
+    {
+        curl_easy_setopt(curl, CURLOPT_USERNAME,  opts->username );
+    }
+    if ( opts->password )
+    {
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, opts->password );
+        curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+    }
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, req->curl_error_buffer);
+
+    if(opts->request_user_header)
+    {
+        req->headers = curl_slist_append(req->headers, opts->request_user_header);
+    }
+
+    if(req->post.post || WWW_METHOD_POST == opts->method)
+    {
+        curl_easy_setopt(curl, CURLOPT_POST, 1);
+        if(0 < req->post.content_type.len)
+        {
+            initStringInfo(&postContentType);
+            appendStringInfo(&postContentType,"Content-Type: %s", req->post.content_type.data );
+            req->headers = curl_slist_append(req->headers, postContentType.data);
+        }
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->post.data.data);
+    }
+
+    if( req->headers )
+    {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, req->headers);
+    }
+
+    /* TODO
+     * implement & test all other methods:
+     * PUT
+     * POST
+     * and check POST is special:
+     * https://curl.haxx.se/libcurl/c/CURLOPT_CUSTOMREQUEST.html
+     * */
+    /* deleting */
+    if( WWW_METHOD_DELETE == opts->method )
+    {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE" );
+    }
+
+    /* prepare parsers */
+    if( WWW_RESPONSE_JSON == opts->response_format )
+    {
+        if(opts->response_deserialize_callback)
+        {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
+            initStringInfo(&req->buffer);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req->buffer);
+        }
+        else if(stream)
+        {
+            req->stream = json_stream_create(node, opts, req->opts_type, req->opts_value);
+            req->stream->connection = req->connection;
+            req->stream->multi = www_connection_multi(req->connection);
+            req->stream->curl_error_buffer = req->curl_error_buffer;
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, json_stream_write_data);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, req->stream);
+        }
+        else
+        {
+            /* rows are decoded right from parser events, without json tree */
+            json_rows_init(&req->json_rows, node, opts, req->opts_type, req->opts_value, 16);
+            json_decoder_init(&req->json_decoder, req->json_rows.tuple_desc, json_rows_append, &req->json_rows);
+            if(node->fdw_state)
+            {
+                req->json_rows.limit = ((WWWScanState *) node->fdw_state)->limit;
+                json_decoder_project(&req->json_decoder, ((WWWScanState *) node->fdw_state)->used);
+                json_decoder_defer(&req->json_decoder, ((WWWScanState *) node->fdw_state)->deferred);
+                /* rows are kept within work_mem, the rest goes to temp files
+                 * (raw tokens of deferred columns are stored as the last attribute) */
+                pfree(req->json_rows.reply->tuples);
+                req->json_rows.reply->tuples = NULL;
+                req->json_rows.reply->store = tuplestore_begin_heap(false, false, work_mem);
+                if(((WWWScanState *) node->fdw_state)->raw_slot)
+                {
+                    TupleDesc   raw_desc = ((WWWScanState *) node->fdw_state)->raw_slot->tts_tupleDescriptor;
+
+                    req->json_rows.raw_desc = raw_desc;
+                    req->json_rows.raw_values = (Datum*)palloc(raw_desc->natts * sizeof(Datum));
+                    req->json_rows.raw_isnull = (bool*)palloc(raw_desc->natts * sizeof(bool));
+                }
+            }
+            if(opts->page_next_path || opts->page_total_path)
+            {
+                /* cursor and total count are searched in the same parser events */
+                if(opts->page_next_path)
+                    json_path_init(&req->next_finder, opts->page_next_path);
+                if(opts->page_total_path)
+                    json_path_init(&req->total_finder, opts->page_total_path);
+                json_decoder_parser_init(&req->json, www_page_json_callback, req);
+            }
+            else
+                json_decoder_parser_init(&req->json, json_decoder_callback, &req->json_decoder);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, json_write_data_to_parser);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+        }
+    }
+    else if( WWW_RESPONSE_XML == opts->response_format )
+    {
+        if(opts->response_deserialize_callback)
+        {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
+            initStringInfo(&req->buffer);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req->buffer);
+        }
+        else
+        {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, xml_write_data_to_parser);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+        }
+    }
+    else if( WWW_RESPONSE_OTHER == opts->response_format )
+    {
+        if(opts->response_deserialize_callback)
+        {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
+            initStringInfo(&req->buffer);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req->buffer);
+        }
+        else
+            ereport(ERROR,
+                    (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+                     errmsg("No response_deserialize_callback for response_type='other'")
+                        ));
+    }
+
+        /* Ioana START changed on Jan 18, 2013 - added 4 more options for secure connections */
+        if(opts->ssl_cert)
+        {
+                curl_easy_setopt(curl, CURLOPT_SSLCERT, opts->ssl_cert);
+        }
+        if(opts->ssl_key)
+        {
+                curl_easy_setopt(curl, CURLOPT_SSLKEY, opts->ssl_key);
+        }
+        if(opts->cainfo)
+        {
+                curl_easy_setopt(curl, CURLOPT_CAINFO, opts->cainfo);
+        }
+        if(opts->proxy)
+        {
+                curl_easy_setopt(curl, CURLOPT_PROXY, opts->proxy);
+        }
+        /* Ioana END changed on Jan 18, 2013 */
+        if(opts->cookie)
+        {
+                curl_easy_setopt(curl, CURLOPT_COOKIE, opts->cookie);
+        }
+
+    if(opts->page_next_header)
+    {
+        req->next_header_name = opts->page_next_header;
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, www_page_header);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, req);
+    }
+}
+
+/*
+ * www_request_start
+ *   Setup request to search API: url, curl handle and parsers of the response
+ *   params - additional url parameters (outer values, fan-out value), NULL - none
+ *   stream - json response is streamed (response_stream), transfer is driven by www_iterate
+ *   transfer isn't made here, it's driven by caller
+ */
+static void
+www_request_start(ForeignScanState *node, WWW_fdw_options *opts, const char *params, bool stream, WWWRequest *req)
+{
+    initStringInfo(&req->url);
+    appendStringInfo(&req->url, "%s%s", opts->uri, opts->uri_select);
+
+    /* initialize options type and value if any of callback specified */
+    if(
+        opts->request_serialize_callback
+        ||
+        opts->response_deserialize_callback
+        ||
+        opts->response_iterate_callback
+    )
+    {
+        get_www_fdw_options(opts, &req->opts_type, &req->opts_value);
+    }
+
+    req->post.post = false;
+    if(opts->request_serialize_callback)
+    {
+        /* call specified callback for forming request */
+        initStringInfo(&req->post.data);
+        initStringInfo(&req->post.content_type);
+        serialize_request_with_callback(opts, req->opts_type, req->opts_value, node, &req->url, &req->post);
+    }
+    else
+    {
+        serialize_request_parameters(node, &req->url, params);
+    }
+
+    www_request_setup(node, opts, stream, req);
+}
+
+/*
+ * www_request_finish
+ *   Return connection of finished transfer to the pool and make reply
+ *   from the response
+ *   ret - result of the transfer
+ */
+static Reply *
+www_request_finish(ForeignScanState *node, WWW_fdw_options *opts, WWWRequest *req, CURLcode ret)
+{
+    Reply             *reply = NULL;
+    bool              reused = req->connection->reused;
+    bool              limited = www_request_limited(req);
+
+    www_connection_release(req->connection, opts->max_per_host);
+    /* response wasn't parsed (transfer was aborted by write callback) */
+    www_write_rethrow(&req->error);
+    /* transfer was aborted after rows needed by LIMIT */
+    if(CURLE_WRITE_ERROR == ret && limited)
+        ret = CURLE_OK;
+    if(ret) {
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+            errmsg("Can't get a response from server: %s", req->curl_error_buffer)
+            ));
+    }
+    if(req->headers)
+        curl_slist_free_all(req->headers);
+    req->headers = NULL;
+
+    /* process parsed results */
+    if( WWW_RESPONSE_JSON == opts->response_format )
+    {
+        if(opts->response_deserialize_callback)
+        {
+            if(opts->page_next_path)
+                req->next = json_path_find(opts->page_next_path, req->buffer.data, req->buffer.len);
+            if(opts->page_total_path)
+                req->total = json_path_find(opts->page_total_path, req->buffer.data, req->buffer.len);
+            reply = call_response_deserialize_callback(node, opts, req->opts_type, req->opts_value, &req->buffer);
+        }
+        else
+        {
+            if(!limited && !json_parser_is_done(&req->json))
+                ereport(ERROR,
+                        (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                         errmsg("Can't parse server's json response, parser error code: %i", ret)
+                            ));
+
+            d("JSON response was parsed");
+
+            if(!req->json_decoder.found)
+                ereport(ERROR,
+                        (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                         errmsg("Can't find result in parsed server's json response")
+                            ));
+
+            reply = req->json_rows.reply;
+            if(opts->page_next_path)
+                req->next = req->next_finder.value;
+            if(opts->page_total_path)
+                req->total = req->total_finder.value;
+
+            /* rows are produced already, parse state isn't needed anymore */
+            json_parser_free(&req->json);
+            json_decoder_free(&req->json_decoder);
+        }
+    }
+    else if( WWW_RESPONSE_XML == opts->response_format )
+    {
+        if(opts->response_deserialize_callback)
+        {
+            reply = call_response_deserialize_callback(node, opts, req->opts_type, req->opts_value, &req->buffer);
+        }
+        else
+        {
+            /* get result in parsed response tree
+             * and save it for further processing in results iterations
+            */
+
+            xmlDocPtr    doc        = NULL;
+            int            res;
+
+            /* there is no more input, indicate the parsing is finished */
+            xmlParseChunk(req->xml, req->curl_error_buffer, 0, 1);
+
+            doc    = req->xml->myDoc;
+            res    = req->xml->wellFormed;
+
+            xmlFreeParserCtxt(req->xml);
+
+            if(!res)
+                ereport(ERROR,
+                    (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                    errmsg("Response xml isn't well formed")
+                    ));
+
+            d("Xml response was parsed");
+
+            reply = prepare_xml_result(node, opts, req->opts_type, req->opts_value, doc);
+            if(opts->page_next_path)
+                req->next = xml_find_text(xmlDocGetRootElement(doc), opts->page_next_path);
+            if(opts->page_total_path)
+                req->total = xml_find_text(xmlDocGetRootElement(doc), opts->page_total_path);
+
+            /* result data was trully copied: free it up */
+            xmlFreeDoc(doc);
         }
+    }
+    else if( WWW_RESPONSE_OTHER == opts->response_format )
+    {
+        /* checked already that we have response_deserialize_callback */
+        reply = call_response_deserialize_callback(node, opts, req->opts_type, req->opts_value, &req->buffer);
+    }
 
-        list_free(curr);
-        curr    = next;
-        next    = NULL;
+    /* header takes precedence, cursor of the body is kept if header isn't sent */
+    if(opts->page_next_header)
+    {
+        char    *next = 0 == pg_strcasecmp(opts->page_next_header, "Link")
+            ? www_link_next(req->next_header) : req->next_header;
+
+        if(next)
+            req->next = next;
     }
 
-    /* free structures */
-    for( i=0; i<tuple_desc->natts; i++ )
-        free(attnames[i]);
+    /* raw response was turned into rows */
+    if(req->buffer.data)
+    {
+        pfree(req->buffer.data);
+        req->buffer.data = NULL;
+    }
 
-    return    NULL;
+    reply->connection_reused = reused;
+    return reply;
 }
 
 /*
- * json_check_result_array
- *    Currently checks all elements to be objects.
- *    And checks if at least one key in the object matches result columns.
-*/
-static
-bool
-json_check_result_array(JSONNode* root, TupleDesc tuple_desc)
+ * www_request
+ *   Query search API and setup result
+ *   join_params - url parameters for outer values of parameterized scan, NULL - none
+ */
+static Reply *
+www_request(ForeignScanState *node, WWW_fdw_options *opts, const char *join_params)
 {
-    int    i,j,k,n;
+    WWWRequest  *req = (WWWRequest *) palloc0(sizeof(WWWRequest));
 
-    for( i=0; i<root->length; i++ )
-    {
-        if(JSON_OBJECT_BEGIN != root->val.val_array[i].type)
-            return    false;
+    www_request_start(node, opts, join_params, opts->stream, req);
 
-        /* check if at least one key matchs result columns */
-        n    = 0;
-        for( j=0; j<root->val.val_array[i].length && 0==n; j++ )
-        {
-            for( k=0; k<tuple_desc->natts && 0==n; k++ )
-            {
-                if(0 == namestrcmp(&tuple_desc->attrs[k]->attname, root->val.val_array[i].val.val_object[j].key))
-                {
-                    /* don't check found value to be of ordinary type here - we can serialize it in the answer */
+    if(req->stream)
+    {
+        /* transfer is driven by www_iterate,
+         * connection is returned to the pool in www_end
+         */
+        req->stream->headers = req->headers;
+        json_stream_start(req->stream);
+        req->stream->reply->connection_reused = req->connection->reused;
+        return req->stream->reply;
+    }
 
-                    n++;
-                    break;
-                }
-            }
-        }
+    return www_request_finish(node, opts, req, curl_easy_perform(req->connection->curl));
+}
 
-        if(0 == n)
-            return    false;
-    }
+/*
+ * www_rows_slot
+ *   slot for rows of tuplestore: scan tuple slot,
+ *   or one with raw tokens of deferred columns after them
+ */
+static TupleTableSlot *
+www_rows_slot(ForeignScanState *node)
+{
+    WWWScanState    *scan = (WWWScanState *) node->fdw_state;
 
-    return    true;
+    return scan && scan->raw_slot ? scan->raw_slot : node->ss.ss_ScanTupleSlot;
 }
 
 /*
- * json_get_result_array_in_tree
- *    find the result array in json response structure
- *    check json_check_result_array for valid array description
-*/
-static
-JSONNode*
-json_get_result_array_in_tree(JSONNode* root, TupleDesc tuple_desc)
+ * www_reply_append
+ *   Append rows of part to reply, returns reply (part if reply is NULL)
+ *   size - allocated tuples of reply
+ *   slot - rows of tuplestore are moved through it (see www_rows_slot)
+ */
+static Reply *
+www_reply_append(Reply *reply, uint32 *size, Reply *part, TupleTableSlot *slot)
 {
-    JSONNode*    suspect    = NULL;
-    List        *curr    = list_make1(root),
-                *next    = NULL;
-    ListCell*    cell;
-    int            i;
+    int         i;
 
-    while(curr) {
-        foreach(cell, curr)
+    if (NULL == reply)
+    {
+        *size = part->ntuples;
+        return part;
+    }
+
+    if (reply->store)
+    {
+        for (i = 0; i < part->ntuples; i++)
         {
-            suspect    = (JSONNode*)(cell->data.ptr_value);
-            switch (suspect->type)
+            if (part->store)
             {
-                case JSON_OBJECT_BEGIN:
-                    for( i=0; i<suspect->length; i++ )
-                        next    = lappend( next, (void*)(&(suspect->val.val_object[i])) );
-                    break;
-                case JSON_ARRAY_BEGIN:
-                    /* check array to be valid answer */
-                    if(json_check_result_array(suspect, tuple_desc))
-                    {
-                        /* free structure */
-                        list_free(curr);
-                        list_free(next);
-                        return    suspect;
-                    }
-                    for( i=0; i<suspect->length; i++ )
-                        next    = lappend( next, (void*)(&(suspect->val.val_array[i])) );
-                    break;
-                case JSON_STRING:
-                case JSON_INT:
-                case JSON_FLOAT:
-                case JSON_NULL:
-                case JSON_TRUE:
-                case JSON_FALSE:
-                    break;
-                /* for removing warning */
-                case JSON_NONE:
-                case JSON_KEY:
-                case JSON_ARRAY_END:
-                case JSON_OBJECT_END:
-                    break;
+                tuplestore_gettupleslot(part->store, true, false, slot);
+                tuplestore_puttupleslot(reply->store, slot);
             }
+            else
+                tuplestore_puttuple(reply->store, part->tuples[i]);
         }
+        ExecClearTuple(slot);
+        reply->ntuples += part->ntuples;
+        www_reply_free_rows(part);
+        return reply;
+    }
 
-        list_free(curr);
-        curr    = next;
-        next    = NULL;
+    if (reply->ntuples + part->ntuples > *size)
+    {
+        *size = Max(*size * 2, reply->ntuples + part->ntuples);
+        reply->tuples = reply->tuples
+            ? (HeapTuple *) repalloc(reply->tuples, *size * sizeof(HeapTuple))
+            : (HeapTuple *) palloc(*size * sizeof(HeapTuple));
+        if (reply->raw)
+            reply->raw = (char **) repalloc(reply->raw, *size * sizeof(char *));
+    }
+    /* raw tokens of deferred columns go along with tuples */
+    if (part->raw && !reply->raw)
+        reply->raw = (char **) palloc0(*size * sizeof(char *));
+    for (i = 0; i < part->ntuples; i++)
+    {
+        if (reply->raw)
+            reply->raw[reply->ntuples] = part->raw ? part->raw[i] : NULL;
+        reply->tuples[reply->ntuples++] = part->store ? www_reply_tuple(part, slot) : part->tuples[i];
     }
+    www_reply_free_rows(part);
 
-    return    NULL;
+    return reply;
 }
 
-static
-Datum
-make_text_data(StringInfoData *str)
+/*
+ * www_multi_check
+ *   raise error of curl multi interface call (action - what has failed)
+ */
+static void
+www_multi_check(CURLMcode mret, const char *action)
 {
-    text *t    = (text*)palloc(VARHDRSZ + str->len);
-    SET_VARSIZE(t, VARHDRSZ + str->len);
-    memcpy(t->vl_dat, str->data, str->len);
-
-    return PointerGetDatum(t);
+    if (CURLM_OK != mret)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+            errmsg("%s: %s", action, curl_multi_strerror(mret))
+            ));
 }
 
 /*
- * call_response_deserialize_callback
- * call to response_deserialize_callback for "xml" response_type
- * prepare/setup reply structure from it's answer
+ * www_request_fanout
+ *   Query search API concurrently, one request per fan-out parameter,
+ *   at most concurrency transfers run at a time
+ *   rows of responses are concatenated in order of fan-out parameters (ordered)
+ *   or in order of their arrival
+ *   params - additional url parameters of all requests, NULL - none
  */
-static
-Reply*
-call_response_deserialize_callback(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, StringInfoData *buffer)
+static Reply *
+www_request_fanout(ForeignScanState *node, WWW_fdw_options *opts, const char *params, List *fanout,
+                   int concurrency, bool ordered)
 {
-    int        res, i,j, natts;
-    StringInfoData    cmd;
-    Oid        opts_argtypes[2]    = { opts_type, TEXTOID };
-    Datum    opts_values[2];
-    Reply    *reply;
-    Relation        rel;
-    AttInMetadata    *attinmeta;
-    char            **values    = NULL,
-        **names    = NULL;
-    int16            *columns;
-    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
-    bool            use_libxml    = false;
-    xmltype            *xml;
-
-    opts_values[0]    = opts_value;
-
-    rel = node->ss.ss_currentRelation;
-    attinmeta = TupleDescGetAttInMetadata(rel->rd_att);
-
-    SPI_connect_wrapper();
-
-    opts_values[1]    = make_text_data(buffer);
+    int         nrequests = list_length(fanout);
+    WWWRequest  **reqs = (WWWRequest **) palloc0(nrequests * sizeof(WWWRequest *));
+    Reply       **parts = (Reply **) palloc0(nrequests * sizeof(Reply *));
+    Reply       *reply = NULL;
+    uint32      size = 0;
+    CURLM       *multi = curl_multi_init();
+    ListCell    *lc = list_head(fanout);
+    volatile int    started = 0;    /* read after error */
+    int         running = 0,
+                finished = 0,
+                appended = 0,
+                i;
+
+    if (NULL == multi)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+            errmsg("Can't initialize curl multi handle")
+            ));
 
-#ifdef USE_LIBXML
-    d("compiled with xml support, passing xml data type to callback");
-    use_libxml = true;
-#else
-    d("compiled without xml support, passing text data type to callback");
-#endif
+    d("Fan-out of %i requests, %i at a time", nrequests, concurrency);
 
-    if(use_libxml && 0 == strcmp("xml", opts->response_type))
+    PG_TRY();
     {
-        opts_argtypes[1] = XMLOID;
-        /* parses xml variable
-         * it parses/checks xml string and returns casted variable
-         */
-        xml    = xmlparse((text*)DatumGetPointer(opts_values[1]), XMLOPTION_DOCUMENT, true);
-        opts_values[1]    = XmlPGetDatum(xml);
-    }
-
-    /* do callback */
-    initStringInfo(&cmd);
-    appendStringInfo(&cmd, "SELECT * FROM %s($1,$2)", opts->response_deserialize_callback);
-
-    d("calling response_deserialize_callback: '%s'", opts->response_deserialize_callback);
+        while (finished < nrequests)
+        {
+            CURLMsg     *msg;
+            int         active,
+                        queued;
 
-    res    = SPI_execute_with_args(cmd.data, 2, opts_argtypes, opts_values, NULL, true, 0);
-    if(0 > res)
-    {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("Can't execute response_deserialize_callback '%s': %i (%s)", opts->response_deserialize_callback, res, describe_spi_code(res))
-            )
-        );
-    }
+            /* keep concurrency transfers running */
+            while (running < concurrency && started < nrequests)
+            {
+                StringInfoData  url_params;
+                WWWRequest      *req = (WWWRequest *) palloc0(sizeof(WWWRequest));
+
+                initStringInfo(&url_params);
+                appendStringInfoString(&url_params, strVal(lfirst(lc)));
+                if (params && *params)
+                    appendStringInfo(&url_params, "&%s", params);
+
+                www_request_start(node, opts, url_params.data, false, req);
+                curl_easy_setopt(req->connection->curl, CURLOPT_PRIVATE, (char *) req);
+                reqs[started++] = req;
+                www_multi_check(curl_multi_add_handle(multi, req->connection->curl),
+                                "Can't start request");
+                running++;
+                lc = lnext(lc);
+            }
 
-    /* save result to output parameters */
-    /* allocate it in proper memory context */
-    reply        = (Reply*)SPI_palloc(sizeof(Reply));
-    reply->ntuples    = SPI_processed;
-    reply->tuple_index    = 0;
-    reply->options        = opts;
-    reply->opts_type    = opts_type;
-    reply->opts_value    = opts_value;
-    /* copy tuples structure: there can be further calls to SPI_exec* */
-    reply->tuples    = (HeapTuple*)SPI_palloc(reply->ntuples * sizeof(HeapTuple));
+            www_multi_check(curl_multi_perform(multi, &active), "Can't get a response from server");
 
-    /* find correspondence between returned columns and columns we need to return */
-    natts = rel->rd_att->natts;
-    columns    = (int16*)palloc(natts * sizeof(int16));
-    names    = (char**)palloc(SPI_tuptable->tupdesc->natts * sizeof(char*));
-    for( i=1; i<=SPI_tuptable->tupdesc->natts; i++ )
-        names[i-1]    = SPI_fname(SPI_tuptable->tupdesc, i);
+            while ((msg = curl_multi_info_read(multi, &queued)))
+            {
+                WWWRequest  *req;
+                char        *priv;
+                CURLcode    result = msg->data.result;
+                CURL        *curl = msg->easy_handle;
+                int         index = 0;
+
+                if (CURLMSG_DONE != msg->msg)
+                    continue;
+
+                curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+                req = (WWWRequest *) priv;
+                curl_multi_remove_handle(multi, curl);
+                running--;
+                finished++;
+                /* connection goes back to the pool in www_request_finish */
+                for (i = 0; i < started; i++)
+                    if (reqs[i] == req)
+                    {
+                        reqs[i] = NULL;
+                        index = i;
+                    }
 
-    /* find column places */
-    for( i=0; i<natts; i++ )
-    {
-        columns[i]    = -1;
+                parts[index] = www_request_finish(node, opts, req, result);
+                if (!ordered)
+                {
+                    reply = www_reply_append(reply, &size, parts[index], www_rows_slot(node));
+                    continue;
+                }
+                /* rows of responses before this one are appended already */
+                while (appended < started && parts[appended])
+                    reply = www_reply_append(reply, &size, parts[appended++], www_rows_slot(node));
+            }
 
-        for( j=0; j<SPI_tuptable->tupdesc->natts; j++ )
-        {
-            if(0 == namestrcmp(&rel->rd_att->attrs[i]->attname, names[j]))
+            if (finished < nrequests)
             {
-                columns[i]    = j+1;
-                break;
+                www_multi_check(curl_multi_wait(multi, NULL, 0, 1000, NULL),
+                                "Can't wait for a response from server");
+                CHECK_FOR_INTERRUPTS();
             }
         }
     }
-    pfree(names);
-
-    /* fill column values */
-    values = (char **) palloc(sizeof(char *) * natts);
-    for( i=0; i<reply->ntuples; i++ )
+    PG_CATCH();
     {
-        for( j=0; j<natts; j++ )
-        {
-            if(-1 == columns[j])
-                values[j]    = NULL;
-            else
-                values[j]    = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, columns[j]);
-        }
-
-        /* build tuple in proper memory context */
-        spimctxt = MemoryContextSwitchTo(mctxt);
-        reply->tuples[i] = BuildTupleFromCStrings(attinmeta, values);
-        MemoryContextSwitchTo(spimctxt);
-
-        /* free strings immediately, w/o losing track of them */
-        for( j=0; j<natts; j++ )
-            if(NULL != values[j])
-                SPI_pfree(values[j]);
+        /* unfinished transfers are dropped, their handles are closed on abort */
+        for (i = 0; i < started; i++)
+            if (reqs[i])
+                curl_multi_remove_handle(multi, reqs[i]->connection->curl);
+        curl_multi_cleanup(multi);
+        PG_RE_THROW();
     }
-    pfree(values);
-
-    pfree(columns);
-
-    SPI_finish_wrapper();
+    PG_END_TRY();
 
-    return    reply;
+    curl_multi_cleanup(multi);
+    return reply;
 }
 
 /*
- * get_www_fdw_options
- * get Oid for options type, set up Datum value for it properly
- * will be used to pass it to callbacks
+ * www_page_params
+ *   Url parameters of numbered page (page_number_param or page_offset_param),
+ *   page - number of the page starting with 1
  */
-static
-void
-get_www_fdw_options(WWW_fdw_options *opts, Oid *opts_type, Datum *opts_value)
+static char *
+www_page_params(WWW_fdw_options *opts, long page)
 {
-    Datum    data[1];
-    bool    isnull[1]    = {false};
-    int        res;
-    char*    options[]    = {
-        opts->uri,
-        opts->uri_select,
-        opts->uri_insert,
-        opts->uri_delete,
-        opts->uri_update,
-        opts->uri_callback,
-
-        opts->method_select,
-        opts->method_insert,
-        opts->method_delete,
-        opts->method_update,
-
-        opts->request_user_agent,
-        opts->request_user_header,
-        opts->request_serialize_callback,
-        opts->request_serialize_type,
-        opts->request_serialize_human_readable,
-
-        opts->response_type,
-        opts->response_deserialize_callback,
-        opts->response_iterate_callback,
+    StringInfoData  params;
 
-        opts->ssl_cert,
-        opts->ssl_key,
-        opts->cainfo,
-        opts->proxy,
-        opts->cookie,
-        opts->username,
-        opts->password
-    };
-    TupleDesc        tuple_desc;
-    AttInMetadata*    aim;
-    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
+    initStringInfo(&params);
+    if (opts->page_number_param)
+        appendStringInfo(&params, "%s=%ld", opts->page_number_param, page);
+    else
+        appendStringInfo(&params, "%s=%ld", opts->page_offset_param, (page - 1) * opts->per_page);
+    if (opts->page_size_param)
+        appendStringInfo(&params, "&%s=%i", opts->page_size_param, opts->per_page);
 
-    SPI_connect_wrapper();
-    /* read following:
-     * http://wiki.postgresql.org/wiki/Developer_FAQ#How_do_I_efficiently_access_information_in_system_catalogs_from_the_backend_code.3F
-     * may be it makes sense reimplementing following select
-     */
-    res    = SPI_execute("SELECT t.oid,t.typname,t.typnamespace FROM pg_type t join pg_namespace ns ON t.typnamespace=ns.oid WHERE t.typname='wwwfdwoptions'", true, 0);
-    if(0 > res)
+    return params.data;
+}
+
+/*
+ * www_request_pages
+ *   Query search API for numbered pages: first page is requested alone,
+ *   number of pages is taken from total count of rows in it (page_total_path),
+ *   the rest are requested concurrently (request_concurrency at a time)
+ *   rows are returned in page order or in order of arrival (page_ordered)
+ *   limit - rows needed by the scan, 0 - all
+ */
+static Reply *
+www_request_pages(ForeignScanState *node, WWW_fdw_options *opts, long limit)
+{
+    WWWRequest  *req = (WWWRequest *) palloc0(sizeof(WWWRequest));
+    Reply       *reply,
+                *rest;
+    uint32      size;
+    long        total = 0,
+                npages,
+                page;
+    char        *end;
+
+    www_request_start(node, opts, www_page_params(opts, 1), false, req);
+    reply = www_request_finish(node, opts, req, curl_easy_perform(req->connection->curl));
+
+    if (NULL == req->total)
     {
-        ereport(ERROR,
-                (
-                    errcode(ERRCODE_SYNTAX_ERROR),
-                    errmsg("Can't identify WWW_fdw_options OID: %i (%s)", res, describe_spi_code(res))
-                    )
-            );
+        d("Total count isn't found in first page");
+        return reply;
     }
 
-    if(1 == SPI_processed)
-    {
-        heap_deform_tuple(*(SPI_tuptable->vals), SPI_tuptable->tupdesc, data, isnull);
-        /* Oid is typedef for unsigned int, value will be copied */
-        *opts_type    = (Oid)(data[0]);
+    errno = 0;
+    total = strtol(req->total, &end, 10);
+    if (0 != errno || end == req->total || 0 > total)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+            errmsg("Invalid total count of rows in response: %s", req->total)
+            ));
 
-        tuple_desc    = TypeGetTupleDesc(*opts_type, NIL);
-        aim            = TupleDescGetAttInMetadata(tuple_desc);
+    npages = (total + opts->per_page - 1) / opts->per_page;
+    if (0 < opts->max_pages && npages > opts->max_pages)
+        npages = opts->max_pages;
+    /* pages after rows needed by LIMIT aren't requested */
+    if (0 < limit && npages > (limit + opts->per_page - 1) / opts->per_page)
+        npages = (limit + opts->per_page - 1) / opts->per_page;
 
-        /* switch to memory context before spi for saving value */
-        spimctxt = MemoryContextSwitchTo(mctxt);
-        *opts_value    = HeapTupleGetDatum( BuildTupleFromCStrings(aim, options) );
-        MemoryContextSwitchTo(spimctxt);
+    d("Total count %ld, %ld pages", total, npages);
 
-        SPI_finish_wrapper();
-        return;
-    }
-    else
+    /* short first page: there are no more rows, whatever total says */
+    if (reply->ntuples < opts->per_page)
+        return reply;
+
+    /*
+     * pages are requested WWW_PAGE_BATCH at a time, so huge total
+     * doesn't allocate parameters of all pages at once and requests stop
+     * at the first short batch (rows are over before total count)
+     */
+    size = reply->ntuples;
+    for (page = 2; page <= npages; page += WWW_PAGE_BATCH)
     {
-        ereport(ERROR,
-                (
-                    errcode(ERRCODE_SYNTAX_ERROR),
-                    errmsg("Can't identify WWW_fdw_options OID: not exactly 1 result was returned (%d)", SPI_processed)
-                    )
-            );
+        List        *pages = NIL;
+        ListCell    *lc;
+        long        last = Min(npages, page + WWW_PAGE_BATCH - 1),
+                    i;
+        uint32      nrows;
+
+        for (i = page; i <= last; i++)
+            pages = lappend(pages, makeString(www_page_params(opts, i)));
+
+        rest = www_request_fanout(node, opts, NULL, pages, Max(1, opts->concurrency), opts->ordered);
+        foreach(lc, pages)
+            pfree(strVal(lfirst(lc)));
+        list_free_deep(pages);
+
+        nrows = rest ? rest->ntuples : 0;
+        if (rest)
+            reply = www_reply_append(reply, &size, rest, www_rows_slot(node));
+        if (nrows < (last - page + 1) * opts->per_page)
+            break;
     }
 
-    SPI_finish_wrapper();
+    return reply;
 }
 
 /*
- * get_www_fdw_post_parameters
- * get Oid for WWWFdwPostParameters type, set up Datum value for it properly
- * will be used to pass it to callbacks
+ * www_scan_request
+ *   Query search API for the scan: single request
+ *   or concurrent requests for values of fanned out IN list
+ *   or for numbered pages
  */
-static
-void
-get_www_fdw_post_parameters(PostParameters *post, Oid *post_type, Datum *post_value)
+static Reply *
+www_scan_request(ForeignScanState *node, WWWScanState *scan, const char *join_params)
 {
-    Datum    data[1];
-    bool    isnull[1]    = {false};
-    int        res;
-    char*    postparams[]    = {
-        post->post ? "t" : "f",
-        post->data.data,
-        post->content_type.data
-    };
-    TupleDesc        tuple_desc;
-    AttInMetadata*    aim;
-    MemoryContext    mctxt = CurrentMemoryContext, spimctxt;
+    /* fan-out array has no values to ask for */
+    if (NULL != scan->fanout_expr && NIL == scan->fanout)
+        return NULL;
+    if (NULL == join_params && NIL == scan->fanout && scan->opts->offset_paged && !scan->opts->stream)
+        return www_request_pages(node, scan->opts, scan->limit);
+    if (NIL != scan->fanout)
+        return www_request_fanout(node, scan->opts, join_params, scan->fanout, scan->opts->concurrency, false);
+    return www_request(node, scan->opts, join_params);
+}
 
-    SPI_connect_wrapper();
-    /* read following:
-     * http://wiki.postgresql.org/wiki/Developer_FAQ#How_do_I_efficiently_access_information_in_system_catalogs_from_the_backend_code.3F
-     * may be it makes sense reimplementing following select
-     */
-    res    = SPI_execute("SELECT t.oid,t.typname,t.typnamespace FROM pg_type t join pg_namespace ns ON t.typnamespace=ns.oid WHERE t.typname='wwwfdwpostparameters'", true, 0);
-    if(0 > res)
+/*
+ * www_is_paged
+ *   scan follows cursors of next pages: not parameterized, not fanned out
+ *   and not streamed requests only
+ */
+static bool
+www_is_paged(WWWScanState *scan)
+{
+    return scan->opts->paged && !scan->opts->stream && NIL == scan->param_exprs
+           && NIL == scan->fanout && NULL == scan->fanout_expr;
+}
+
+/*
+ * www_url_resolve
+ *   url reference (e.g. cursor of the next page) resolved against base url
+ *   as RFC 3986 describes: absolute one is taken as is, "/path", "?query",
+ *   "//host/path" and "path" are relative to the base
+ */
+static char *
+www_url_resolve(const char *base, const char *ref)
+{
+#if LIBCURL_VERSION_NUM >= 0x073e00
+    CURLU       *handle = curl_url();
+    char        *resolved = NULL;
+    char        *url;
+
+    if (NULL == handle)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+            errmsg("Can't allocate url handle")
+            ));
+
+    if (CURLUE_OK != curl_url_set(handle, CURLUPART_URL, base, 0)
+        || CURLUE_OK != curl_url_set(handle, CURLUPART_URL, ref, 0)
+        || CURLUE_OK != curl_url_get(handle, CURLUPART_URL, &resolved, 0))
     {
+        curl_url_cleanup(handle);
         ereport(ERROR,
-                (
-                    errcode(ERRCODE_SYNTAX_ERROR),
-                    errmsg("Can't identify WWWFdwPostParameters OID: %i (%s)", res, describe_spi_code(res))
-                    )
-            );
+            (errcode(ERRCODE_FDW_ERROR),
+            errmsg("Can't resolve url '%s' of the next page against '%s'", ref, base)
+            ));
     }
 
-    if(1 == SPI_processed)
+    url = pstrdup(resolved);
+    curl_free(resolved);
+    curl_url_cleanup(handle);
+    return url;
+#else
+    /* libcurl before 7.62 has no url api: merge without removal of dot segments */
+    const char  *scheme_end = strstr(base, "://");
+    const char  *path,
+                *end;
+    StringInfoData  url;
+    const char  *c;
+
+    for (c = ref; isalnum((unsigned char) *c) || '+' == *c || '-' == *c || '.' == *c; c++)
+        ;
+    if (c > ref && ':' == *c)
+        return pstrdup(ref);
+    if (NULL == scheme_end)
+        return pstrdup(ref);
+
+    path = base + strcspn(scheme_end + 3, "/?#") + (scheme_end + 3 - base);
+    initStringInfo(&url);
+    if ('/' == ref[0] && '/' == ref[1])
+        appendBinaryStringInfo(&url, base, scheme_end + 1 - base);
+    else if ('/' == *ref)
+        appendBinaryStringInfo(&url, base, path - base);
+    else if ('?' == *ref || '#' == *ref)
+    {
+        end = path + strcspn(path, '?' == *ref ? "?#" : "#");
+        appendBinaryStringInfo(&url, base, end - base);
+    }
+    else
     {
-        heap_deform_tuple(*(SPI_tuptable->vals), SPI_tuptable->tupdesc, data, isnull);
-        /* Oid is typedef for unsigned int, value will be copied */
-        *post_type    = (Oid)(data[0]);
+        /* up to the last segment of base path */
+        end = path + strcspn(path, "?#");
+        while (end > path && '/' != end[-1])
+            end--;
+        appendBinaryStringInfo(&url, base, end - base);
+        if (end == path)
+            appendStringInfoChar(&url, '/');
+    }
+    appendStringInfoString(&url, ref);
+    return url.data;
+#endif
+}
 
-        tuple_desc    = TypeGetTupleDesc(*post_type, NIL);
-        aim            = TupleDescGetAttInMetadata(tuple_desc);
+/*
+ * www_url_origin
+ *   "scheme://host:port" of url (lower case, default port of http/https),
+ *   NULL - url isn't http/https one
+ */
+static char *
+www_url_origin(const char *url)
+{
+#if LIBCURL_VERSION_NUM >= 0x073e00
+    CURLU       *handle = curl_url();
+    char        *scheme = NULL,
+                *host = NULL,
+                *port = NULL,
+                *origin = NULL,
+                *c;
+
+    if (NULL == handle)
+        ereport(ERROR,
+            (errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+            errmsg("Can't allocate url handle")
+            ));
 
-        /* switch to memory context before spi for saving value */
-        spimctxt = MemoryContextSwitchTo(mctxt);
-        *post_value    = HeapTupleGetDatum( BuildTupleFromCStrings(aim, postparams) );
-        MemoryContextSwitchTo(spimctxt);
+    if (CURLUE_OK == curl_url_set(handle, CURLUPART_URL, url, 0)
+        && CURLUE_OK == curl_url_get(handle, CURLUPART_SCHEME, &scheme, 0)
+        && CURLUE_OK == curl_url_get(handle, CURLUPART_HOST, &host, 0)
+        && CURLUE_OK == curl_url_get(handle, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT)
+        && (0 == pg_strcasecmp(scheme, "http") || 0 == pg_strcasecmp(scheme, "https")))
+    {
+        StringInfoData  buf;
 
-        SPI_finish_wrapper();
-        return;
+        initStringInfo(&buf);
+        appendStringInfo(&buf, "%s://%s:%s", scheme, host, port);
+        origin = buf.data;
     }
+
+    curl_free(scheme);
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(handle);
+    for (c = origin; c && *c; c++)
+        *c = tolower((unsigned char) *c);
+    return origin;
+#else
+    const char  *scheme_end = strstr(url, "://");
+    const char  *host,
+                *end,
+                *port;
+    char        *origin,
+                *c;
+    bool        https;
+    StringInfoData  buf;
+
+    if (NULL == scheme_end)
+        return NULL;
+    if (4 == scheme_end - url && 0 == pg_strncasecmp(url, "http", 4))
+        https = false;
+    else if (5 == scheme_end - url && 0 == pg_strncasecmp(url, "https", 5))
+        https = true;
     else
+        return NULL;
+
+    /* authority without user info */
+    host = scheme_end + 3;
+    end = host + strcspn(host, "/?#");
+    for (c = (char *) host; c < end; c++)
+        if ('@' == *c)
+            host = c + 1;
+    /* port follows ipv6 address in brackets */
+    for (c = (char *) host; c < end && ']' != *c; c++)
+        ;
+    port = memchr(c < end ? c : host, ':', end - (c < end ? c : host));
+    initStringInfo(&buf);
+    appendStringInfo(&buf, "%s://", https ? "https" : "http");
+    appendBinaryStringInfo(&buf, host, (port ? port : end) - host);
+    if (port && port + 1 < end)
     {
-        ereport(ERROR,
-                (
-                    errcode(ERRCODE_SYNTAX_ERROR),
-                    errmsg("Can't identify WWWFdwPostParameters OID: not exactly 1 result was returned (%d)", SPI_processed)
-                    )
-            );
+        appendStringInfoChar(&buf, ':');
+        appendBinaryStringInfo(&buf, port + 1, end - port - 1);
     }
+    else
+        appendStringInfoString(&buf, https ? ":443" : ":80");
+    origin = buf.data;
 
-    SPI_finish_wrapper();
+    for (c = origin; *c; c++)
+        *c = tolower((unsigned char) *c);
+    return origin;
+#endif
 }
 
 /*
- * json2string
- * convert JSONNode* element to string
+ * www_page_url
+ *   url of the page after done one, NULL - done page is the last one
+ *   cursor is url (absolute or relative to uri) or value of page_next_param
  */
-static
-char*
-json2string(JSONNode* json)
+static char *
+www_page_url(WWWScanState *scan, WWWRequest *done)
 {
-    StringInfoData buf;
+    WWW_fdw_options *opts = scan->opts;
+    StringInfoData  url;
+
+    if (NULL == done->next || '\0' == *done->next
+        || (0 < opts->max_pages && scan->npages >= opts->max_pages)
+        || (0 < scan->limit && scan->nrows >= scan->limit))
+        return NULL;
 
-    switch (json->type)
+    initStringInfo(&url);
+    if (opts->page_next_param)
+        appendStringInfo(&url, "%s%c%s=%s", scan->page_url, strchr(scan->page_url, '?') ? '&' : '?',
+                         opts->page_next_param, percent_encode((unsigned char *) done->next, -1));
+    else
     {
-        case JSON_OBJECT_BEGIN:
-        case JSON_ARRAY_BEGIN:
-            return    NULL;
-            break;
-        case JSON_STRING:
-            return    json->val.val_string;
-        case JSON_INT:
-            initStringInfo(&buf);
-            appendStringInfo(&buf, "%i", json->val.val_int);
-            return    buf.data;
-        case JSON_FLOAT:
-            initStringInfo(&buf);
-            appendStringInfo(&buf, "%f", json->val.val_float);
-            return    buf.data;
-        case JSON_NULL:
-            return    "null";
-        case JSON_TRUE:
-            return    "true";
-        case JSON_FALSE:
-            return    "false";
-        /* for removing warning */
-        case JSON_NONE:
-        case JSON_KEY:
-        case JSON_ARRAY_END:
-        case JSON_OBJECT_END:
-            break;
+        char    *origin = www_url_origin(scan->page_url);
+        char    *next_origin;
+
+        appendStringInfoString(&url, www_url_resolve(done->url.data, done->next));
+        /* request of the page carries credentials of the server (cookie, certificate, password) */
+        next_origin = www_url_origin(url.data);
+        if (NULL == next_origin || NULL == origin || 0 != strcmp(origin, next_origin))
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_ERROR),
+                errmsg("Url of the next page '%s' isn't on the server of the first page '%s'",
+                       url.data, scan->page_url),
+                errhint("Next page is requested with the same scheme (http or https), host and port only.")
+                ));
     }
-    return    NULL;
+
+    /* server returns the same page again */
+    if (0 == strcmp(url.data, done->url.data))
+        return NULL;
+
+    return url.data;
 }
 
 /*
- * prepare_xml_result
- * go through parsed result and prepare reply/result structure
+ * www_page_start
+ *   start request of the page after done one (prefetch):
+ *   its transfer goes on while rows of current page are returned
  */
-static
-Reply*
-prepare_xml_result(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, xmlDocPtr doc)
+static void
+www_page_start(ForeignScanState *node, WWWScanState *scan, WWWRequest *done)
 {
-    xmlNodePtr    result    = NULL,
-        it = NULL,
-        itc= NULL;
-    Relation    rel;
-    AttInMetadata    *attinmeta;
-    Reply            *reply;
-    xmlChar            **attnames;
-    int                i,j, natts;
-    char            **values    = NULL;
+    char            *url = www_page_url(scan, done);
+    MemoryContext   oldcontext;
+    WWWRequest      *req;
+    int             active;
 
-    rel = node->ss.ss_currentRelation;
-    attinmeta = TupleDescGetAttInMetadata(rel->rd_att);
+    if (NULL == url)
+        return;
 
-    result    = xml_get_result_array_in_doc(doc, rel->rd_att);
-    if(!result)
+    if (NULL == scan->page_multi && NULL == (scan->page_multi = curl_multi_init()))
         ereport(ERROR,
-                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-                 errmsg("Can't find result in parsed server's xml response")
-                    ));
+            (errcode(ERRCODE_FDW_OUT_OF_MEMORY),
+            errmsg("Can't initialize curl multi handle")
+            ));
 
-    d("Result array was found in xml response");
+    /* page memory is freed, when next page replaces it */
+    scan->page_cxt = AllocSetContextCreate(node->ss.ps.ps_ExprContext->ecxt_per_query_memory,
+                                           "www_fdw page",
+                                           ALLOCSET_DEFAULT_MINSIZE,
+                                           ALLOCSET_DEFAULT_INITSIZE,
+                                           ALLOCSET_DEFAULT_MAXSIZE);
+    oldcontext = MemoryContextSwitchTo(scan->page_cxt);
+
+    req = (WWWRequest *) palloc0(sizeof(WWWRequest));
+    initStringInfo(&req->url);
+    appendStringInfoString(&req->url, url);
+    req->post = done->post;
+    req->opts_type = done->opts_type;
+    req->opts_value = done->opts_value;
+    www_request_setup(node, scan->opts, false, req);
+    /* url of the page comes from the response: no other protocols */
+#if LIBCURL_VERSION_NUM >= 0x075500
+    curl_easy_setopt(req->connection->curl, CURLOPT_PROTOCOLS_STR, "http,https");
+    curl_easy_setopt(req->connection->curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+#else
+    curl_easy_setopt(req->connection->curl, CURLOPT_PROTOCOLS, (long) (CURLPROTO_HTTP | CURLPROTO_HTTPS));
+    curl_easy_setopt(req->connection->curl, CURLOPT_REDIR_PROTOCOLS, (long) (CURLPROTO_HTTP | CURLPROTO_HTTPS));
+#endif
 
-    /* save result */
-    reply = (Reply*)palloc(sizeof(Reply));
-    reply->tuple_index = 0;
-    reply->options = opts;
-    reply->opts_type = opts_type;
-    reply->opts_value = opts_value;
+    scan->page = req;
+    www_multi_check(curl_multi_add_handle(scan->page_multi, req->connection->curl),
+                    "Can't start request");
+    www_multi_check(curl_multi_perform(scan->page_multi, &active), "Can't get a response from server");
 
-    /* calculate number of results */
-    reply->ntuples = 0;
-    for( it = result->children; NULL != it; it = it->next )
-        reply->ntuples++;
+    MemoryContextSwitchTo(oldcontext);
+}
 
-    reply->tuples = (0 == reply->ntuples) ?
-        NULL :
-        (HeapTuple*)palloc(reply->ntuples * sizeof(HeapTuple));
+/*
+ * www_page_first
+ *   request first page and start prefetch of the next one
+ */
+static Reply *
+www_page_first(ForeignScanState *node, WWWScanState *scan)
+{
+    MemoryContext   oldcontext = MemoryContextSwitchTo(node->ss.ps.ps_ExprContext->ecxt_per_query_memory);
+    WWWRequest      *req = (WWWRequest *) palloc0(sizeof(WWWRequest));
+    Reply           *reply;
 
-    /* prepare result column names in xmlChar* for proper comparison */
-    natts = rel->rd_att->natts;
-    attnames    = (xmlChar**)palloc(natts * sizeof(xmlChar*));
-    for (i = 0; i < natts; i++)
-        attnames[i]    = xmlCharStrndup(rel->rd_att->attrs[i]->attname.data, strlen(rel->rd_att->attrs[i]->attname.data));
+    www_request_start(node, scan->opts, NULL, false, req);
+    reply = www_request_finish(node, scan->opts, req, curl_easy_perform(req->connection->curl));
+    scan->page_url = req->url.data;
+    scan->npages = 1;
+    scan->nrows = reply->ntuples;
+    www_page_start(node, scan, req);
 
-    /* find column places */
-    values = (char **) palloc(sizeof(char *) * natts);
-    for( it = result->children, j=0 ; NULL != it; it = it->next, j++ )
+    MemoryContextSwitchTo(oldcontext);
+    return reply;
+}
+
+/*
+ * www_page_perform
+ *   let transfer of the next page progress without waiting
+ */
+static void
+www_page_perform(WWWScanState *scan)
+{
+    MemoryContext   oldcontext = MemoryContextSwitchTo(scan->page_cxt);
+    int             active;
+
+    www_multi_check(curl_multi_perform(scan->page_multi, &active), "Can't get a response from server");
+    MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * www_page_wait
+ *   wait for the next page, it replaces current one,
+ *   prefetch of the page after it is started
+ */
+static Reply *
+www_page_wait(ForeignScanState *node, WWWScanState *scan)
+{
+    WWWRequest      *req = scan->page;
+    MemoryContext   oldcontext = MemoryContextSwitchTo(scan->page_cxt);
+    CURLcode        result = CURLE_OK;
+    bool            done = false;
+    Reply           *reply;
+
+    while (!done)
     {
-        for (i = 0; i < natts; i++)
-        {
-            for( itc = it->children; NULL != itc; itc = itc->next )
-                if(1 == xmlStrEqual(attnames[i], itc->name))
-                    break;
+        CURLMsg     *msg;
+        int         active,
+                    queued;
 
-            if(itc)
-                values[i]    = (char*)itc->children->content;
-            else
-                values[i]    = NULL;
+        www_multi_check(curl_multi_perform(scan->page_multi, &active), "Can't get a response from server");
+        while ((msg = curl_multi_info_read(scan->page_multi, &queued)))
+        {
+            if (CURLMSG_DONE == msg->msg)
+            {
+                result = msg->data.result;
+                done = true;
+            }
         }
 
-        reply->tuples[j] = BuildTupleFromCStrings(attinmeta, values);
+        if (!done)
+        {
+            www_multi_check(curl_multi_wait(scan->page_multi, NULL, 0, 1000, NULL),
+                            "Can't wait for a response from server");
+            CHECK_FOR_INTERRUPTS();
+        }
     }
-    pfree(values);
 
-    pfree(attnames);
+    curl_multi_remove_handle(scan->page_multi, req->connection->curl);
+    scan->page = NULL;
+    reply = www_request_finish(node, scan->opts, req, result);
+    scan->npages++;
+    scan->nrows += reply->ntuples;
+    MemoryContextSwitchTo(oldcontext);
 
-    return    reply;
+    d("Page %i is received", scan->npages);
+
+    /* rows of previous page were returned already */
+    www_reply_free_rows(scan->reply);
+    if (scan->reply_cxt)
+        MemoryContextDelete(scan->reply_cxt);
+    scan->reply_cxt = scan->page_cxt;
+    scan->page_cxt = NULL;
+
+    www_page_start(node, scan, req);
+    return reply;
 }
 
 /*
- * prepare_json_result
- * go through parsed result and prepare reply/result structure
+ * www_page_drop
+ *   stop prefetch of the next page, its connection isn't reused
+ *   (state of interrupted transfer is unknown)
  */
-static
-Reply*
-prepare_json_result(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, JSONNode *root)
+static void
+www_page_drop(WWWScanState *scan)
 {
-    JSONNode        *result, json_obj;
-    Relation        rel;
-    AttInMetadata    *attinmeta;
-    Reply            *reply;
-    int                i,j,k, natts;
-    char            **values    = NULL;
-
-    rel = node->ss.ss_currentRelation;
-    attinmeta = TupleDescGetAttInMetadata(rel->rd_att);
+    if (scan->page)
+    {
+        curl_multi_remove_handle(scan->page_multi, scan->page->connection->curl);
+        www_connection_release(scan->page->connection, 0);
+        if (scan->page->headers)
+            curl_slist_free_all(scan->page->headers);
+        if (scan->page->json.callback)
+            json_parser_free(&scan->page->json);
+        www_reply_free_rows(scan->page->json_rows.reply);
+        scan->page = NULL;
+    }
+    if (scan->page_cxt)
+        MemoryContextDelete(scan->page_cxt);
+    scan->page_cxt = NULL;
+    if (scan->reply_cxt)
+        MemoryContextDelete(scan->reply_cxt);
+    scan->reply_cxt = NULL;
+}
 
-    result    = json_get_result_array_in_tree(root, rel->rd_att);
-    if(!result)
-        ereport(ERROR,
-                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-                 errmsg("Can't find result in parsed server's json response")
-                    ));
+/*
+ * param_reply_hash
+ * param_reply_match
+ *   hash/compare rendered parameters (key is string pointer)
+ */
+static uint32
+param_reply_hash(const void *key, Size keysize)
+{
+    const char  *params = *(char * const *) key;
 
-    d("Result array was found in json response");
+    return tag_hash(params, strlen(params));
+}
 
-    /* prepare result */
-    reply = (Reply*)palloc(sizeof(Reply));
-    reply->tuple_index = 0;
-    reply->options = opts;
-    reply->opts_type = opts_type;
-    reply->opts_value = opts_value;
-    reply->ntuples    = result->length;
-    reply->tuples    = 0 == reply->ntuples ?
-        NULL :
-        (HeapTuple*)palloc(result->length * sizeof(HeapTuple));
+static int
+param_reply_match(const void *key1, const void *key2, Size keysize)
+{
+    return strcmp(*(char * const *) key1, *(char * const *) key2);
+}
 
-    natts = rel->rd_att->natts;
-    values = (char **) palloc(sizeof(char *) * natts);
-    for( i=0; i<result->length; i++ )
-    {
-        /* find column places */
-        json_obj = result->val.val_array[i];
-        for( j=0; j<natts; j++ )
-        {
-            for( k=0; k<json_obj.length; k++ )
-                if(0 == namestrcmp(&rel->rd_att->attrs[j]->attname, json_obj.val.val_object[k].key))
-                    break;
+/*
+ * www_raw_slot
+ *   slot for rows of tuplestore with raw tokens of deferred columns:
+ *   columns of the table, then bytea of the tokens
+ */
+static TupleTableSlot *
+www_raw_slot(TupleDesc tupdesc)
+{
+    TupleDesc   raw_desc;
+    int         i;
 
-            if(k < json_obj.length)
-                values[j]    = json2string(&(json_obj.val.val_object[k]));
-            else
-                values[j]    = NULL;
-        }
+#if PG_VERSION_NUM >= 120000
+    raw_desc = CreateTemplateTupleDesc(tupdesc->natts + 1);
+#else
+    raw_desc = CreateTemplateTupleDesc(tupdesc->natts + 1, false);
+#endif
+    for (i = 0; i < tupdesc->natts; i++)
+        TupleDescInitEntry(raw_desc, i + 1, NameStr(tupdesc->attrs[i]->attname),
+                           tupdesc->attrs[i]->atttypid, tupdesc->attrs[i]->atttypmod,
+                           tupdesc->attrs[i]->attndims);
+    TupleDescInitEntry(raw_desc, tupdesc->natts + 1, "raw", BYTEAOID, -1, 0);
+
+#if PG_VERSION_NUM >= 120000
+    return MakeSingleTupleTableSlot(raw_desc, &TTSOpsMinimalTuple);
+#else
+    return MakeSingleTupleTableSlot(raw_desc);
+#endif
+}
 
-        reply->tuples[i] = BuildTupleFromCStrings(attinmeta, values);
-    }
-    pfree(values);
+/*
+ * www_fanout_eval
+ *   fan-out parameters of array evaluated by executor (see www_param_fanout)
+ *   returns true if they differ from previous ones
+ */
+static bool
+www_fanout_eval(ForeignScanState *node, WWWScanState *scan)
+{
+    ExprContext     *econtext = node->ss.ps.ps_ExprContext;
+    MemoryContext   oldcontext;
+    List            *fanout = NIL;
+    Datum           value;
+    bool            isnull;
+    bool            changed;
+
+    oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+#if PG_VERSION_NUM >= 100000
+    value = ExecEvalExpr(scan->fanout_expr, econtext, &isnull);
+#else
+    value = ExecEvalExpr(scan->fanout_expr, econtext, &isnull, NULL);
+#endif
+    MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+    if (!isnull)
+        fanout = www_fanout_params(scan->fanout_template, value);
+    MemoryContextSwitchTo(oldcontext);
 
-    return    reply;
+    changed = !equal(fanout, scan->fanout);
+    scan->fanout = fanout;
+    return changed;
 }
 
 /*
  * www_begin
- *   Query search API and setup result
+ *   Setup scan state and query search API
+ *   parameterized scan queries it later, when outer values are known
  */
 static void
 www_begin(ForeignScanState *node, int eflags)
-{
-    WWW_fdw_options   *opts;
-    CURL              *curl;
-    char              curl_error_buffer[CURL_ERROR_SIZE+1]    = {0};
-    CURLcode          ret;
-    StringInfoData    url;
-    json_parser       json_parserr;
-    json_parser_dom   json_dom;
-    xmlParserCtxtPtr  xml_parserr    = NULL;
-    StringInfoData    buffer;
-    Oid               opts_type    = 0;
-    Datum             opts_value    = 0;
-    PostParameters    post;
-    StringInfoData    postContentType;
-    struct curl_slist *curl_opts = NULL;
+{
+    ForeignScan     *plan = (ForeignScan *) node->ss.ps.plan;
+    WWWScanState    *scan;
+    HASHCTL         ctl;
+    List            *param_exprs;
+    int             nparams;
 
     d("www_begin routine");
 
@@ -1760,236 +4816,373 @@ www_begin(ForeignScanState *node, int eflags)
 
     d("www_begin routine, not explain only call");
 
-    opts    = (WWW_fdw_options*)palloc(sizeof(WWW_fdw_options));
-    get_options( RelationGetRelid(node->ss.ss_currentRelation), opts );
-
-    initStringInfo(&url);
-    appendStringInfo(&url, "%s%s", opts->uri, opts->uri_select);
-
-    /* initialize options type and value if any of callback specified */
-    if(
-        opts->request_serialize_callback
-        ||
-        opts->response_deserialize_callback
-        ||
-        opts->response_iterate_callback
-    )
+    scan = (WWWScanState *) palloc0(sizeof(WWWScanState));
+    scan->opts = get_options( RelationGetRelid(node->ss.ss_currentRelation) );
+    scan->fanout = (List *) list_nth(plan->fdw_private, WWWScanPrivateFanout);
+    scan->limit = intVal(list_nth(plan->fdw_private, WWWScanPrivateLimit));
+    if (NIL != (List *) list_nth(plan->fdw_private, WWWScanPrivateUnused))
     {
-        get_www_fdw_options(opts, &opts_type, &opts_value);
-    }
+        ListCell    *lc;
 
-    post.post = false;
-    if(opts->request_serialize_callback)
-    {
-        /* call specified callback for forming request */
-        initStringInfo(&post.data);
-        initStringInfo(&post.content_type);
-        serialize_request_with_callback(opts, opts_type, opts_value, node, &url, &post);
+        scan->used = (bool *) palloc(scan->opts->ncolumns * sizeof(bool));
+        memset(scan->used, true, scan->opts->ncolumns * sizeof(bool));
+        foreach(lc, (List *) list_nth(plan->fdw_private, WWWScanPrivateUnused))
+            scan->used[lfirst_int(lc) - 1] = false;
     }
-    else
-    {
-        serialize_request_parameters(node, &url);
-    }
-
-    d("Url for request: '%s'", url.data);
-
-    /* interacting with the server */
-    curl = curl_easy_init();
-    curl_easy_setopt(curl, CURLOPT_URL, url.data);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, opts->request_user_agent);
-    if ( opts->username ) 
+    scan->row_cxt = AllocSetContextCreate(CurrentMemoryContext,
+                                          "www_fdw row",
+                                          ALLOCSET_DEFAULT_MINSIZE,
+                                          ALLOCSET_DEFAULT_INITSIZE,
+                                          ALLOCSET_DEFAULT_MAXSIZE);
+
+    /* fdw_exprs: outer values of url parameters, fan-out array, then local quals of lazy decoding */
+    nparams = list_length((List *) list_nth(plan->fdw_private, WWWScanPrivateParamTemplates));
+    param_exprs = list_truncate(list_copy(plan->fdw_exprs), nparams);
+    if ('\0' != *strVal(list_nth(plan->fdw_private, WWWScanPrivateFanoutTemplate)))
     {
-        curl_easy_setopt(curl, CURLOPT_USERNAME,  opts->username );
+        scan->fanout_template = strVal(list_nth(plan->fdw_private, WWWScanPrivateFanoutTemplate));
+        scan->fanout_expr = ExecInitExpr((Expr *) list_nth(plan->fdw_exprs, nparams), (PlanState *) node);
+        www_fanout_eval(node, scan);
+        nparams++;
     }
-    if ( opts->password )
+    if (NIL != (List *) list_nth(plan->fdw_private, WWWScanPrivateDeferred))
     {
-        curl_easy_setopt(curl, CURLOPT_PASSWORD, opts->password );
-        curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+        TupleDesc   tupdesc = RelationGetDescr(node->ss.ss_currentRelation);
+        List        *filter = list_copy_tail(plan->fdw_exprs, nparams);
+        ListCell    *lc;
+
+        scan->deferred = (bool *) palloc0(scan->opts->ncolumns * sizeof(bool));
+        foreach(lc, (List *) list_nth(plan->fdw_private, WWWScanPrivateDeferred))
+            scan->deferred[lfirst_int(lc) - 1] = true;
+        scan->resolver = (JSONDecoder *) palloc(sizeof(JSONDecoder));
+        json_decoder_init(scan->resolver, tupdesc, NULL, NULL);
+        json_decoder_defer(scan->resolver, scan->deferred);
+        scan->raw_slot = www_raw_slot(tupdesc);
+#if PG_VERSION_NUM >= 100000
+        scan->filter = ExecInitQual(filter, (PlanState *) node);
+#else
+        scan->filter = (List *) ExecInitExpr((Expr *) filter, (PlanState *) node);
+#endif
     }
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_error_buffer);
+    node->fdw_state = (void *) scan;
 
-    if(opts->request_user_header)
+    if (NIL == param_exprs)
     {
-        curl_opts = curl_slist_append(curl_opts, opts->request_user_header);
+        scan->reply = www_is_paged(scan) ? www_page_first(node, scan) : www_scan_request(node, scan, NULL);
+        scan->requested = true;
+        return;
     }
 
-    if(post.post || 0 == strcmp(opts->method_select, "POST"))
-    {
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        if(0 < post.content_type.len)
-        {
-            initStringInfo(&postContentType);
-            appendStringInfo(&postContentType,"Content-Type: %s", post.content_type.data );
-            curl_opts = curl_slist_append(curl_opts, postContentType.data);
-        }
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post.data.data);
-    }
+#if PG_VERSION_NUM >= 100000
+    scan->param_exprs = ExecInitExprList(param_exprs, (PlanState *) node);
+#else
+    scan->param_exprs = (List *) ExecInitExpr((Expr *) param_exprs, (PlanState *) node);
+#endif
+    scan->param_templates = (List *) list_nth(plan->fdw_private, WWWScanPrivateParamTemplates);
+    scan->param_columns = (List *) list_nth(plan->fdw_private, WWWScanPrivateParamColumns);
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(char *);
+    ctl.entrysize = sizeof(ParamReplyEntry);
+    ctl.hash = param_reply_hash;
+    ctl.match = param_reply_match;
+    ctl.hcxt = CurrentMemoryContext;
+    scan->replies = hash_create("www_fdw parameterized replies", 64, &ctl,
+                                HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+}
 
-    if( curl_opts )
-    {
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_opts);
-    }
+/*
+ * www_reply_release
+ *   stop transfer of streaming reply and return its connection to the pool
+ *   streaming lookup isn't cached: its memory is deleted, reply is gone
+ */
+static void
+www_reply_release(Reply *reply)
+{
+    JSONStream  *stream;
 
-    /* TODO
-     * implement & test all other methods:
-     * PUT
-     * POST
-     * and check POST is special:
-     * https://curl.haxx.se/libcurl/c/CURLOPT_CUSTOMREQUEST.html
-     * */
-    /* deleting */
-    if( 0 == strcmp(opts->method_select, "DELETE"))
+    if(!reply || !reply->stream)
+        return;
+
+    stream = reply->stream;
+    json_stream_stop(stream);
+    if(stream->headers)
+        curl_slist_free_all(stream->headers);
+    stream->headers = NULL;
+    www_connection_release(stream->connection, stream->max_per_host);
+    reply->stream = NULL;
+
+    if(reply->cxt)
+        MemoryContextDelete(reply->cxt);
+}
+
+/*
+ * www_lookup_request
+ *   request of parameterized scan in its own memory context,
+ *   reply owns it (reply->cxt), NULL reply - context is deleted already
+ */
+static Reply *
+www_lookup_request(ForeignScanState *node, WWWScanState *scan, const char *params)
+{
+    MemoryContext   cxt;
+    MemoryContext   oldcontext;
+    Reply           *reply;
+
+    cxt = AllocSetContextCreate(node->ss.ps.ps_ExprContext->ecxt_per_query_memory,
+                                "www_fdw lookup",
+                                ALLOCSET_SMALL_MINSIZE,
+                                ALLOCSET_SMALL_INITSIZE,
+                                ALLOCSET_DEFAULT_MAXSIZE);
+    oldcontext = MemoryContextSwitchTo(cxt);
+    reply = www_scan_request(node, scan, params);
+    MemoryContextSwitchTo(oldcontext);
+
+    if (NULL == reply)
+        MemoryContextDelete(cxt);
+    else
+        reply->cxt = cxt;
+    return reply;
+}
+
+/*
+ * www_reply_drop
+ *   release rows and memory of cached reply
+ *   (tuplestore first: its temp files are removed at once)
+ */
+static void
+www_reply_drop(Reply *reply)
+{
+    if (NULL == reply)
+        return;
+    www_reply_free_rows(reply);
+    if (reply->cxt)
+        MemoryContextDelete(reply->cxt);
+}
+
+/*
+ * www_reply_evict
+ *   drop the oldest cached reply of parameterized scan
+ */
+static void
+www_reply_evict(WWWScanState *scan)
+{
+    char            *key = (char *) linitial(scan->reply_keys);
+    ParamReplyEntry *entry;
+
+    scan->reply_keys = list_delete_first(scan->reply_keys);
+    entry = (ParamReplyEntry *) hash_search(scan->replies, &key, HASH_REMOVE, NULL);
+    if (entry)
+        www_reply_drop(entry->reply);
+    pfree(key);
+}
+
+/*
+ * www_replies_drop
+ *   drop all cached replies of parameterized scan
+ *   (grouped ones live in per query memory, their tuples are left there)
+ */
+static void
+www_replies_drop(WWWScanState *scan)
+{
+    HASH_SEQ_STATUS status;
+    ParamReplyEntry *entry;
+
+    hash_seq_init(&status, scan->replies);
+    while (NULL != (entry = (ParamReplyEntry *) hash_seq_search(&status)))
     {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE" );
+        char    *key = entry->params;
+
+        www_reply_drop(entry->reply);
+        hash_search(scan->replies, &key, HASH_REMOVE, NULL);
+        pfree(key);
     }
+    list_free(scan->reply_keys);
+    scan->reply_keys = NIL;
+    scan->complete = false;
+}
 
-    /* prepare parsers */
-    if( 0 == strcmp(opts->response_type, "json") )
+/*
+ * www_param_group
+ *   fetch whole response (without outer values) once and group its rows
+ *   into cached replies by parameters rendered from their columns,
+ *   so the rest of outer values are served without requests
+ *   replies of requests made before are kept as is
+ */
+static void
+www_param_group(ForeignScanState *node, WWWScanState *scan)
+{
+    TupleDesc       tupdesc = RelationGetDescr(node->ss.ss_currentRelation);
+    Reply           *all;
+    StringInfoData  params;
+    uint32          i;
+
+    d("Lookup limit %i is reached, fetching whole response", scan->opts->lookup_limit);
+
+    /* whole response isn't streamed: its rows are kept till the end of the scan anyway */
+    if (scan->opts->stream)
     {
-        if(opts->response_deserialize_callback)
-        {
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
-            initStringInfo(&buffer);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        }
-        else
-        {
-            json_parser_init2(&json_parserr, &json_dom);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, json_write_data_to_parser);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &json_parserr);
-        }
+        WWW_fdw_options *opts = (WWW_fdw_options *) palloc(sizeof(WWW_fdw_options));
+
+        memcpy(opts, scan->opts, sizeof(WWW_fdw_options));
+        opts->stream = false;
+        all = www_request(node, opts, NULL);
     }
-    else if( 0 == strcmp(opts->response_type, "xml") )
+    else
+        all = www_scan_request(node, scan, NULL);
+
+    /* empty fan-out array: no rows for any outer values */
+    if (NULL == all)
     {
-        if(opts->response_deserialize_callback)
-        {
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
-            initStringInfo(&buffer);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        }
-        else
-        {
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, xml_write_data_to_parser);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &xml_parserr);
-        }
+        www_replies_drop(scan);
+        scan->complete = true;
+        return;
     }
-    else if( 0 == strcmp(opts->response_type, "other") )
+    initStringInfo(&params);
+
+    for (i = 0; i < all->ntuples; i++)
     {
-        if(opts->response_deserialize_callback)
+        ListCell        *lc_column, *lc_template;
+        ParamReplyEntry *entry;
+        Reply           *reply;
+        HeapTuple       tuple = www_reply_tuple(all, node->ss.ss_ScanTupleSlot);
+        char            *key;
+        bool            found;
+        bool            isnull = false;
+
+        resetStringInfo(&params);
+        forboth(lc_column, scan->param_columns, lc_template, scan->param_templates)
         {
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buffer);
-            initStringInfo(&buffer);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        }
-        else
-            ereport(ERROR,
-                    (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
-                     errmsg("No response_deserialize_callback for response_type='other'")
-                        ));
-    }
+            AttrNumber  attnum = lfirst_int(lc_column);
+            Datum       value = heap_getattr(tuple, attnum, tupdesc, &isnull);
 
-        /* Ioana START changed on Jan 18, 2013 - added 4 more options for secure connections */
-        if(opts->ssl_cert)
-        {
-                curl_easy_setopt(curl, CURLOPT_SSLCERT, opts->ssl_cert);
-        }
-        if(opts->ssl_key)
-        {
-                curl_easy_setopt(curl, CURLOPT_SSLKEY, opts->ssl_key);
+            /* null never equals outer value */
+            if (isnull)
+                break;
+            www_param_append(&params, strVal(lfirst(lc_template)),
+                             www_param_value(tupdesc->attrs[attnum - 1]->atttypid, value));
         }
-        if(opts->cainfo)
+        if (isnull)
+            continue;
+
+        key = params.data;
+        entry = (ParamReplyEntry *) hash_search(scan->replies, &key, HASH_ENTER, &found);
+        if (!found)
         {
-                curl_easy_setopt(curl, CURLOPT_CAINFO, opts->cainfo);
+            entry->params = pstrdup(params.data);
+            entry->reply = NULL;
+            entry->size = 0;
         }
-        if(opts->proxy)
+        if (found && 0 == entry->size && entry->reply)
+            continue;
+
+        if (NULL == entry->reply)
         {
-                curl_easy_setopt(curl, CURLOPT_PROXY, opts->proxy);
+            reply = (Reply *) palloc0(sizeof(Reply));
+            reply->options = all->options;
+            reply->opts_type = all->opts_type;
+            reply->opts_value = all->opts_value;
+            reply->connection_reused = all->connection_reused;
+            entry->size = 4;
+            reply->tuples = (HeapTuple *) palloc(entry->size * sizeof(HeapTuple));
+            entry->reply = reply;
         }
-        /* Ioana END changed on Jan 18, 2013 */
-        if(opts->cookie)
+        reply = entry->reply;
+        if (reply->ntuples >= entry->size)
         {
-                curl_easy_setopt(curl, CURLOPT_COOKIE, opts->cookie);
+            entry->size *= 2;
+            reply->tuples = (HeapTuple *) repalloc(reply->tuples, entry->size * sizeof(HeapTuple));
         }
-
-    ret = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    if(ret) {
-        ereport(ERROR,
-            (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-            errmsg("Can't get a response from server: %s", curl_error_buffer)
-            ));
+        reply->tuples[reply->ntuples++] = tuple;
     }
-    if(curl_opts)
-        curl_slist_free_all(curl_opts);
-
-    /* process parsed results */
-    if( 0 == strcmp(opts->response_type, "json") )
-    {
-        if(opts->response_deserialize_callback)
-        {
-            node->fdw_state = (void*)call_response_deserialize_callback(node, opts, opts_type, opts_value, &buffer);
-        }
-        else
-        {
-            JSONNode    *root    = json_result_tree(&json_parserr);
-
-            if(!root)
-                ereport(ERROR,
-                        (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-                         errmsg("Can't parse server's json response, parser error code: %i", ret)
-                            ));
-
-            d("JSON response was parsed");
+    /* rows were copied into groups */
+    www_reply_free_rows(all);
 
-            node->fdw_state = (void*)prepare_json_result(node, opts, opts_type, opts_value, root);
+    scan->complete = true;
+}
 
-            json_parser_free(&json_parserr);
-            /* all data from tree was trully copied, free it up: */
-            json_free_tree(root);
-        }
-    }
-    else if( 0 == strcmp(opts->response_type, "xml") )
+/*
+ * www_param_request
+ *   query search API with outer values of parameterized scan
+ *   reply is taken from cache if these values were requested already
+ *   (streaming replies aren't cached, they hold transfer state)
+ */
+static void
+www_param_request(ForeignScanState *node, WWWScanState *scan)
+{
+    ForeignScan     *plan = (ForeignScan *) node->ss.ps.plan;
+    ExprContext     *econtext = node->ss.ps.ps_ExprContext;
+    MemoryContext   oldcontext;
+    StringInfoData  params;
+    ListCell        *lc_expr, *lc_state, *lc_template;
+    ParamReplyEntry *entry;
+    bool            found;
+
+    scan->requested = true;
+    scan->reply = NULL;
+
+    oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+    initStringInfo(&params);
+    forthree(lc_expr, plan->fdw_exprs, lc_state, scan->param_exprs, lc_template, scan->param_templates)
     {
-        if(opts->response_deserialize_callback)
+        bool    isnull;
+#if PG_VERSION_NUM >= 100000
+        Datum   value = ExecEvalExpr((ExprState *) lfirst(lc_state), econtext, &isnull);
+#else
+        Datum   value = ExecEvalExpr((ExprState *) lfirst(lc_state), econtext, &isnull, NULL);
+#endif
+
+        /* col = NULL matches nothing, no need to ask */
+        if (isnull)
         {
-            node->fdw_state = (void*)call_response_deserialize_callback(node, opts, opts_type, opts_value, &buffer);
+            MemoryContextSwitchTo(oldcontext);
+            return;
         }
-        else
-        {
-            /* get result in parsed response tree
-             * and save it for further processing in results iterations
-            */
-
-            xmlDocPtr    doc        = NULL;
-            int            res;
 
-            /* there is no more input, indicate the parsing is finished */
-            xmlParseChunk(xml_parserr, curl_error_buffer, 0, 1);
-
-            doc    = xml_parserr->myDoc;
-            res    = xml_parserr->wellFormed;
-
-            xmlFreeParserCtxt(xml_parserr);
+        www_param_append(&params, strVal(lfirst(lc_template)),
+                         www_param_value(exprType((Node *) lfirst(lc_expr)), value));
+    }
 
-            if(!res)
-                ereport(ERROR,
-                    (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-                    errmsg("Response xml isn't well formed")
-                    ));
+    /* cache entries live till the end of the scan */
+    MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
 
-            d("Xml response was parsed");
+    /* without request_lookup_fetch_all lookups go on: response without parameters may miss rows */
+    if (!scan->complete && scan->opts->fetch_all && scan->nlookups >= scan->opts->lookup_limit)
+        www_param_group(node, scan);
 
-            node->fdw_state = (void*)prepare_xml_result(node, opts, opts_type, opts_value, doc);
+    if (scan->opts->stream && NIL == scan->fanout && NULL == scan->fanout_expr && !scan->complete)
+    {
+        scan->reply = www_lookup_request(node, scan, params.data);
+        scan->nlookups++;
+        MemoryContextSwitchTo(oldcontext);
+        return;
+    }
 
-            /* result data was trully copied: free it up */
-            xmlFreeDoc(doc);
-        }
+    entry = (ParamReplyEntry *) hash_search(scan->replies, &params.data,
+                                            scan->complete ? HASH_FIND : HASH_ENTER, &found);
+    if (!found && !scan->complete)
+    {
+        entry->params = pstrdup(params.data);
+        entry->reply = NULL;
+        entry->size = 0;
+        entry->reply = www_lookup_request(node, scan, params.data);
+        scan->nlookups++;
+        scan->reply_keys = lappend(scan->reply_keys, entry->params);
+
+        /* rows of evicted replies are requested again, if needed */
+        if (list_length(scan->reply_keys) > WWW_REPLY_CACHE_SIZE)
+            www_reply_evict(scan);
     }
-    else if( 0 == strcmp(opts->response_type, "other") )
+    else if (found && entry->reply)
     {
-        /* checked already that we have response_deserialize_callback */
-        node->fdw_state = (void*)call_response_deserialize_callback(node, opts, opts_type, opts_value, &buffer);
+        d("Reply for parameters '%s' is taken from cache", params.data);
+
+        www_reply_rewind(entry->reply);
+        entry->reply->niterated = 0;
+        entry->reply->iterated_index = 0;
     }
+    scan->reply = entry ? entry->reply : NULL;
+
+    MemoryContextSwitchTo(oldcontext);
 }
 
 static
@@ -1997,7 +5190,6 @@ HeapTuple
 call_response_iterate_callback(ForeignScanState *node, WWW_fdw_options *opts, Oid opts_type, Datum opts_value, HeapTuple tuple)
 {
     int res;
-    StringInfoData cmd;
     Oid        opts_argtypes[2] = {
         opts_type,
         /* doesn't work here, type isn't set for it: */
@@ -2007,93 +5199,320 @@ call_response_iterate_callback(ForeignScanState *node, WWW_fdw_options *opts, Oi
     Datum    opts_values[2] = { opts_value, HeapTupleGetDatum(tuple) };
     HeapTuple rtuple = NULL;
 
-    SPI_connect_wrapper();
+    SPI_connect_wrapper();
+
+    /* do callback, plan is prepared once per backend, not per row */
+    res    = SPI_execute_plan(www_spi_plan(opts->response_iterate_callback, 2, opts_argtypes), opts_values, NULL, true, 0);
+    if(0 > res)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("Can't execute response_iterate_callback '%s': %i (%s)", opts->response_iterate_callback, res, describe_spi_code(res))
+            )
+        );
+    }
+
+    if(0 == SPI_processed)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("No results were returned from response_iterate_callback '%s'", opts->response_iterate_callback)
+            )
+        );
+    }
+
+    if(1 < SPI_processed)
+    {
+        ereport(ERROR,
+            (
+                errcode(ERRCODE_SYNTAX_ERROR),
+                errmsg("More than 1 result was returned from response_iterate_callback '%s': %i", opts->response_iterate_callback, SPI_processed)
+            )
+        );
+    }
+
+    /* "make a copy of a row in the upper executor context": */
+    rtuple = SPI_copytuple(SPI_tuptable->vals[0]);
+
+    SPI_finish_wrapper();
+
+    return rtuple;
+}
+
+/*
+ * call_response_iterate_batch_callback
+ * pass next rows of reply (up to response_iterate_batch) to response_iterate_callback
+ * as array of table rows in one SPI call
+ * rows returned by callback (it's a set: rows can be filtered or added) are saved in reply->iterated
+ * returns false if there are no more rows in reply
+ */
+static
+bool
+call_response_iterate_batch_callback(ForeignScanState *node, Reply *reply)
+{
+    WWW_fdw_options *opts   = reply->options;
+    TupleDesc       tuple_desc  = node->ss.ss_currentRelation->rd_att;
+    Oid             opts_argtypes[2];
+    Datum           opts_values[2];
+    Datum           *rows;
+    uint32          nrows, i;
+    int             res;
+    MemoryContext   oldcontext;
+
+    reply->iterated = NULL;
+    reply->niterated = 0;
+    reply->iterated_index = 0;
+
+    /* streaming: buffered tuples were passed already, get next ones */
+    if(reply->stream && reply->tuple_index >= reply->ntuples && !reply->stream->done)
+        json_stream_fill(reply->stream);
+
+    if(reply->tuple_index >= reply->ntuples)
+        return false;
+
+    if(NULL == reply->iterate_cxt)
+    {
+        reply->iterate_argtype = get_array_type(tuple_desc->tdtypeid);
+        if(!OidIsValid(reply->iterate_argtype))
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+                errmsg("Can't find array type of foreign table rows for response_iterate_callback '%s'", opts->response_iterate_callback)
+                ));
+
+        reply->iterate_cxt = AllocSetContextCreate(reply->cxt ? reply->cxt : node->ss.ps.ps_ExprContext->ecxt_per_query_memory,
+                                                   "www_fdw iterate batch",
+                                                   ALLOCSET_DEFAULT_MINSIZE,
+                                                   ALLOCSET_DEFAULT_INITSIZE,
+                                                   ALLOCSET_DEFAULT_MAXSIZE);
+    }
+    else
+        MemoryContextReset(reply->iterate_cxt);
+
+    /* rows returned by callback are copied into batch memory (upper context for SPI) */
+    oldcontext = MemoryContextSwitchTo(reply->iterate_cxt);
 
-    /* do callback */
-    initStringInfo(&cmd);
-    appendStringInfo(&cmd, "SELECT * FROM %s($1,$2)", opts->response_iterate_callback);
+    nrows = Min((uint32)opts->iterate_batch, reply->ntuples - reply->tuple_index);
+    rows = (Datum*)palloc(nrows * sizeof(Datum));
+    for(i = 0; i < nrows; i++)
+        rows[i] = HeapTupleGetDatum(www_reply_tuple(reply, node->ss.ss_ScanTupleSlot));
 
-    res    = SPI_execute_with_args(cmd.data, 2, opts_argtypes, opts_values, NULL, true, 0);
-    if(0 > res)
-    {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("Can't execute response_iterate_callback '%s': %i (%s)", opts->response_iterate_callback, res, describe_spi_code(res))
-            )
-        );
-    }
+    opts_argtypes[0] = reply->opts_type;
+    opts_argtypes[1] = reply->iterate_argtype;
+    opts_values[0] = reply->opts_value;
+    opts_values[1] = PointerGetDatum(construct_array(rows, nrows, tuple_desc->tdtypeid, -1, false, 'd'));
 
-    if(0 == SPI_processed)
-    {
-        ereport(ERROR,
-            (
-                errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("No results were returned from response_iterate_callback '%s'", opts->response_iterate_callback)
-            )
-        );
-    }
+    SPI_connect_wrapper();
 
-    if(1 < SPI_processed)
+    res    = SPI_execute_plan(www_spi_plan(opts->response_iterate_callback, 2, opts_argtypes), opts_values, NULL, true, 0);
+    if(0 > res)
     {
         ereport(ERROR,
             (
                 errcode(ERRCODE_SYNTAX_ERROR),
-                errmsg("More than 1 result was returned from response_iterate_callback '%s': %i", opts->response_iterate_callback, SPI_processed)
+                errmsg("Can't execute response_iterate_callback '%s': %i (%s)", opts->response_iterate_callback, res, describe_spi_code(res))
             )
         );
     }
 
-    /* "make a copy of a row in the upper executor context": */
-    rtuple = SPI_copytuple(SPI_tuptable->vals[0]);
+    reply->niterated = SPI_processed;
+    reply->iterated = (HeapTuple*)SPI_palloc(Max(1, reply->niterated) * sizeof(HeapTuple));
+    for(i = 0; i < reply->niterated; i++)
+        reply->iterated[i] = SPI_copytuple(SPI_tuptable->vals[i]);
 
     SPI_finish_wrapper();
+    MemoryContextSwitchTo(oldcontext);
 
-    return rtuple;
+    d("response_iterate_callback returned %u rows for batch of %u rows", reply->niterated, nrows);
+
+    return true;
 }
 
 /*
- * www_iterate
- *   return row per each call
+ * www_next_row
+ *   store next row of reply in scan slot
+ *   row is delivered as virtual tuple: its values point into reply tuple,
+ *   which outlives the row, anything allocated for the row goes to row_cxt
+ *   (row of tuplestore is stored as is, it's valid till the next fetch)
  */
 static TupleTableSlot *
-www_iterate(ForeignScanState *node)
+www_next_row(ForeignScanState *node)
 {
     TupleTableSlot    *slot    = node->ss.ss_ScanTupleSlot;
-    Reply            *reply    = (Reply*)node->fdw_state;
+    WWWScanState     *scan    = (WWWScanState*)node->fdw_state;
+    Reply            *reply;
     HeapTuple        tuple;
     MemoryContext    oldcontext;
 
-    d("www_iterate routine");
+    /* previous row isn't needed anymore, its tuple can be gone with next batch */
+    ExecClearTuple(slot);
+    if(scan)
+        MemoryContextReset(scan->row_cxt);
 
-    /* no results or results finished */
-    if(!reply || !reply->tuples || reply->tuple_index >= reply->ntuples)
+    /* parameterized scan: request for current outer values */
+    if(scan && !scan->requested)
+        www_param_request(node, scan);
+    reply = scan ? scan->reply : NULL;
+
+    /* batched response_iterate_callback: rows are taken from its results */
+    if(reply && reply->options->response_iterate_callback && 0 < reply->options->iterate_batch)
     {
-        ExecClearTuple(slot);
+        /* tuple in slot belongs to batch memory, which is reset for next batch */
+        while(reply->iterated_index >= reply->niterated)
+        {
+            if(call_response_iterate_batch_callback(node, reply))
+                continue;
+            /* current page is passed to the callback completely */
+            if(!scan->page)
+                return slot;
+            scan->reply = reply = www_page_wait(node, scan);
+        }
+        ExecStoreTuple(reply->iterated[reply->iterated_index++], slot, InvalidBuffer, false);
         return slot;
     }
 
-    /* copy tuple, increment iterator */
-    oldcontext = MemoryContextSwitchTo(node->ss.ps.ps_ExprContext->ecxt_per_query_memory);
+    /* paging: current page is returned, next one was transferred meanwhile */
+    if(reply && scan->page)
+    {
+        while(scan->page && reply->tuple_index >= reply->ntuples)
+            scan->reply = reply = www_page_wait(node, scan);
+        if(scan->page && 0 == reply->tuple_index % WWW_PAGE_POLL_ROWS)
+            www_page_perform(scan);
+    }
+
+    /* streaming: buffered tuples were returned, get next ones */
+    if(reply && reply->stream && reply->tuple_index >= reply->ntuples && !reply->stream->done)
+        json_stream_fill(reply->stream);
+
+    /* no results or results finished */
+    if(!reply || reply->tuple_index >= reply->ntuples)
+        return slot;
+
     if(reply->options->response_iterate_callback)
     {
         d("call response_iterate_callback");
 
+        /* callback result is copied into row memory (upper context for SPI) */
+        oldcontext = MemoryContextSwitchTo(scan->row_cxt);
         tuple = call_response_iterate_callback(
             node,
             reply->options,
             reply->opts_type,
             reply->opts_value,
-            reply->tuples[reply->tuple_index++]);
+            www_reply_tuple(reply, slot));
+        MemoryContextSwitchTo(oldcontext);
+        ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+        return slot;
+    }
+
+    /* raw tokens stay in raw_slot till the next row, www_resolve_row decodes them */
+    if(reply->store && scan->raw_slot)
+    {
+        int     natts = slot->tts_tupleDescriptor->natts;
+
+        reply->tuple_index++;
+        tuplestore_gettupleslot(reply->store, true, false, scan->raw_slot);
+        slot_getallattrs(scan->raw_slot);
+        memcpy(slot->tts_values, scan->raw_slot->tts_values, natts * sizeof(Datum));
+        memcpy(slot->tts_isnull, scan->raw_slot->tts_isnull, natts * sizeof(bool));
+        ExecStoreVirtualTuple(slot);
+        return slot;
     }
-    else
-        tuple = heap_copytuple(reply->tuples[reply->tuple_index++]);
-    MemoryContextSwitchTo(oldcontext);
-    ExecStoreTuple(tuple, slot, InvalidBuffer, true);
+
+    if(reply->store)
+    {
+        reply->tuple_index++;
+        tuplestore_gettupleslot(reply->store, true, false, slot);
+        return slot;
+    }
+
+    heap_deform_tuple(reply->tuples[reply->tuple_index++], slot->tts_tupleDescriptor,
+                      slot->tts_values, slot->tts_isnull);
+    ExecStoreVirtualTuple(slot);
 
     return slot;
 }
 
+/*
+ * www_resolve_row
+ *   check local quals of lazy decoding on the row in slot,
+ *   decode its deferred columns if it passes them
+ *   returns false if row is filtered out
+ */
+static bool
+www_resolve_row(ForeignScanState *node, WWWScanState *scan, TupleTableSlot *slot)
+{
+    ExprContext     *econtext = node->ss.ps.ps_ExprContext;
+    Reply           *reply = scan->reply;
+    char            *raw = NULL;
+    uint32          length = 0;
+    MemoryContext   oldcontext;
+
+    ResetExprContext(econtext);
+    econtext->ecxt_scantuple = slot;
+#if PG_VERSION_NUM >= 100000
+    if (!ExecQual(scan->filter, econtext))
+#else
+    if (!ExecQual(scan->filter, econtext, false))
+#endif
+        return false;
+
+    /* tuplestore keeps raw tokens as the last attribute, array - with length prefix */
+    if (reply->store)
+    {
+        int     natts = slot->tts_tupleDescriptor->natts;
+
+        if (!scan->raw_slot->tts_isnull[natts])
+        {
+            bytea   *token = (bytea *) DatumGetPointer(scan->raw_slot->tts_values[natts]);
+
+            raw = VARDATA_ANY(token);
+            length = VARSIZE_ANY_EXHDR(token);
+        }
+    }
+    else if (reply->raw && reply->raw[reply->tuple_index - 1])
+    {
+        memcpy(&length, reply->raw[reply->tuple_index - 1], sizeof(length));
+        raw = reply->raw[reply->tuple_index - 1] + sizeof(length);
+    }
+
+    if (NULL == raw)
+        return true;
+
+    /* values are converted right into virtual tuple of the slot */
+    oldcontext = MemoryContextSwitchTo(scan->row_cxt);
+    json_decoder_resolve(scan->resolver, raw, length, slot->tts_values, slot->tts_isnull);
+    MemoryContextSwitchTo(oldcontext);
+
+    return true;
+}
+
+/*
+ * www_iterate
+ *   return row per each call
+ *   with lazy decoding rows are filtered here, before deferred columns are decoded
+ */
+static TupleTableSlot *
+www_iterate(ForeignScanState *node)
+{
+    WWWScanState    *scan = (WWWScanState *) node->fdw_state;
+    TupleTableSlot  *slot;
+
+    d("www_iterate routine");
+
+    for (;;)
+    {
+        slot = www_next_row(node);
+        if (NULL == scan || NULL == scan->deferred || TupIsNull(slot))
+            return slot;
+        if (www_resolve_row(node, scan, slot))
+            return slot;
+        InstrCountFiltered1(node, 1);
+        CHECK_FOR_INTERRUPTS();
+    }
+}
+
 /*
  * www_rescan
  * FDW rescan handler/callback
@@ -2101,11 +5520,54 @@ www_iterate(ForeignScanState *node)
 static void
 www_rescan(ForeignScanState *node)
 {
-    Reply       *reply = (Reply *) node->fdw_state;
+    WWWScanState    *scan = (WWWScanState *) node->fdw_state;
+    Reply       *reply = scan->reply;
 
     d("www_rescan routine");
 
-    reply->tuple_index    = 0;
+    /* outer values could change: request is made (or taken from cache) by www_iterate */
+    if(NIL != scan->param_exprs)
+    {
+        www_reply_release(reply);
+        scan->reply = NULL;
+        scan->requested = false;
+        /* cached replies were fanned out for other values of the array */
+        if(scan->fanout_expr && www_fanout_eval(node, scan))
+            www_replies_drop(scan);
+        return;
+    }
+
+    /* parameters of fan-out array could change: request is made again */
+    if(scan->fanout_expr)
+    {
+        www_reply_free_rows(reply);
+        www_fanout_eval(node, scan);
+        scan->reply = www_scan_request(node, scan, NULL);
+        return;
+    }
+
+    /* paging: pages after the first one are gone, start again */
+    if(scan->page || 1 < scan->npages)
+    {
+        www_reply_free_rows(reply);
+        www_page_drop(scan);
+        scan->reply = www_page_first(node, scan);
+        return;
+    }
+
+    /* rows returned by batched response_iterate_callback are dropped */
+    reply->niterated = 0;
+    reply->iterated_index = 0;
+
+    if(reply->stream)
+    {
+        /* buffered tuples are dropped already: request response again */
+        json_stream_stop(reply->stream);
+        json_stream_start(reply->stream);
+        return;
+    }
+
+    www_reply_rewind(reply);
 }
 
 /*
@@ -2115,39 +5577,69 @@ www_rescan(ForeignScanState *node)
 static void
 www_end(ForeignScanState *node)
 {
+    WWWScanState    *scan = (WWWScanState *) node->fdw_state;
+
     d("www_end routine");
+
+    if(scan)
+    {
+        www_reply_free_rows(scan->reply);
+        www_reply_release(scan->reply);
+        /* cached replies of parameterized scan: their temp files are removed at once */
+        if(scan->replies)
+            www_replies_drop(scan);
+        www_page_drop(scan);
+        if(scan->page_multi)
+            curl_multi_cleanup(scan->page_multi);
+        if(scan->raw_slot)
+            ExecDropSingleTupleTableSlot(scan->raw_slot);
+    }
 }
 
 /*
  * json_write_data_to_parser
  *    parse json chunk by chunk
+ *    transfer is aborted as soon as rows needed by LIMIT are decoded
+ *    (errors are raised by www_request_finish, see www_write_catch)
 */
 static size_t
 json_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp)
 {
     int            segsize = size * nmemb;
-    json_parser *parser = (json_parser *) userp;
+    WWWRequest  *req = (WWWRequest *) userp;
+    MemoryContext  oldcontext = CurrentMemoryContext;
     int            ret;
 
-    ret = json_parser_string(parser, buffer, segsize, NULL);
-    if (ret)
-        ereport(ERROR,
-            (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
-            errmsg("Can't parse server's json response, parser error code: %i", ret)
-            ));
+    if (www_request_limited(req))
+        return 0;
 
-    return segsize;
+    PG_TRY();
+    {
+        ret = json_parser_string(&req->json, buffer, segsize, NULL);
+        if (ret)
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+                errmsg("Can't parse server's json response, parser error code: %i", ret)
+                ));
+    }
+    PG_CATCH();
+    {
+        www_write_catch(&req->error, oldcontext);
+        return 0;
+    }
+    PG_END_TRY();
+
+    return www_request_limited(req) ? 0 : segsize;
 }
 
 /*
- * xml_write_data_to_parser
- *    parse xml chunk by chunk
+ * xml_parse_chunk
+ *    pass chunk of xml response to the parser
+ *    parser is created with the first chunk
 */
-static size_t
-xml_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp)
+static void
+xml_parse_chunk(xmlParserCtxtPtr *ctxt, char *buffer, int segsize)
 {
-    int            segsize = size * nmemb;
-    xmlParserCtxtPtr *ctxt = (xmlParserCtxtPtr*) userp;
     int            ret;
 
     if(NULL == *ctxt) {
@@ -2171,7 +5663,7 @@ xml_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp)
                 ));
         }
 
-        return segsize;
+        return;
     }
 
     ret = xmlParseChunk(*ctxt, buffer, segsize, 0);
@@ -2183,8 +5675,31 @@ xml_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp)
             errmsg("Can't parse server's xml response, parser error code: %i, message: %s", ret, err ? err->message : "")
             ));
     }
+}
 
-    return segsize;
+/*
+ * xml_write_data_to_parser
+ *    parse xml chunk by chunk
+ *    (errors are raised by www_request_finish, see www_write_catch)
+*/
+static size_t
+xml_write_data_to_parser(void *buffer, size_t size, size_t nmemb, void *userp)
+{
+    WWWRequest  *req = (WWWRequest *) userp;
+    MemoryContext  oldcontext = CurrentMemoryContext;
+
+    PG_TRY();
+    {
+        xml_parse_chunk(&req->xml, buffer, size * nmemb);
+    }
+    PG_CATCH();
+    {
+        www_write_catch(&req->error, oldcontext);
+        return 0;
+    }
+    PG_END_TRY();
+
+    return size * nmemb;
 }
 
 /*
@@ -2203,11 +5718,114 @@ write_data_to_buffer(void *buffer, size_t size, size_t nmemb, void *userp)
 }
 
 /*
- * get_options
- * fetch the options for a mysql_fdw foreign table.
+ * parse_response_order
+ * keys of response_order option: comma separated columns,
+ * each is optionally followed by asc or desc
+ */
+static void
+parse_response_order(WWW_fdw_options *opts, TupleDesc tupdesc)
+{
+    char        *order = pstrdup(opts->response_order);
+    char        *key;
+    int         nkeys = 1;
+
+    for (key = order; *key; key++)
+        if (',' == *key)
+            nkeys++;
+    opts->order = (WWWOrderKey *) palloc0(nkeys * sizeof(WWWOrderKey));
+    opts->norder = 0;
+
+    for (key = strtok(order, ","); key; key = strtok(NULL, ","))
+    {
+        WWWOrderKey *k = &opts->order[opts->norder];
+        char        *end,
+                    *word;
+        int         i;
+
+        while (isspace((unsigned char) *key))
+            key++;
+        end = key + strlen(key);
+        while (end > key && isspace((unsigned char) end[-1]))
+            *--end = '\0';
+
+        /* direction is the last word */
+        word = strrchr(key, ' ');
+        if (word && (0 == pg_strcasecmp(word + 1, "desc") || 0 == pg_strcasecmp(word + 1, "asc")))
+        {
+            k->desc = 0 == pg_strcasecmp(word + 1, "desc");
+            while (word > key && isspace((unsigned char) word[-1]))
+                word--;
+            *word = '\0';
+        }
+
+        for (i = 0; i < tupdesc->natts && 0 == k->attnum; i++)
+            if (!tupdesc->attrs[i]->attisdropped && 0 == strcmp(NameStr(tupdesc->attrs[i]->attname), key))
+                k->attnum = i + 1;
+
+        if (0 == k->attnum)
+            ereport(ERROR,
+                (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+                errmsg("invalid value for response_order: column \"%s\" doesn't exist", key)
+                ));
+        opts->norder++;
+    }
+}
+
+/*
+ * parse_column_options
+ * url parameter templates of columns
+ * equality is passed as column=value by default, other quals only if template is set
+ */
+static void
+parse_column_options(Oid foreigntableid, WWW_fdw_options *opts)
+{
+    Relation    rel = heap_open(foreigntableid, AccessShareLock);
+    TupleDesc   tupdesc = RelationGetDescr(rel);
+    AttrNumber  attnum;
+    ListCell    *lc;
+    int         kind;
+
+    opts->ncolumns = tupdesc->natts;
+    opts->columns = (WWWColumnParams *) palloc0(tupdesc->natts * sizeof(WWWColumnParams));
+
+    for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+    {
+        WWWColumnParams *column = &opts->columns[attnum - 1];
+        StringInfoData  eq;
+
+        if (tupdesc->attrs[attnum - 1]->attisdropped)
+            continue;
+        column->name = percent_encode((unsigned char *) NameStr(tupdesc->attrs[attnum - 1]->attname), -1);
+
+        foreach(lc, GetForeignColumnOptions(foreigntableid, attnum))
+        {
+            DefElem    *def = (DefElem *) lfirst(lc);
+
+            for (kind = 0; kind < WWW_PARAM_NUM; kind++)
+                if (0 == strcmp(def->defname, www_param_options[kind]))
+                    column->templates[kind] = defGetString(def);
+        }
+
+        if (NULL == column->templates[WWW_PARAM_EQ])
+        {
+            initStringInfo(&eq);
+            appendStringInfo(&eq, "%s=%%s", column->name);
+            column->templates[WWW_PARAM_EQ] = eq.data;
+        }
+    }
+
+    if (opts->response_order)
+        parse_response_order(opts, tupdesc);
+
+    heap_close(rel, AccessShareLock);
+}
+
+/*
+ * parse_options
+ * fetch the options for a www_fdw foreign table.
  */
 static void
-get_options(Oid foreigntableid, WWW_fdw_options *opts)
+parse_options(Oid foreigntableid, WWW_fdw_options *opts)
 {
     ForeignTable    *f_table;
     ForeignServer    *f_server;
@@ -2254,6 +5872,33 @@ get_options(Oid foreigntableid, WWW_fdw_options *opts)
     opts->cookie           = NULL;
     opts->username         = NULL;
     opts->password         = NULL;
+    opts->connection_idle_timeout  = NULL;
+    opts->connection_max_per_host  = NULL;
+    opts->response_stream  = NULL;
+    opts->response_stream_rows = NULL;
+    opts->response_iterate_batch   = NULL;
+    opts->request_latency  = NULL;
+    opts->response_row_cost    = NULL;
+    opts->expected_rows    = NULL;
+    opts->request_lookup_limit = NULL;
+    opts->request_lookup_fetch_all = NULL;
+    opts->request_concurrency  = NULL;
+    opts->page_next_path   = NULL;
+    opts->page_next_header = NULL;
+    opts->page_next_param  = NULL;
+    opts->page_limit   = NULL;
+    opts->page_number_param    = NULL;
+    opts->page_offset_param    = NULL;
+    opts->page_size_param  = NULL;
+    opts->page_size    = NULL;
+    opts->page_total_path  = NULL;
+    opts->page_ordered = NULL;
+    opts->param_limit  = NULL;
+    opts->response_order   = NULL;
+    opts->param_fields = NULL;
+
+    opts->serverid         = f_table->serverid;
+    opts->userid           = GetUserId();
 
     /* Loop through the options, and get the server/port */
     foreach(lc, options)
@@ -2331,6 +5976,79 @@ get_options(Oid foreigntableid, WWW_fdw_options *opts)
         
         if (strcmp(def->defname, "password") == 0)
             opts->password = defGetString(def);
+
+        if (strcmp(def->defname, "connection_idle_timeout") == 0)
+            opts->connection_idle_timeout = defGetString(def);
+
+        if (strcmp(def->defname, "connection_max_per_host") == 0)
+            opts->connection_max_per_host = defGetString(def);
+
+        if (strcmp(def->defname, "response_stream") == 0)
+            opts->response_stream = defGetString(def);
+
+        if (strcmp(def->defname, "response_stream_rows") == 0)
+            opts->response_stream_rows = defGetString(def);
+
+        if (strcmp(def->defname, "response_iterate_batch") == 0)
+            opts->response_iterate_batch = defGetString(def);
+
+        /* table options go first in the list: first value wins */
+        if (strcmp(def->defname, "request_latency") == 0 && !opts->request_latency)
+            opts->request_latency = defGetString(def);
+
+        if (strcmp(def->defname, "response_row_cost") == 0 && !opts->response_row_cost)
+            opts->response_row_cost = defGetString(def);
+
+        if (strcmp(def->defname, "expected_rows") == 0 && !opts->expected_rows)
+            opts->expected_rows = defGetString(def);
+
+        if (strcmp(def->defname, "request_lookup_limit") == 0 && !opts->request_lookup_limit)
+            opts->request_lookup_limit = defGetString(def);
+
+        if (strcmp(def->defname, "request_lookup_fetch_all") == 0 && !opts->request_lookup_fetch_all)
+            opts->request_lookup_fetch_all = defGetString(def);
+
+        if (strcmp(def->defname, "request_concurrency") == 0 && !opts->request_concurrency)
+            opts->request_concurrency = defGetString(def);
+
+        if (strcmp(def->defname, "page_next_path") == 0 && !opts->page_next_path)
+            opts->page_next_path = defGetString(def);
+
+        if (strcmp(def->defname, "page_next_header") == 0 && !opts->page_next_header)
+            opts->page_next_header = defGetString(def);
+
+        if (strcmp(def->defname, "page_next_param") == 0 && !opts->page_next_param)
+            opts->page_next_param = defGetString(def);
+
+        if (strcmp(def->defname, "page_limit") == 0 && !opts->page_limit)
+            opts->page_limit = defGetString(def);
+
+        if (strcmp(def->defname, "page_number_param") == 0 && !opts->page_number_param)
+            opts->page_number_param = defGetString(def);
+
+        if (strcmp(def->defname, "page_offset_param") == 0 && !opts->page_offset_param)
+            opts->page_offset_param = defGetString(def);
+
+        if (strcmp(def->defname, "page_size_param") == 0 && !opts->page_size_param)
+            opts->page_size_param = defGetString(def);
+
+        if (strcmp(def->defname, "page_size") == 0 && !opts->page_size)
+            opts->page_size = defGetString(def);
+
+        if (strcmp(def->defname, "page_total_path") == 0 && !opts->page_total_path)
+            opts->page_total_path = defGetString(def);
+
+        if (strcmp(def->defname, "page_ordered") == 0 && !opts->page_ordered)
+            opts->page_ordered = defGetString(def);
+
+        if (strcmp(def->defname, "param_limit") == 0 && !opts->param_limit)
+            opts->param_limit = defGetString(def);
+
+        if (strcmp(def->defname, "response_order") == 0 && !opts->response_order)
+            opts->response_order = defGetString(def);
+
+        if (strcmp(def->defname, "param_fields") == 0 && !opts->param_fields)
+            opts->param_fields = defGetString(def);
     }
 
     /* Default values, if required */
@@ -2351,12 +6069,152 @@ get_options(Oid foreigntableid, WWW_fdw_options *opts)
 
     if (!opts->response_type) opts->response_type    = "json";
 
+    if (!opts->connection_idle_timeout) opts->connection_idle_timeout  = "60";
+    if (!opts->connection_max_per_host) opts->connection_max_per_host  = "4";
+
+    if (!opts->response_stream) opts->response_stream  = "0";
+    if (!opts->response_stream_rows) opts->response_stream_rows  = "1000";
+    if (!opts->response_iterate_batch) opts->response_iterate_batch  = "0";
+
+    if (!opts->request_latency) opts->request_latency  = "100";
+    if (!opts->response_row_cost) opts->response_row_cost  = "0.05";
+    if (!opts->expected_rows) opts->expected_rows  = "1000";
+    if (!opts->request_lookup_limit) opts->request_lookup_limit  = "0";
+    if (!opts->request_lookup_fetch_all) opts->request_lookup_fetch_all  = "0";
+    if (!opts->request_concurrency) opts->request_concurrency  = "0";
+    if (!opts->page_limit) opts->page_limit  = "0";
+    if (!opts->page_size) opts->page_size  = "0";
+    if (!opts->page_ordered) opts->page_ordered  = "1";
+
     /* Check we have mandatory options */
     if (!opts->uri)
         ereport(ERROR,
             (errcode(ERRCODE_SYNTAX_ERROR),
             errmsg("At least uri option must be specified")
             ));
+
+    /* derived state, so scans don't compare/convert strings */
+    if (0 == strcmp(opts->method_select, "GET"))
+        opts->method    = WWW_METHOD_GET;
+    else if (0 == strcmp(opts->method_select, "POST"))
+        opts->method    = WWW_METHOD_POST;
+    else if (0 == strcmp(opts->method_select, "DELETE"))
+        opts->method    = WWW_METHOD_DELETE;
+    else
+        opts->method    = WWW_METHOD_OTHER;
+
+    if (0 == strcmp(opts->response_type, "xml"))
+        opts->response_format   = WWW_RESPONSE_XML;
+    else if (0 == strcmp(opts->response_type, "other"))
+        opts->response_format   = WWW_RESPONSE_OTHER;
+    else
+        opts->response_format   = WWW_RESPONSE_JSON;
+
+    opts->idle_timeout  = atoi(opts->connection_idle_timeout);
+    opts->max_per_host  = atoi(opts->connection_max_per_host);
+    opts->stream        = 0 == strcmp(opts->response_stream, "1");
+    opts->stream_rows   = Max(1, atoi(opts->response_stream_rows));
+    opts->iterate_batch = atoi(opts->response_iterate_batch);
+    opts->latency       = strtod(opts->request_latency, NULL);
+    opts->row_cost      = strtod(opts->response_row_cost, NULL);
+    opts->rows          = strtod(opts->expected_rows, NULL);
+    opts->lookup_limit  = atoi(opts->request_lookup_limit);
+    opts->fetch_all     = 0 < opts->lookup_limit && 0 == strcmp(opts->request_lookup_fetch_all, "1");
+    opts->concurrency   = atoi(opts->request_concurrency);
+    opts->paged         = NULL != opts->page_next_path || NULL != opts->page_next_header;
+    opts->max_pages     = atoi(opts->page_limit);
+    opts->per_page      = atoi(opts->page_size);
+    opts->offset_paged  = NULL != opts->page_total_path && 0 < opts->per_page
+                          && (NULL != opts->page_number_param || NULL != opts->page_offset_param);
+    opts->ordered       = 0 == strcmp(opts->page_ordered, "1");
+
+    /* numbered pages: one way of numbering, page size is needed to count pages */
+    if (opts->page_number_param && opts->page_offset_param)
+        ereport(ERROR,
+            (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("page_number_param and page_offset_param can't be used together")
+            ));
+    if ((opts->page_total_path || opts->page_number_param || opts->page_offset_param) && 0 >= opts->per_page)
+        ereport(ERROR,
+            (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("page_size is required by page_total_path, page_number_param and page_offset_param")
+            ));
+
+    /* rows missing in the whole response would be lost silently */
+    if (opts->fetch_all && (opts->paged || 0 < opts->max_pages))
+        ereport(ERROR,
+            (errcode(ERRCODE_SYNTAX_ERROR),
+            errmsg("request_lookup_fetch_all can't be used with page_next_path, page_next_header or page_limit: whole response has to be fetched")
+            ));
+
+    parse_column_options(foreigntableid, opts);
+}
+
+/*
+ * get_options
+ * options of the foreign table for current user
+ * they're parsed once and kept in backend-local cache till foreign table,
+ * server or user mapping is changed, so scans don't parse options at all
+ * returned options stay valid at least till the end of transaction
+ */
+static WWW_fdw_options*
+get_options(Oid foreigntableid)
+{
+    OptionsCacheKey     key;
+    OptionsCacheEntry   *entry;
+    WWW_fdw_options     *opts;
+    MemoryContext       cxt, oldcontext;
+    bool                found;
+
+    if(NULL == OptionsCacheHash)
+        options_cache_init();
+
+    MemSet(&key, 0, sizeof(key));
+    key.foreigntableid = foreigntableid;
+    key.userid = GetUserId();
+
+    entry = (OptionsCacheEntry *) hash_search(OptionsCacheHash, &key, HASH_ENTER, &found);
+    if(!found)
+    {
+        entry->valid = false;
+        entry->opts = NULL;
+    }
+    /* no options - previous parsing failed */
+    if(entry->valid && entry->opts)
+        return entry->opts;
+
+    /* stale options can be used by running scans: they're freed at the end of transaction */
+    if(entry->opts)
+    {
+        MemoryContextSetParent(entry->opts->cxt, TopTransactionContext);
+        entry->opts = NULL;
+    }
+
+    /*
+     * entry is marked valid before parsing (like relcache does):
+     * catalog lookups of parse_options can process invalidation, which clears
+     * the flag then, so options parsed from old catalog rows are parsed again
+     * on the next scan
+     */
+    entry->valid = true;
+
+    /* options are parsed in transaction memory, so failed parsing leaves nothing behind */
+    cxt = AllocSetContextCreate(TopTransactionContext,
+                                "www_fdw options",
+                                ALLOCSET_SMALL_MINSIZE,
+                                ALLOCSET_SMALL_INITSIZE,
+                                ALLOCSET_SMALL_MAXSIZE);
+    oldcontext = MemoryContextSwitchTo(cxt);
+    opts = (WWW_fdw_options*)palloc0(sizeof(WWW_fdw_options));
+    parse_options(foreigntableid, opts);
+    MemoryContextSwitchTo(oldcontext);
+
+    opts->cxt = cxt;
+    MemoryContextSetParent(cxt, CacheMemoryContext);
+
+    entry->opts = opts;
+
+    return opts;
 }
 
 static
@@ -3,14 +3,15 @@
 int	main(void)
 {
 	const int	chunk	= 1024;
-	json_parser_dom json_dom;
+	JSONBuilder json_builder;
 	json_parser json_parserr;
 	int	ret;
 	size_t	read;
 	char	buffer[1025]	= {0};
 	JSONNode*	root	= NULL;
 
-	json_parser_init2(&json_parserr, &json_dom);
+	json_builder_init(&json_builder);
+	json_parser_init2(&json_parserr, &json_builder);
 
 	while(read	= fread((void*)buffer, sizeof(char), chunk, stdin))
 	{
@@ -24,7 +25,8 @@ int	main(void)
 
 	root	= json_result_tree(&json_parserr);
 	json_print_tree(root, 0, false);
-	json_free_tree(root);
+	json_parser_free(&json_parserr);
+	json_builder_free(&json_builder);
 
 	return	0;
 }
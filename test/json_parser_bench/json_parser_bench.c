@@ -0,0 +1,108 @@
+#include	<string.h>
+#include	<time.h>
+#include	"src/json_parser.h"
+
+/*
+ * json tree building benchmark
+ * parses arrays of growing size and prints time per element,
+ * it has to stay flat (linear building) for all sizes
+ */
+
+#define	CHUNK	(64 * 1024)
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return	ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+skip_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+	return	0;
+}
+
+/* json array of n objects, similar to ordinary service response */
+static char*
+generate(int n, size_t *length)
+{
+	size_t	size	= (size_t)n * 64 + 16;
+	char*	json	= malloc(size);
+	size_t	len		= 0;
+	int		i;
+
+	json[len++]	= '[';
+	for( i=0; i<n; i++ )
+		len	+= sprintf(json + len, "%s{\"title\":\"title %d\",\"id\":%d,\"ok\":true}", i ? "," : "", i, i);
+	json[len++]	= ']';
+	json[len]	= '\0';
+
+	*length	= len;
+	return	json;
+}
+
+static double
+parse(const char *json, size_t length, JSONBuilder *builder, int *elements)
+{
+	json_parser	parser;
+	double	start	= now();
+	size_t	offset;
+	int		ret;
+
+	if(builder)
+		json_parser_init2(&parser, builder);
+	else
+		json_parser_init(&parser, NULL, skip_callback, NULL);
+
+	for( offset=0; offset<length; offset+=CHUNK )
+	{
+		ret	= json_parser_string(&parser, json + offset, length - offset < CHUNK ? length - offset : CHUNK, NULL);
+		if(ret)
+		{
+			printf("[ERROR] json_parser failed: %d\n", ret);
+			exit(1);
+		}
+	}
+
+	if(builder)
+		*elements	= json_result_tree(&parser)->length;
+	json_parser_free(&parser);
+
+	return	now() - start;
+}
+
+int	main(int argc, char **argv)
+{
+	int		max		= 1 < argc ? atoi(argv[1]) : 1000000;
+	int		n;
+
+	printf("%10s %12s %12s %14s\n", "elements", "parse, ms", "build, ms", "build, ns/el");
+	for( n=max/8; n<=max; n*=2 )
+	{
+		JSONBuilder	builder;
+		size_t	length;
+		char*	json	= generate(n, &length);
+		int		elements	= 0;
+		double	parse_time, build_time;
+
+		parse_time	= parse(json, length, NULL, NULL);
+
+		json_builder_init(&builder);
+		build_time	= parse(json, length, &builder, &elements) - parse_time;
+		json_builder_free(&builder);
+
+		if(elements != n)
+		{
+			printf("[ERROR] %d elements were built instead of %d\n", elements, n);
+			return	1;
+		}
+
+		printf("%10d %12.1f %12.1f %14.1f\n", n, parse_time * 1e3, build_time * 1e3, build_time * 1e9 / n);
+		free(json);
+	}
+
+	return	0;
+}
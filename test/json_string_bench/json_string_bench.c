@@ -0,0 +1,134 @@
+#include	<stdio.h>
+#include	<string.h>
+#include	<time.h>
+#include	"libjson-0.8/json.h"
+
+/*
+ * string copies benchmark
+ * parses text-heavy response in chunks of curl write callback size
+ * and copies its strings into destination (as decoder does into text values),
+ * with strings buffered by parser and with strings passed in place
+ * (escaped ones are unescaped right into destination then)
+ */
+
+#define	CHUNK	(16 * 1024)
+
+typedef	struct	Bench
+{
+	const char*	chunk;		/* chunk being parsed */
+	uint32_t	chunk_length;
+	char*		value;		/* destination of strings */
+	double		parser_copied;	/* bytes copied through parser buffer */
+	double		value_copied;	/* bytes copied into destination */
+} Bench;
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return	ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+copy_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+	Bench*	bench	= userdata;
+
+	if(JSON_STRING != type && JSON_STRING_ESCAPED != type)
+		return	0;
+
+	if(data < bench->chunk || data >= bench->chunk + bench->chunk_length)
+		bench->parser_copied	+= length;
+
+	if(JSON_STRING_ESCAPED == type)
+		length	= json_unescape(data, length, bench->value);
+	else
+		memcpy(bench->value, data, length);
+	bench->value_copied	+= length;
+
+	return	0;
+}
+
+/* json array of objects with long descriptions and html snippets (with escapes) */
+static char*
+generate(size_t size, size_t *length)
+{
+	static const char	words[]	= "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor ";
+	char*	json	= malloc(size + 4096);
+	size_t	len		= 0;
+	int		i;
+
+	json[len++]	= '[';
+	for( i=0; len<size; i++ )
+	{
+		int		j;
+
+		len	+= sprintf(json + len, "%s{\"id\":%d,\"title\":\"item %d\",\"description\":\"", i ? "," : "", i, i);
+		for( j=0; j<12; j++ )
+			len	+= sprintf(json + len, "%s", words);
+		len	+= sprintf(json + len, "\",\"html\":\"<p class=\\\"text\\\">%.*s<\\/p>\\n\\u00e9\"}", 300, words);
+	}
+	json[len++]	= ']';
+	json[len]	= '\0';
+
+	*length	= len;
+	return	json;
+}
+
+static double
+parse(const char *json, size_t length, int inplace, Bench *bench)
+{
+	json_config	config;
+	json_parser	parser;
+	double	start	= now();
+	size_t	offset;
+	int		ret;
+
+	memset(&config, 0, sizeof(config));
+	config.inplace_strings	= inplace;
+	json_parser_init(&parser, &config, copy_callback, bench);
+
+	for( offset=0; offset<length; offset+=CHUNK )
+	{
+		bench->chunk	= json + offset;
+		bench->chunk_length	= length - offset < CHUNK ? length - offset : CHUNK;
+		ret	= json_parser_string(&parser, bench->chunk, bench->chunk_length, NULL);
+		if(ret)
+		{
+			printf("[ERROR] json_parser failed: %d\n", ret);
+			exit(1);
+		}
+	}
+	json_parser_free(&parser);
+
+	return	now() - start;
+}
+
+int	main(int argc, char **argv)
+{
+	size_t	size	= (size_t)(1 < argc ? atoi(argv[1]) : 100) * 1024 * 1024;
+	size_t	length;
+	char*	json	= generate(size, &length);
+	int		inplace;
+
+	printf("response: %.1f MB\n", length / 1048576.0);
+	printf("%10s %10s %12s %18s %18s\n", "strings", "time, ms", "MB/s", "parser copies, MB", "value copies, MB");
+	for( inplace=0; inplace<=1; inplace++ )
+	{
+		Bench	bench;
+		double	time;
+
+		memset(&bench, 0, sizeof(bench));
+		bench.value	= malloc(CHUNK * 4);
+		time	= parse(json, length, inplace, &bench);
+
+		printf("%10s %10.1f %12.1f %18.1f %18.1f\n", inplace ? "in place" : "buffered",
+			   time * 1e3, length / 1048576.0 / time, bench.parser_copied / 1048576.0, bench.value_copied / 1048576.0);
+		free(bench.value);
+	}
+
+	free(json);
+	return	0;
+}
@@ -0,0 +1,8 @@
+#!/bin/sh
+t=json_string_bench
+
+make
+
+./$t "$@"
+
+make clean
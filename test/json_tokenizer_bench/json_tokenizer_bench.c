@@ -0,0 +1,223 @@
+#include	<stdio.h>
+#include	<string.h>
+#include	<time.h>
+#include	"libjson-0.8/json.h"
+
+/*
+ * tokenizer throughput benchmark
+ * parses json_parser test corpus and generated responses in chunks of curl
+ * write callback size (with in place strings and utf-8 validation, as json
+ * decoder does) with each tokenizer instruction set supported by cpu
+ */
+
+#define	CHUNK	(16 * 1024)
+#define	RUNS	5
+
+typedef	struct	Input
+{
+	const char*	name;
+	char*		json;
+	size_t		length;
+	size_t*		ends;		/* json is concatenation of documents, which end there */
+	int			documents;
+} Input;
+
+static const char*	levels[]	= {"none", "scalar", "sse2", "avx2"};
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return	ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+count_callback(void *userdata, int type, const char *data, uint32_t length)
+{
+	(*(size_t*)userdata)++;
+	return	0;
+}
+
+/* append formatted text, buffer grows as needed */
+static void
+append(Input *in, size_t *size, const char *fmt, const char *s, int n)
+{
+	if(in->length + 4096 > *size)
+	{
+		*size	*= 2;
+		in->json	= realloc(in->json, *size);
+	}
+	in->length	+= sprintf(in->json + in->length, fmt, s, n);
+}
+
+/* json_parser test corpus: small documents repeated up to size */
+static void
+corpus(Input *in, size_t size, int nfiles, char **files)
+{
+	char*	docs	= malloc(1024 * 1024);
+	size_t*	ends	= malloc(nfiles * sizeof(size_t));
+	size_t	length	= 0;
+	int		i,
+			ndocs	= 0;
+
+	for( i=0; i<nfiles; i++ )
+	{
+		FILE*	f	= fopen(files[i], "r");
+
+		if(!f)
+			continue;
+		length	+= fread(docs + length, 1, 1024 * 1024 - length, f);
+		ends[ndocs++]	= length;
+		fclose(f);
+	}
+
+	in->name	= "corpus";
+	in->json	= malloc(size + length);
+	in->ends	= malloc((size / (length ? length : 1) + 1) * ndocs * sizeof(size_t));
+	in->length	= 0;
+	in->documents	= 0;
+	while(length && in->length < size)
+	{
+		memcpy(in->json + in->length, docs, length);
+		for( i=0; i<ndocs; i++ )
+			in->ends[in->documents++]	= in->length + ends[i];
+		in->length	+= length;
+	}
+	free(docs);
+	free(ends);
+}
+
+/* array of objects, kind: text - long ascii strings, unicode - non-ascii strings,
+ * numbers - numeric columns, pretty - indented objects */
+static void
+generate(Input *in, const char *kind, size_t size)
+{
+	static const char	words[]	= "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor ";
+	static const char	unicode[]	= "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe4\xb8\x96\xe7\x95\x8c \xc3\xa9t\xc3\xa9 \xf0\x9f\x98\x80 ";
+	size_t	allocated	= 1024 * 1024;
+	int		i;
+
+	in->name	= kind;
+	in->json	= malloc(allocated);
+	in->length	= 0;
+	append(in, &allocated, "%s", "[", 0);
+	for( i=0; in->length<size; i++ )
+	{
+		int		j;
+
+		if(0 == strcmp(kind, "numbers"))
+		{
+			append(in, &allocated, "%s{\"id\":%d", i ? "," : "", i);
+			for( j=0; j<8; j++ )
+				append(in, &allocated, ",\"v%s\":%d.25e-3", "", i * 31 + j);
+			append(in, &allocated, "%s}", "", 0);
+		}
+		else if(0 == strcmp(kind, "pretty"))
+		{
+			append(in, &allocated, "%s\n    {\n        \"id\": %d,\n", i ? "," : "", i);
+			append(in, &allocated, "        \"title\": \"%s %d\",\n", "lorem ipsum dolor sit amet", i);
+			append(in, &allocated, "        \"tags\": [\n            \"a\",\n            \"b\"\n        ],\n%s        \"active\": true\n    }", "", 0);
+		}
+		else
+		{
+			append(in, &allocated, "%s{\"id\":%d,\"description\":\"", i ? "," : "", i);
+			for( j=0; j<12; j++ )
+				append(in, &allocated, "%s", strcmp(kind, "unicode") ? words : unicode, 0);
+			append(in, &allocated, "%s\"}", "", 0);
+		}
+	}
+	append(in, &allocated, "%s", "]", 0);
+	in->ends	= malloc(sizeof(size_t));
+	in->ends[0]	= in->length;
+	in->documents	= 1;
+}
+
+/* time of one pass over input */
+static double
+parse(const Input *in, size_t *events)
+{
+	double	start	= now();
+	int		doc;
+
+	*events	= 0;
+	for( doc=0; doc<in->documents; doc++ )
+	{
+		json_config	config;
+		json_parser	parser;
+		size_t	begin	= doc ? in->ends[doc - 1] : 0,
+				offset;
+
+		memset(&config, 0, sizeof(config));
+		config.inplace_strings	= 1;
+		config.validate_utf8	= 1;
+		json_parser_init(&parser, &config, count_callback, events);
+		for( offset=begin; offset<in->ends[doc]; offset+=CHUNK )
+		{
+			uint32_t	length	= in->ends[doc] - offset < CHUNK ? in->ends[doc] - offset : CHUNK;
+			int		ret	= json_parser_string(&parser, in->json + offset, length, NULL);
+
+			if(ret)
+			{
+				printf("[ERROR] %s: json_parser failed: %d\n", in->name, ret);
+				exit(1);
+			}
+		}
+		json_parser_free(&parser);
+	}
+
+	return	now() - start;
+}
+
+int	main(int argc, char **argv)
+{
+	size_t	size	= (size_t)(1 < argc ? atoi(argv[1]) : 100) * 1024 * 1024;
+	const char*	kinds[]	= {"text", "unicode", "numbers", "pretty"};
+	Input	inputs[5];
+	int		ninputs	= 0,
+			supported,
+			i,
+			level;
+
+	if(2 < argc)
+		corpus(&inputs[ninputs++], size / 10, argc - 2, argv + 2);
+	for( i=0; i<4; i++ )
+		generate(&inputs[ninputs++], kinds[i], size);
+
+	supported	= json_simd_level();
+	printf("tokenizer: %s\n", levels[supported]);
+	printf("%10s %10s %8s", "input", "size, MB", "events");
+	for( level=JSON_SIMD_NONE; level<=supported; level++ )
+		printf(" %12s", levels[level]);
+	printf("   (MB/s)\n");
+
+	for( i=0; i<ninputs; i++ )
+	{
+		size_t	events	= 0;
+		double	best[JSON_SIMD_AVX2 + 1];
+		int		run;
+
+		/* levels take turns in each run: drift of machine load hits all of them,
+		 * best time of RUNS is taken */
+		for( run=0; run<RUNS; run++ )
+			for( level=JSON_SIMD_NONE; level<=supported; level++ )
+			{
+				double	time;
+
+				json_simd_limit(level);
+				time	= parse(&inputs[i], &events);
+				if(0 == run || time < best[level])
+					best[level]	= time;
+			}
+
+		printf("%10s %10.1f %7.1fM", inputs[i].name, inputs[i].length / 1048576.0, events / 1e6);
+		for( level=JSON_SIMD_NONE; level<=supported; level++ )
+			printf(" %12.1f", inputs[i].length / 1048576.0 / best[level]);
+		printf("\n");
+		free(inputs[i].json);
+		free(inputs[i].ends);
+	}
+
+	return	0;
+}
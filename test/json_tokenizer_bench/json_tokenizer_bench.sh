@@ -0,0 +1,8 @@
+#!/bin/sh
+t=json_tokenizer_bench
+
+make
+
+./$t "${1:-100}" ../json_parser/json_parser.in.*
+
+make clean
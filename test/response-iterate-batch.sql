@@ -0,0 +1,14 @@
+DROP EXTENSION IF EXISTS www_fdw CASCADE;
+CREATE EXTENSION www_fdw;
+CREATE SERVER www_fdw_server_test FOREIGN DATA WRAPPER www_fdw OPTIONS (uri 'http://localhost:7777', response_type 'json', response_iterate_callback 'test_response_iterate_batch', response_iterate_batch '2');
+CREATE USER MAPPING FOR current_user SERVER www_fdw_server_test;
+CREATE FOREIGN TABLE www_fdw_test (
+	title text,
+	link text,
+	snippet text
+) SERVER www_fdw_server_test;
+CREATE OR REPLACE FUNCTION test_response_iterate_batch(options WWWFdwOptions, tuples www_fdw_test[]) RETURNS SETOF www_fdw_test AS $$
+	SELECT t.title || ' of ' || array_length($2, 1), t.link, t.snippet
+	FROM unnest($2) t
+	WHERE t.title <> 't1';
+$$ LANGUAGE SQL;
@@ -0,0 +1,51 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+perl -Mojo -e'a("/" => {json => {nrows=>2,rows=>[{title=>"t0",link=>"l0",snippet=>"s0"},{title=>"t1",link=>"l1",snippet=>"s1"}]}})->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# pool lives in backend: both scans have to be run in the same session
+sql="explain analyze select * from www_fdw_test; explain analyze select * from www_fdw_test"
+r=`$psql -tA -c"$sql" | grep -o 'Connection: [a-z]*'`
+test "$r" $'Connection: new\nConnection: reused' "$sql"
+
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (ADD connection_max_per_host '0')"
+
+sql="explain analyze select * from www_fdw_test; explain analyze select * from www_fdw_test"
+r=`$psql -tA -c"$sql" | grep -o 'Connection: [a-z]*'`
+test "$r" $'Connection: new\nConnection: new' "$sql"
+
+sql="select * from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0|l0|s0\nt1|l1|s1' "$sql"
+
+kill $spid
+
+$psql -f "$test_dir/default-json.sql"
+
+# server returns port of the client: connections of fan-out requests
+# are kept in the pool after the scan as well
+perl -Mojo -e'a("/" => sub { my $c=shift; $c->render(json => {rows=>[{title=>$c->tx->remote_port,link=>$c->param("link")}]}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_concurrency '1')"
+sql="select title from www_fdw_test where link in ('a', 'b')"
+r=`$psql -tA -c"$sql" -c"$sql" | sort -u | wc -l`
+test "$r" '1' "connection of fan-out requests is reused: $sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -71,6 +71,23 @@ sql="select title from www_fdw_test order by title desc limit 2"
 r=`$psql -tA -c"$sql"`
 test "$r" $'3\n2' "$sql"
 
+# quals, which can't be passed to the server, are checked locally
+sql="select title from www_fdw_test where title > '1'"
+r=`$psql -tA -c"$sql"`
+test "$r" $'2\n3' "$sql"
+
+kill $spid
+
+# strings with escapes
+perl -Mojo -e'a("/" => sub { shift->render(text => q{[{"title":"a\"b\\\\c\/\u00e9\ud83d\ude00","link":"x\ny","snippet":""}]}, format => "json") })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# title is 'a"b\c/' followed by e with acute and grinning face
+sql="select md5(title), length(title), length(link), snippet = '' from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" '41932e2d9eba3fb3636e3700641d98ce|8|3|t' "$sql"
+
 kill $spid
 
 # clean up
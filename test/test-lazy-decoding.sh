@@ -0,0 +1,43 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+# snippet is nested object (captured as json text) for odd rows
+perl -Mojo -e'a("/" => sub { my $c=shift; $c->render(json => {rows=>[map { {title=>"t$_",link=>"l$_",snippet=>($_ % 2 ? {n=>$_} : "s\"$_")} } 0..3]}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# columns of select list only are decoded after local quals
+sql="select snippet from www_fdw_test where title like '%1' or title like '%2'"
+r=`$psql -tA -c"$sql"`
+test "$r" $'{"n":1}\ns"2' "$sql"
+
+sql="select title, snippet from www_fdw_test where link <> 'l0' and snippet is null"
+r=`$psql -tA -c"$sql"`
+test "$r" '' "qual of deferred column isn't deferred: $sql"
+
+sql="select title, link from www_fdw_test where link > 'l2'"
+r=`$psql -tA -c"$sql"`
+test "$r" 't3|l3' "$sql"
+
+sql="select snippet from www_fdw_test where title like 't1%'"
+r=`$psql -tA -c"explain $sql" | perl -ne'print $1 if /Filter: (.*)/'`
+test "$r" "(title ~~ 't1%'::text)" "filter is shown: $sql"
+
+sql="select title from www_fdw_test where title like 't%' order by link desc limit 2"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t3\nt2' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
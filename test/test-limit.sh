@@ -0,0 +1,41 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+# server returns limit rows (100000 without limit)
+perl -Mojo -e'a("/" => sub { my $c=shift; my $n=$c->param("limit")//100000; $c->render(json => {rows=>[map { {title=>"t$_",link=>"l"} } 0..$n-1]}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# transfer is stopped after 3 rows
+sql="select title from www_fdw_test limit 3"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "$sql"
+
+# aborted transfer doesn't break following requests
+r=`$psql -tA -c"$sql; select count(*) from www_fdw_test"`
+test "$r" $'t0\nt1\nt2\n100000' "aborted transfer followed by full one"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD param_limit 'limit=%s')"
+sql="select title from www_fdw_test limit 2 offset 1"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t1\nt2' "$sql"
+
+# local filter: whole response is needed
+sql="select title from www_fdw_test where title like '%99' limit 2"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t99\nt199' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -0,0 +1,92 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+# 3 pages, cursor of the next page is in body (url and token) and in Link header
+perl -Mojo -e'a("/" => sub { my $c=shift; my $i=$c->param("cursor")//0; my $n=$i+1; my $last=$n>=3; $c->res->headers->link("<http://localhost:7777/?cursor=$n>; rel=\"next\"") unless $last; $c->render(json => {rows=>[{title=>"t$i"}],next=>($last ? undef : "/?cursor=$n"),rel=>($last ? undef : "?cursor=$n"),other=>"http://127.0.0.1:7777/?cursor=$n",file=>"file:///etc/passwd",meta=>{cursor=>($last ? undef : $n)}}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+sql="select title from www_fdw_test"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_next_path 'next')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "next page url in body: $sql"
+
+# relative reference is resolved against url of the page (RFC 3986)
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (SET page_next_path 'rel')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "relative next page url in body: $sql"
+
+# next page on another host or with other protocol isn't requested
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (SET page_next_path 'other')"
+r=`$psql -tA -c"$sql" 2>&1 | grep -c "isn't on the server of the first page"`
+test "$r" '1' "next page url on another host: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (SET page_next_path 'file')"
+r=`$psql -tA -c"$sql" 2>&1 | grep -c "isn't on the server of the first page"`
+test "$r" '1' "next page url with file protocol: $sql"
+
+# header isn't sent: cursor of the body is used
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (SET page_next_path 'next', ADD page_next_header 'X-Next')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "missing header, next page url in body: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP page_next_header, SET page_next_path 'meta.cursor', ADD page_next_param 'cursor')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "cursor in body: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP page_next_path, DROP page_next_param, ADD page_next_header 'Link')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1\nt2' "Link header: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_limit '2')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0\nt1' "page_limit: $sql"
+
+kill $spid
+
+$psql -f "$test_dir/default-json.sql"
+
+# 5 rows, 2 per page, total count in body, second page is the slowest one
+perl -Mojo -e'a("/" => sub { my $c=shift; my $n=$c->param("per_page")//2; my $o=$c->param("offset")//(($c->param("page")//1)-1)*$n; my @r=map { {title=>"r$_"} } grep { $_<5 } $o..$o+$n-1; $c->render_later; Mojo::IOLoop->timer(($o==2 ? 1 : 0) => sub { $c->render(json => {rows=>\@r,meta=>{total=>5}}) }) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_number_param 'page', ADD page_size_param 'per_page', ADD page_size '2', ADD page_total_path 'meta.total', ADD request_concurrency '2')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'r0\nr1\nr2\nr3\nr4' "numbered pages in page order: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_ordered '0')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'r0\nr1\nr4\nr2\nr3' "numbered pages in order of arrival: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP page_number_param, ADD page_offset_param 'offset', DROP page_ordered)"
+r=`$psql -tA -c"$sql"`
+test "$r" $'r0\nr1\nr2\nr3\nr4' "offset pages: $sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_limit '2')"
+r=`$psql -tA -c"$sql"`
+test "$r" $'r0\nr1\nr2\nr3' "page_limit of offset pages: $sql"
+
+kill $spid
+
+# page numbering options are checked
+r=`$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD page_number_param 'page')" 2>&1 | grep -c "can't be used together"`
+test "$r" '1' "page_number_param with page_offset_param"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP page_size)"
+r=`$psql -tA -c"$sql" 2>&1 | grep -c "page_size is required"`
+test "$r" '1' "page_offset_param without page_size"
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
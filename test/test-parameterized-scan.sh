@@ -0,0 +1,60 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+# join lookups are cheap without latency: nested loop with parameterized scan is chosen
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_latency '0')"
+export PGOPTIONS="-c enable_hashjoin=off -c enable_mergejoin=off"
+
+sql="select t.* from (values ('a'), ('b')) v(title) join www_fdw_test t on t.title = v.title"
+r=`$psql -tA -c"explain verbose $sql" | perl -ne'print $1 if /Remote Parameters: (.*)/'`
+test "$r" 'title=%s' "explain: $sql"
+
+# server returns requested title and number of the request,
+# without title - all rows
+perl -Mojo -e'my $n=0; a("/" => sub { my $c=shift; my $t=$c->param("title"); $n++; $c->render(json => {rows=>(defined $t ? [{title=>$t,link=>"r$n"}] : [{title=>"x",link=>"all$n"},{title=>"y",link=>"all$n"}])}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+sql="select t.title, t.link from (values ('a b'), ('c')) v(title) join www_fdw_test t on t.title = v.title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'a b|r1\nc|r2' "$sql"
+
+# repeated outer value is served from the reply cache of the scan
+sql="select t.title, t.link from (values ('x'), ('y'), ('x')) v(title) join www_fdw_test t on t.title = v.title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'x|r3\ny|r4\nx|r3' "$sql"
+
+# null outer value matches nothing, no request is made
+sql="select t.title, t.link from (values ('z'), (null)) v(title) join www_fdw_test t on t.title = v.title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'z|r5' "$sql"
+
+# after one lookup whole response is fetched and grouped by title
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_lookup_limit '1', ADD request_lookup_fetch_all '1')"
+sql="select t.title, t.link from (values ('x'), ('y'), ('w'), ('x')) v(title) join www_fdw_test t on t.title = v.title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'x|r6\ny|all7\nx|r6' "$sql"
+
+# empty fan-out array of generic plan: no rows, whole response isn't requested
+r=`$psql -tA -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_concurrency '2')" -c"set plan_cache_mode = force_generic_plan" -c"prepare q(text[]) as select t.title, t.link from (values ('x'), ('y')) v(title) join www_fdw_test t on t.title = v.title where t.link = any(\$1)" -c"execute q('{}')" 2>&1 | grep -c "|\|ERROR\|server closed"`
+test "$r" '0' "empty fan-out array over request_lookup_limit"
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP request_concurrency)"
+
+# without request_lookup_fetch_all lookups go on over the limit
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (DROP request_lookup_fetch_all)"
+r=`$psql -tA -c"$sql"`
+test "$r" $'x|r8\ny|r9\nw|r10\nx|r8' "request_lookup_limit without request_lookup_fetch_all: $sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -0,0 +1,106 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+# plain EXPLAIN doesn't send requests: no server is needed
+$psql -f "$test_dir/default-json.sql"
+
+function plan_rows
+{
+	$psql -tA -c"explain $1" | head -1 | perl -ne'print $1 if /rows=(\d+)/'
+}
+
+sql="select * from www_fdw_test"
+test "`plan_rows "$sql"`" '1000' "$sql"
+
+# equality is passed to the server: default selectivity of '=' is applied
+sql="select * from www_fdw_test where title='t0'"
+test "`plan_rows "$sql"`" '5' "$sql"
+
+# url parameters are rendered by planner, other quals are left for executor
+r=`$psql -tA -c"explain verbose select * from www_fdw_test where title='t 0' and link like 'l%'" | perl -ne'print "$1;" if /(Remote Parameters: .*|Filter: .*)/'`
+test "$r" "Filter: (www_fdw_test.link ~~ 'l%'::text);Remote Parameters: title=t%200;" "remote/local quals"
+
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (ADD expected_rows '200')"
+sql="select * from www_fdw_test"
+test "`plan_rows "$sql"`" '200' "server expected_rows: $sql"
+
+# table option overrides server one
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD expected_rows '10')"
+sql="select * from www_fdw_test"
+test "`plan_rows "$sql"`" '10' "table expected_rows: $sql"
+
+# latency goes to startup cost: 2 ms
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_latency '2', ADD response_row_cost '0')"
+sql="select * from www_fdw_test"
+r=`$psql -tA -c"explain $sql" | head -1 | perl -ne'print $1 if /cost=([\d.]+)\.\./'`
+test "$r" '200.00' "startup cost: $sql"
+
+# column templates: range, IN, LIKE prefix, IS NULL
+$psql -c"ALTER FOREIGN TABLE www_fdw_test ALTER COLUMN title OPTIONS (ADD param_gt 'title_after=%s', ADD param_in 'titles=%s', ADD param_like 'q=%s*', ADD param_null 'untitled=1')"
+
+function remote_params
+{
+	$psql -tA -c"explain verbose $1" | perl -ne'print $1 if /Remote Parameters: (.*)/'
+}
+
+sql="select * from www_fdw_test where 'a' < title and title in ('x y', 'z')"
+test "`remote_params "$sql"`" 'title_after=a&titles=x%20y,z' "$sql"
+
+sql="select * from www_fdw_test where title like 'ab%' and title is null"
+test "`remote_params "$sql"`" 'q=ab*&untitled=1' "$sql"
+
+# no template: checked locally
+sql="select * from www_fdw_test where title <= 'a' and link like 'l%' and title like '%a'"
+test "`remote_params "$sql"`" '' "$sql"
+
+# IN list of column without param_in is fanned out into requests with request_concurrency
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_concurrency '2')"
+sql="select * from www_fdw_test where link in ('a', 'b c', 'a')"
+r=`$psql -tA -c"explain verbose $sql" | perl -ne'print $1 if /Remote Fan-out: (.*)/'`
+test "$r" 'link=a, link=b%20c' "$sql"
+
+# array of parameters of generic plan is fanned out by executor
+r=`$psql -tA -c"set plan_cache_mode = force_generic_plan" -c"prepare q(text[]) as select * from www_fdw_test where link = any(\$1)" -c"explain verbose execute q('{a,b}')" | perl -ne'print $1 if /Remote Fan-out: (.*)/'`
+test "$r" 'link=%s' "fan-out of parameter"
+
+# LIMIT (with OFFSET) of single table query is passed to the server
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD param_limit 'limit=%s')"
+sql="select * from www_fdw_test where title = 'a' limit 5 offset 2"
+r=`$psql -tA -c"explain verbose $sql" | perl -ne'print "$1;" if /Remote (Parameters|Limit): (.*)/ and $1 = "$1: $2"'`
+test "$r" 'Parameters: title=a&limit=7;Limit: 7;' "$sql"
+
+# rows are sorted or filtered locally: all of them are needed
+sql="select * from www_fdw_test order by title limit 5"
+test "`remote_params "$sql"`" '' "$sql"
+
+sql="select * from www_fdw_test where link like '%a' limit 5"
+test "`remote_params "$sql"`" '' "$sql"
+
+# quals other than equality are rechecked locally, so LIMIT isn't passed with them
+sql="select * from www_fdw_test where title like 'ab%' limit 5"
+r=`$psql -tA -c"explain verbose $sql" | perl -ne'print "$1;" if /(Remote Parameters: .*|Filter: .*)/'`
+test "$r" "Filter: (www_fdw_test.title ~~ 'ab%'::text);Remote Parameters: q=ab*;" "$sql"
+
+# declared order of response: no local sort
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD response_order 'title, link desc')"
+sql="select * from www_fdw_test order by title, link desc"
+test "`$psql -tA -c"explain $sql" | grep -c Sort`" '0' "response_order: $sql"
+
+sql="select * from www_fdw_test order by title desc"
+test "`$psql -tA -c"explain $sql" | grep -c Sort`" '1' "response_order other direction: $sql"
+
+sql="select * from www_fdw_test order by title collate \"C\", link desc"
+test "`$psql -tA -c"explain $sql" | grep -c Sort`" '1' "response_order other collation: $sql"
+
+# sorting is passed to the server, LIMIT of sorted rows too
+$psql -c"ALTER FOREIGN TABLE www_fdw_test ALTER COLUMN title OPTIONS (ADD param_sort_desc 'sort=-title')"
+sql="select * from www_fdw_test order by title desc limit 3"
+test "`$psql -tA -c"explain $sql" | grep -c Sort`" '0' "param_sort_desc: $sql"
+test "`remote_params "$sql"`" 'sort=-title&limit=3' "param_sort_desc: $sql"
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -0,0 +1,44 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+# server returns requested fields in snippet
+perl -Mojo -e'a("/" => sub { my $c=shift; my $f=$c->param("fields")//""; $c->render(json => {rows=>[map { {title=>"t$_",link=>"l$_",snippet=>$f} } 0..1]}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# not used columns are skipped
+sql="select link from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" $'l0\nl1' "$sql"
+
+sql="select count(*) from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" '2' "$sql"
+
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD param_fields 'fields=%s')"
+sql="select snippet from www_fdw_test where link like 'l%' limit 1"
+r=`$psql -tA -c"$sql"`
+test "$r" 'link,snippet' "$sql"
+
+sql="select * from www_fdw_test limit 1"
+r=`$psql -tA -c"$sql"`
+test "$r" 't0|l0|' "all columns: $sql"
+
+sql="select count(*) from www_fdw_test"
+r=`$psql -tA -c"explain verbose $sql" | perl -ne'print $1 if /Remote Parameters: (.*)/'`
+test "$r" 'fields=title' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -0,0 +1,44 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+
+perl -Mojo -e'
+	a("/" => {json => {rows=>[map {{title=>"t$_",link=>"l$_",snippet=>"s" x 100}} 1..20000]}});
+	app->start
+' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# rows fit in work_mem
+sql="select count(*), sum(length(snippet)) from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" '20000|2000000' "$sql"
+
+r=`$psql -tA -c"explain analyze $sql" | perl -ne'print $1 if /Reply Storage: (\w+)/'`
+test "$r" 'Memory' "explain analyze: $sql"
+
+# rows over work_mem go to temp files, result is the same
+r=`$psql -tA -c"set work_mem='64kB'; $sql"`
+test "$r" '20000|2000000' "work_mem 64kB: $sql"
+
+r=`$psql -tA -c"set work_mem='64kB'; explain analyze $sql" | perl -ne'print $1 if /Reply Storage: (\w+)/'`
+test "$r" 'Disk' "work_mem 64kB, explain analyze: $sql"
+
+# rescans are served from temp files
+sql="select count(*) from generate_series(1, 3) g, www_fdw_test t where t.title <> g::text"
+r=`$psql -tA -c"set work_mem='64kB'; set enable_material=off; set enable_hashjoin=off; set enable_mergejoin=off; $sql"`
+test "$r" '60000' "work_mem 64kB, rescan: $sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
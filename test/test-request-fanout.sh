@@ -0,0 +1,31 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+$psql -c"ALTER FOREIGN TABLE www_fdw_test OPTIONS (ADD request_concurrency '2')"
+
+# server returns requested title only
+perl -Mojo -e'a("/" => sub { my $c=shift; $c->render(json => {rows=>[{title=>$c->param("title"),link=>"l"}]}) })->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+sql="select title, link from www_fdw_test where title in ('a', 'b', 'c', 'a', null) order by title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'a|l\nb|l\nc|l' "$sql"
+
+sql="select title from www_fdw_test where title = any(array['x y', 'z']) order by title"
+r=`$psql -tA -c"$sql"`
+test "$r" $'x y\nz' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -0,0 +1,37 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/response-iterate-batch.sql"
+
+perl -Mojo -e'a("/" => {json => {nrows=>5,rows=>[map {{title=>"t$_",link=>"l$_",snippet=>"s$_"}} 0..4]}})->start' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# rows are passed in batches of 2, callback filters out t1
+sql="select * from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0 of 2|l0|s0\nt2 of 2|l2|s2\nt3 of 2|l3|s3\nt4 of 1|l4|s4' "$sql"
+
+sql="select * from www_fdw_test limit 1"
+r=`$psql -tA -c"$sql"`
+test "$r" 't0 of 2|l0|s0' "$sql"
+
+# batches don't cross stream buffers (their sizes depend on transfer chunks)
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (ADD response_stream '1', ADD response_stream_rows '3')"
+
+sql="select link from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" $'l0\nl2\nl3\nl4' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"
@@ -45,4 +45,16 @@ sql="select * from www_fdw_test order by title limit 1"
 r=`$psql -tA -c"$sql"`
 test "$r" $'t0 hello world of callbacks|l0|s0' "$sql"
 
+# callback plan is cached per backend: function replaced in the same session has to be used
+r=`$psql -tA <<'SQL'
+select * from www_fdw_test limit 1;
+DROP FUNCTION test_response_iterate_callback(WWWFdwOptions, www_fdw_test);
+CREATE FUNCTION test_response_iterate_callback(options WWWFdwOptions, INOUT tuple www_fdw_test) AS $$
+BEGIN
+	tuple.title := tuple.title || ' replaced';
+END; $$ LANGUAGE PLPGSQL;
+select * from www_fdw_test limit 1;
+SQL`
+test "$r" $'t0 hello world of callbacks|l0|s0\nDROP FUNCTION\nCREATE FUNCTION\nt0 replaced|l0|s0' "callback replaced in the same session"
+
 kill $spid
\ No newline at end of file
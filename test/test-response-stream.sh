@@ -0,0 +1,50 @@
+#!/bin/bash
+test_dir=`echo $0 | perl -pe's#(.*)/.*#$1#;'`
+source "$test_dir/test.sh"
+
+bin=`pg_config --bindir`
+psql="$bin/psql"
+
+waits=3
+
+trap 'if [ -n "$spid" ]; then echo "killing server $spid"; kill $spid; fi; exit' 2 13 15
+
+$psql -f "$test_dir/default-json.sql"
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (ADD response_stream '1', ADD response_stream_rows '2')"
+
+perl -Mojo -e'
+	a("/" => {json => {tags=>["a","b"],data=>{nrows=>5,rows=>[map {{title=>"t$_",link=>"l$_",snippet=>"s$_"}} 0..4]}}});
+	a("/empty" => {json => {tags=>["a"],rows=>[]}});
+	a("/nested" => {json => {meta=>[{id=>1}],result=>{items=>[{title=>"t0",link=>"l0",snippet=>"s0"}]}}});
+	app->start
+' daemon --listen http://*:7777 &
+spid=$!
+sleep $waits
+
+# more rows than buffer holds: transfer is paused and resumed
+sql="select * from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" $'t0|l0|s0\nt1|l1|s1\nt2|l2|s2\nt3|l3|s3\nt4|l4|s4' "$sql"
+
+# scan is finished before the end of the response
+sql="select * from www_fdw_test limit 1"
+r=`$psql -tA -c"$sql"`
+test "$r" 't0|l0|s0' "$sql"
+
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (SET uri 'http://localhost:7777/empty')"
+
+sql="select count(*) from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" '0' "$sql"
+
+# array of objects without matching columns isn't result
+$psql -c"ALTER SERVER www_fdw_server_test OPTIONS (SET uri 'http://localhost:7777/nested')"
+
+sql="select * from www_fdw_test"
+r=`$psql -tA -c"$sql"`
+test "$r" 't0|l0|s0' "$sql"
+
+kill $spid
+
+# clean up
+$psql -c"DROP EXTENSION IF EXISTS www_fdw CASCADE"